@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Event path benchmark, from the checks on a received
+ * notification to the line in the event log.
+ *
+ * The micro benchmarks time kalert_notify_valid(), kalert_event_name(),
+ * events_to_bitmap(), the walk of a received datagram that used to be
+ * parse_notify_message(), and the queueing of a log line, through
+ * kalert_event()'s printf and through the JSON serializer kalertd uses
+ * since. The end to end runs drive the in-process fake kernel at fixed
+ * rates over its socketpair, through kalert_dispatch() into kalertd's
+ * notify_log(), with no rate limits and no storm coalescing so every
+ * notification makes a line. The fake kernel stamps every notification, so
+ * the latency is from its send() to the line being queued. rx_* is the part
+ * of it spent between the socket's receive timestamp and the callback.
+ *
+ * Each result is one line of key=value pairs starting with bench=, for
+ * scripts comparing runs:
+ *
+ *   bench=<name> ops=<n> ops/sec=<n> ns/op=<n> p50_ns=<n> p99_ns=<n>
+ *   p999_ns=<n> cpu_ns/op=<n> [...]
+ *
+ * Micro benchmark quantiles are over blocks of calls, a single call of
+ * the cheap ones is below the resolution of the clock.
+ */
+
+#include <getopt.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+#include <libmnl/libmnl.h>
+
+#include "private.h"
+#include "json.h"
+#include "kalert_event.h"
+#include "metrics.h"
+#include "notify_log.h"
+#include "ratelimit.h"
+
+/* Calls timed together by the micro benchmarks */
+#define MICRO_BLOCK 256
+
+/* Notifications packed in the datagram of the parse benchmark */
+#define PARSE_BATCH 16
+
+#define E2E_RATES_MAX 16
+
+/* kalert_event() calls per round, well inside its 4096 line ring */
+#define LOG_ROUND 2048
+
+/* The micro histograms count picoseconds per call */
+#define PS_PER_NS 1000
+
+typedef void (*micro_fn)(unsigned long i);
+
+struct bench_result {
+	uint64_t ops;
+	double wall_ns;
+	double cpu_ns;
+	struct hist lat; /* ns, or ps for the micro benchmarks */
+};
+
+static volatile uintptr_t sink;
+
+static struct kalert_notify_msg samples[64];
+static int sample_ids[64];
+static unsigned long bitmap[BITS_TO_LONGS(KALERT_EVENT_MAX)];
+static char datagram[KALERT_MAX_MSG_SIZE]
+	__attribute__((aligned(NLMSG_ALIGNTO)));
+static int datagram_len;
+
+/* event log flush interval of the end to end runs, kalertd's default */
+static unsigned int flush_ms = KALERT_LOG_FLUSH_INTERVAL;
+
+/* written by the log writer thread */
+static struct hist write_lat;
+
+/* kalertd's notification path, for the line micro benchmark and e2e */
+static struct notify_log micro_log;
+static struct rate_limiter limiter;
+static struct coalescer storm;
+
+static const int event_ids[] = {
+#define EVENT_ID(id, name, t, l) id,
+	KALERT_EVENT_LIST(EVENT_ID)
+#undef EVENT_ID
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, const struct bench_result *res,
+		   double scale, const char *extra)
+{
+	printf("bench=%s ops=%llu ops/sec=%.0f ns/op=%.3f p50_ns=%.3f "
+	       "p99_ns=%.3f p999_ns=%.3f cpu_ns/op=%.3f%s\n",
+	       name, (unsigned long long)res->ops,
+	       res->ops ? res->ops * 1e9 / res->wall_ns : 0.0,
+	       res->ops ? res->wall_ns / res->ops : 0.0,
+	       hist_quantile(&res->lat, 0.5) / scale,
+	       hist_quantile(&res->lat, 0.99) / scale,
+	       hist_quantile(&res->lat, 0.999) / scale,
+	       res->ops ? res->cpu_ns / res->ops : 0.0, extra ?: "");
+	fflush(stdout);
+}
+
+/* --------------------------- Micro ------------------------------ */
+
+static void setup_samples(void)
+{
+	struct kalert_notify_msg *notify;
+	struct nlmsghdr *nlh;
+	char *p = datagram;
+	unsigned int i;
+
+	/* one in eight out of range, like a kernel newer than the daemon */
+	for (i = 0; i < KALERT_ARRAY_SIZE(samples); i++) {
+		samples[i].type = i % KALERT_NOTIFY_MAX;
+		samples[i].level = i % KALERT_LEVEL_MAX;
+		samples[i].event =
+			event_ids[i % KALERT_ARRAY_SIZE(event_ids)];
+		if (i % 8 == 7)
+			samples[i].event = KALERT_EVENT_END + i;
+		sample_ids[i] = samples[i].event;
+	}
+	sample_ids[0] = KALERT_EVENT_HEARTBEAT;
+
+	for (i = 0; i < PARSE_BATCH; i++) {
+		nlh = mnl_nlmsg_put_header(p);
+		nlh->nlmsg_type = NLMSG_MIN_TYPE;
+		notify = mnl_nlmsg_get_payload(nlh);
+		*notify = samples[i];
+		nlh->nlmsg_len += sizeof(*notify);
+		p += nlh->nlmsg_len;
+	}
+	datagram_len = p - datagram;
+}
+
+static void op_notify_valid(unsigned long i)
+{
+	sink += kalert_notify_valid(&samples[i % KALERT_ARRAY_SIZE(samples)]);
+}
+
+static void op_event_name(unsigned long i)
+{
+	sink ^= (uintptr_t)kalert_event_name(
+		sample_ids[i % KALERT_ARRAY_SIZE(sample_ids)]);
+}
+
+static void op_events_to_bitmap(unsigned long i)
+{
+	size_t n = KALERT_ARRAY_SIZE(event_ids);
+
+	sink += events_to_bitmap(event_ids, i % n + 1, bitmap,
+				 KALERT_EVENT_MAX);
+	sink += bitmap[0];
+}
+
+static void op_parse(unsigned long i)
+{
+	struct kalert_notify_iter iter;
+	struct kalert_notify_msg *notify;
+
+	(void)i;
+	kalert_for_each_notify(notify, &iter, datagram, datagram_len) {
+		if (kalert_notify_valid(notify))
+			sink += notify->event;
+	}
+}
+
+/* The same line through kalert_event(), as kalertd used to queue it */
+static void op_kalert_event(unsigned long i)
+{
+	const struct kalert_notify_msg *notify =
+		&samples[i % KALERT_ARRAY_SIZE(samples) & ~7UL];
+
+	kalert_event(
+		"{\"seq\":%lu,\"type\":%s,\"event\":%s,\"id\":%u,\"level\":%s}\n",
+		i, kalert_type_name(notify->type)->json,
+		kalert_event_info(notify->event)->name.json, notify->event,
+		kalert_level_name(notify->level)->json);
+}
+
+/* The line kalertd queues, the seq is the line counter of micro_log */
+static void op_json_event(unsigned long i)
+{
+	const struct kalert_notify_msg *notify =
+		&samples[i % KALERT_ARRAY_SIZE(samples) & ~7UL];
+
+	notify_log_line(&micro_log, realtime_ns(), notify->type,
+			notify->event, notify->level, NULL);
+}
+
+/* Inlined into each caller, so @op is a direct call or inlined too */
+static inline __attribute__((always_inline)) void
+run_micro(micro_fn op, unsigned long calls, unsigned int block,
+	  unsigned int per_call, struct bench_result *res)
+{
+	double cpu_start = cpu_ns();
+	uint64_t start = now_ns();
+	uint64_t t0, t1;
+	unsigned long i = 0;
+	unsigned int j;
+
+	memset(res, 0, sizeof(*res));
+	while (i < calls) {
+		t0 = now_ns();
+		for (j = 0; j < block; j++)
+			op(i++);
+		t1 = now_ns();
+		hist_record(&res->lat,
+			    (t1 - t0) * PS_PER_NS / (block * per_call));
+	}
+
+	res->ops = i * per_call;
+	res->wall_ns = now_ns() - start;
+	res->cpu_ns = cpu_ns() - cpu_start;
+}
+
+static void log_drain(void)
+{
+	struct kalert_log_stats st;
+
+	/* the next measurement starts with an idle writer */
+	for (;;) {
+		kalert_event_get_stats(&st);
+		if (st.written + st.dropped >= st.queued)
+			break;
+		usleep(1000);
+	}
+}
+
+/* Rounds the log ring absorbs, the writer catches up between them */
+static void run_log_micro(micro_fn op, unsigned long calls,
+			  struct bench_result *res)
+{
+	struct bench_result round;
+	unsigned long done;
+	unsigned int i;
+
+	/* lets log_drain() return without waiting for a flush */
+	kalert_event_log_config(1, KALERT_LOG_DURABLE_NONE);
+
+	memset(res, 0, sizeof(*res));
+	for (done = 0; done < calls; done += LOG_ROUND) {
+		run_micro(op, LOG_ROUND, 1, 1, &round);
+		log_drain();
+
+		res->ops += round.ops;
+		res->wall_ns += round.wall_ns;
+		res->cpu_ns += round.cpu_ns;
+		for (i = 0; i < HIST_BUCKETS; i++)
+			res->lat.bucket[i] += round.lat.bucket[i];
+	}
+
+	kalert_event_log_config(flush_ms, KALERT_LOG_DURABLE_NONE);
+}
+
+static void run_micros(unsigned long iters)
+{
+	struct bench_result res;
+	struct kalert_log_stats before, after;
+	char extra[64];
+
+	run_micro(op_notify_valid, iters, MICRO_BLOCK, 1, &res);
+	report("notify_valid", &res, PS_PER_NS, NULL);
+
+	run_micro(op_event_name, iters, MICRO_BLOCK, 1, &res);
+	report("event_name", &res, PS_PER_NS, NULL);
+
+	run_micro(op_events_to_bitmap, iters, MICRO_BLOCK, 1, &res);
+	report("events_to_bitmap", &res, PS_PER_NS, NULL);
+
+	run_micro(op_parse, iters / PARSE_BATCH ?: 1, MICRO_BLOCK / 16,
+		  PARSE_BATCH, &res);
+	report("parse_notify", &res, PS_PER_NS, NULL);
+
+	/* every call on its own, the ring makes it cheap but not free */
+	kalert_event_get_stats(&before);
+	run_log_micro(op_kalert_event, iters / 10 ?: 1, &res);
+	kalert_event_get_stats(&after);
+	snprintf(extra, sizeof(extra), " dropped=%llu",
+		 (unsigned long long)(after.overflows - before.overflows));
+	report("kalert_event", &res, PS_PER_NS, extra);
+
+	kalert_event_get_stats(&before);
+	run_log_micro(op_json_event, iters / 10 ?: 1, &res);
+	kalert_event_get_stats(&after);
+	snprintf(extra, sizeof(extra), " dropped=%llu",
+		 (unsigned long long)(after.overflows - before.overflows));
+	report("json_event", &res, PS_PER_NS, extra);
+}
+
+/* ------------------------- End to end --------------------------- */
+
+struct e2e_run {
+	struct kalert_handle *h;
+	unsigned long seq;
+	struct notify_log nlog;
+	struct bench_result res;
+	struct hist rx;
+};
+
+/* kalertd's own callback, timed */
+static void e2e_notify(const struct kalert_notify_msg *notify, void *data)
+{
+	struct e2e_run *run = data;
+	uint64_t rx_ns = kalert_dispatch_ts(run->h);
+	uint64_t real_ns = realtime_ns();
+	long long sent;
+
+	hist_record(&run->rx, real_ns > rx_ns ? real_ns - rx_ns : 0);
+	notify_log(notify, &run->nlog);
+	run->seq++;
+	if (notify->len < sizeof(sent))
+		return;
+	memcpy(&sent, notify->data, sizeof(sent));
+	hist_record(&run->res.lat, now_ns() - sent);
+}
+
+static int run_e2e(uint32_t rate, int seconds)
+{
+	struct kalert_fake_config cfg = { .rate = rate, .stamp = true };
+	struct kalert_log_stats before, after;
+	struct kalert_fake_stats fs;
+	struct hist w0, w;
+	struct kalert_handle *h;
+	struct e2e_run run = { 0 };
+	struct pollfd pfd;
+	char name[32], extra[224];
+	uint64_t start, end;
+	double cpu_start;
+	unsigned int i;
+	int rc;
+
+	h = kalert_handle_open_fake(&cfg);
+	if (!h) {
+		fprintf(stderr, "failed to open fake kalert channel\n");
+		return -1;
+	}
+	run.h = h;
+
+	/* no budgets and no coalescing, every notification makes a line */
+	rl_init(&limiter, KALERT_LEVEL_MAX);
+	coalesce_init(&storm, 0);
+	run.nlog.h = h;
+	run.nlog.limiter = &limiter;
+	run.nlog.storm = &storm;
+	run.nlog.text = true;
+	kalert_consumer_add(h, NULL, 0, KALERT_LEVEL_ALL, e2e_notify, &run);
+
+	log_drain();
+	kalert_event_get_stats(&before);
+	for (i = 0; i < HIST_BUCKETS; i++)
+		w0.bucket[i] = __atomic_load_n(&write_lat.bucket[i],
+					       __ATOMIC_RELAXED);
+
+	if (kalert_handle_subscribe_type(h, ~0ULL, KALERT_LEVEL_ALL) < 0) {
+		fprintf(stderr, "failed to subscribe kernel fault events\n");
+		kalert_handle_close(h);
+		return -1;
+	}
+
+	pfd.fd = kalert_handle_fd(h);
+	pfd.events = POLLIN;
+	start = now_ns();
+	end = start + (uint64_t)seconds * 1000000000;
+	cpu_start = cpu_ns();
+	while (now_ns() < end) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		rc = kalert_dispatch(h, 0);
+		if (rc < 0 && rc != -EAGAIN) {
+			fprintf(stderr, "kalert_dispatch: %s\n", strerror(-rc));
+			break;
+		}
+	}
+	run.res.ops = run.seq;
+	run.res.wall_ns = now_ns() - start;
+	run.res.cpu_ns = cpu_ns() - cpu_start;
+
+	kalert_fake_get_stats(h, &fs);
+	kalert_handle_close(h);
+
+	log_drain();
+	kalert_event_get_stats(&after);
+	memset(&w, 0, sizeof(w));
+	for (i = 0; i < HIST_BUCKETS; i++)
+		w.bucket[i] = __atomic_load_n(&write_lat.bucket[i],
+					      __ATOMIC_RELAXED) -
+			      w0.bucket[i];
+
+	snprintf(name, sizeof(name), "e2e_%u", rate);
+	snprintf(extra, sizeof(extra),
+		 " rate=%u lost=%llu dropped=%llu rx_p50_ns=%llu "
+		 "rx_p99_ns=%llu write_p50_ns=%llu write_p99_ns=%llu "
+		 "write_p999_ns=%llu",
+		 rate, (unsigned long long)fs.lost,
+		 (unsigned long long)(after.overflows - before.overflows),
+		 (unsigned long long)hist_quantile(&run.rx, 0.5),
+		 (unsigned long long)hist_quantile(&run.rx, 0.99),
+		 (unsigned long long)hist_quantile(&w, 0.5),
+		 (unsigned long long)hist_quantile(&w, 0.99),
+		 (unsigned long long)hist_quantile(&w, 0.999));
+	report(name, &run.res, 1, extra);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-m micro|e2e|both] [-n iterations] [-d seconds] "
+		"[-r rate[,rate...]] [-f flush_ms] [-o log]\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t rates[E2E_RATES_MAX] = { 10000, 100000, 1000000 };
+	unsigned int nrates = 3, i;
+	const char *log = "/tmp/event_bench.log";
+	unsigned long iters = 10000000;
+	bool micro = true, e2e = true;
+	int seconds = 5;
+	char *p;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:n:d:r:f:o:")) != -1) {
+		switch (opt) {
+		case 'm':
+			micro = strcmp(optarg, "e2e") != 0;
+			e2e = strcmp(optarg, "micro") != 0;
+			break;
+		case 'n':
+			iters = strtoul(optarg, NULL, 0) ?: 1;
+			break;
+		case 'd':
+			seconds = atoi(optarg) ?: 1;
+			break;
+		case 'r':
+			nrates = 0;
+			for (p = optarg; *p && nrates < E2E_RATES_MAX; p++) {
+				rates[nrates++] = strtoul(p, &p, 0);
+				if (*p != ',')
+					break;
+			}
+			break;
+		case 'f':
+			flush_ms = strtoul(optarg, NULL, 0) ?: 1;
+			break;
+		case 'o':
+			log = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	setup_samples();
+
+	/* rotation off, the file is removed at the end */
+	kalert_event_log_rotation(0, 0, 0);
+	kalert_event_log_config(flush_ms, KALERT_LOG_DURABLE_NONE);
+	kalert_event_log_latency(&write_lat);
+	if (kalert_event_log_init(log) < 0) {
+		fprintf(stderr, "failed to open %s\n", log);
+		return 1;
+	}
+
+	if (micro)
+		run_micros(iters);
+
+	for (i = 0; e2e && i < nrates; i++) {
+		if (rates[i] && run_e2e(rates[i], seconds) < 0)
+			break;
+	}
+
+	kalert_event_log_close();
+	unlink(log);
+	return 0;
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Receive path benchmark, one recvfrom() per event versus
+ * kalert_get_reply_batch().
+ *
+ * The tool subscribes to every notification type and drains the socket
+ * for a fixed time. Against the real kernel it has to run while alerts
+ * are being produced (e.g. under fault injection); with -f it runs on
+ * the in-process fake kernel at the given rate.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <libkalert/libkalert.h>
+
+enum bench_mode { MODE_SINGLE, MODE_BATCH };
+
+struct bench_result {
+	unsigned long long events;
+	unsigned long long syscalls;
+	double wall;
+	double cpu;
+};
+
+static struct kalert_reply_slot slots[KALERT_REPLY_BATCH_MAX];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	/* this thread only, the fake kernel runs in another one */
+	getrusage(RUSAGE_THREAD, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* Drain everything currently queued, return false on a hard error */
+static bool drain(struct kalert_handle *h, enum bench_mode mode,
+		  unsigned int batch, struct bench_result *res)
+{
+	int rc, i;
+
+	for (;;) {
+		res->syscalls++;
+		if (mode == MODE_SINGLE) {
+			rc = kalert_handle_get_reply(h, &slots[0].msg,
+						     GET_REPLY_NONBLOCKING, 0);
+			if (rc > 0)
+				res->events++;
+		} else {
+			rc = kalert_handle_get_reply_batch(
+				h, slots, batch, GET_REPLY_NONBLOCKING);
+			for (i = 0; i < rc; i++) {
+				if (slots[i].len > 0)
+					res->events++;
+			}
+		}
+
+		if (rc == -EAGAIN)
+			return true;
+		if (rc < 0)
+			return false;
+	}
+}
+
+static int run(struct kalert_handle *h, enum bench_mode mode,
+	       unsigned int batch, int seconds, struct bench_result *res)
+{
+	struct pollfd pfd = { .fd = kalert_handle_fd(h), .events = POLLIN };
+	double start, end, cpu_start;
+
+	memset(res, 0, sizeof(*res));
+	start = now();
+	end = start + seconds;
+	cpu_start = cpu_time();
+
+	while (now() < end) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		if (!drain(h, mode, batch, res))
+			return -1;
+	}
+
+	res->wall = now() - start;
+	res->cpu = cpu_time() - cpu_start;
+	return 0;
+}
+
+static void report(const char *name, const struct bench_result *res)
+{
+	printf("%-8s events=%llu events/sec=%.0f syscalls/event=%.3f "
+	       "cpu_ns/event=%.0f\n",
+	       name, res->events, res->events / res->wall,
+	       res->events ? (double)res->syscalls / res->events : 0.0,
+	       res->events ? res->cpu * 1e9 / res->events : 0.0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-d seconds] [-b batch] [-m single|batch|both] "
+		"[-f rate]\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct kalert_fake_config fake = { 0 };
+	struct kalert_handle *h;
+	struct bench_result res;
+	unsigned int batch = KALERT_REPLY_BATCH_MAX;
+	int seconds = 10;
+	bool single = true, batched = true;
+	bool use_fake = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:m:f:")) != -1) {
+		switch (opt) {
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			if (batch == 0 || batch > KALERT_REPLY_BATCH_MAX)
+				batch = KALERT_REPLY_BATCH_MAX;
+			break;
+		case 'm':
+			single = strcmp(optarg, "batch") != 0;
+			batched = strcmp(optarg, "single") != 0;
+			break;
+		case 'f':
+			use_fake = true;
+			fake.rate = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	h = use_fake ? kalert_handle_open_fake(&fake) : kalert_handle_open();
+	if (!h) {
+		fprintf(stderr, "failed to open kalert channel\n");
+		return 1;
+	}
+
+	if (kalert_handle_subscribe_type(h, ~0ULL, KALERT_LEVEL_ALL) < 0) {
+		fprintf(stderr, "failed to subscribe kernel fault events\n");
+		kalert_handle_close(h);
+		return 1;
+	}
+
+	if (single) {
+		if (run(h, MODE_SINGLE, 1, seconds, &res) == 0)
+			report("single", &res);
+	}
+
+	if (batched) {
+		if (run(h, MODE_BATCH, batch, seconds, &res) == 0)
+			report("batch", &res);
+	}
+
+	kalert_handle_close(h);
+	return 0;
+}
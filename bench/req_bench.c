@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Request encoding benchmark, 8 KB zeroed struct
+ * kalert_message per request versus right sized builder buffers.
+ *
+ * The "legacy" rows reproduce what every request path used to do: a
+ * struct kalert_message on the stack, memset, then encode. The "compact"
+ * rows encode into a KALERT_*_REQ_SIZE buffer. With -f the tool also
+ * times complete kalert_handle_set_filter_level() round trips against the
+ * in-process fake kernel.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <libkalert/libkalert.h>
+
+enum req_kind { REQ_SET_CHNL, REQ_SUB_TYPE, REQ_SUB_EVENT, REQ_STATUS };
+
+static const char *const kind_str[] = {
+	[REQ_SET_CHNL] = "set_chnl",
+	[REQ_SUB_TYPE] = "sub_type",
+	[REQ_SUB_EVENT] = "sub_event",
+	[REQ_STATUS] = "status",
+};
+
+static const size_t kind_size[] = {
+	[REQ_SET_CHNL] = KALERT_SET_CHNL_REQ_SIZE,
+	[REQ_SUB_TYPE] = KALERT_SUB_TYPE_REQ_SIZE,
+	[REQ_SUB_EVENT] = KALERT_SUB_EVENT_REQ_SIZE,
+	[REQ_STATUS] = KALERT_STATUS_REQ_SIZE,
+};
+
+static const int ids[] = { KALERT_GEN_SOFTLOCKUP, KALERT_MEM_LEAK,
+			   KALERT_FS_EXT4_ERR };
+
+static volatile int sink;
+
+static double cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int build(enum req_kind kind, void *buf, size_t size, unsigned long i)
+{
+	uint64_t attr[KALERT_ATTR_MAX];
+
+	switch (kind) {
+	case REQ_SET_CHNL:
+		attr[KALERT_FILTER_LEVEL] = i % KALERT_LEVEL_MAX;
+		return kalert_build_set_chnl(buf, size,
+					     KALERT_MASK(KALERT_FILTER_LEVEL),
+					     attr);
+	case REQ_SUB_TYPE:
+		return kalert_build_subscribe_type(buf, size, ~0ULL,
+						   i % KALERT_LEVEL_MAX);
+	case REQ_SUB_EVENT:
+		return kalert_build_subscribe_event(buf, size, ids,
+						    KALERT_ARRAY_SIZE(ids),
+						    i % KALERT_LEVEL_MAX);
+	case REQ_STATUS:
+		return kalert_build_status(buf, size, i);
+	}
+	return -EINVAL;
+}
+
+static double run_legacy(enum req_kind kind, unsigned long iters)
+{
+	double start = cpu_ns();
+	unsigned long i;
+
+	for (i = 0; i < iters; i++) {
+		struct kalert_message msg;
+
+		memset(&msg, 0, sizeof(msg));
+		sink = build(kind, &msg, sizeof(msg), i);
+	}
+	return (cpu_ns() - start) / iters;
+}
+
+static double run_compact(enum req_kind kind, unsigned long iters)
+{
+	double start = cpu_ns();
+	unsigned long i;
+
+	for (i = 0; i < iters; i++) {
+		char buf[KALERT_REQ_MAX_SIZE]
+			__attribute__((aligned(NLMSG_ALIGNTO)));
+
+		sink = build(kind, buf, kind_size[kind], i);
+	}
+	return (cpu_ns() - start) / iters;
+}
+
+static int run_roundtrip(unsigned long iters)
+{
+	struct kalert_handle *h;
+	struct timespec t0, t1;
+	double cpu_start, wall;
+	unsigned long i;
+
+	h = kalert_handle_open_fake(NULL);
+	if (!h) {
+		fprintf(stderr, "failed to open fake kalert channel\n");
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	cpu_start = cpu_ns();
+	for (i = 0; i < iters; i++) {
+		if (kalert_handle_set_filter_level(h, i % KALERT_LEVEL_MAX)) {
+			fprintf(stderr, "request %lu failed\n", i);
+			kalert_handle_close(h);
+			return -1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	wall = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+	printf("%-10s %-8s wall_ns/req=%.0f cpu_ns/req=%.0f\n", "set_level",
+	       "fake", wall / iters, (cpu_ns() - cpu_start) / iters);
+	kalert_handle_close(h);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n iterations] [-f]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iters = 1000000;
+	bool roundtrip = false;
+	enum req_kind kind;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:f")) != -1) {
+		switch (opt) {
+		case 'n':
+			iters = strtoul(optarg, NULL, 0) ?: 1;
+			break;
+		case 'f':
+			roundtrip = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	for (kind = REQ_SET_CHNL; kind <= REQ_STATUS; kind++) {
+		printf("%-10s %-8s cpu_ns/req=%.1f buf_bytes=%zu\n",
+		       kind_str[kind], "legacy", run_legacy(kind, iters),
+		       sizeof(struct kalert_message));
+		printf("%-10s %-8s cpu_ns/req=%.1f buf_bytes=%zu\n",
+		       kind_str[kind], "compact", run_compact(kind, iters),
+		       kind_size[kind]);
+	}
+
+	if (roundtrip && run_roundtrip(iters / 10 ?: 1) < 0)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Binary event log, fixed width records in preallocated
+ * memory mapped segment files
+ *
+ * A log is a directory of segments named kalert-<first seq>.kbl. Each
+ * segment is a struct kalert_binlog_header followed by room for
+ * header.capacity records. The writer fills a record, then publishes it
+ * by storing header.count with release semantics, so readers may map a
+ * segment that is still being written and see a consistent prefix.
+ */
+
+#ifndef LIBKALERT_BINLOG_H
+#define LIBKALERT_BINLOG_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/kalert.h>
+
+#define KALERT_BINLOG_MAGIC "KALBLOG"
+#define KALERT_BINLOG_VERSION 1
+#define KALERT_BINLOG_PREFIX "kalert-"
+#define KALERT_BINLOG_SUFFIX ".kbl"
+
+/* Default segment size in bytes, about 512k records */
+#define KALERT_BINLOG_SEGMENT_SIZE (16 << 20)
+
+/**
+ * struct kalert_binlog_header - first bytes of every segment
+ * @magic:       KALERT_BINLOG_MAGIC, NUL terminated
+ * @version:     KALERT_BINLOG_VERSION
+ * @record_size: sizeof(struct kalert_binlog_record)
+ * @hdr_size:    offset of the first record
+ * @capacity:    records the segment has room for
+ * @first_seq:   seq of the first record
+ * @created_ns:  CLOCK_REALTIME when the segment was created
+ * @count:       records published so far, see the file comment
+ * @sealed:      set once the writer moved on to the next segment
+ */
+struct kalert_binlog_header {
+	char magic[8];
+	uint16_t version;
+	uint16_t record_size;
+	uint32_t hdr_size;
+	uint64_t capacity;
+	uint64_t first_seq;
+	uint64_t created_ns;
+	uint64_t count;
+	uint32_t sealed;
+	uint32_t reserved[3];
+};
+
+/**
+ * struct kalert_binlog_record - one notification
+ * @ts_ns: CLOCK_REALTIME when kalertd received it
+ * @seq:   position in the log, continues across segments and restarts
+ * @type:  enum kalert_notify_type
+ * @event: event id
+ * @level: enum kalert_level
+ * @flags: reserved, 0
+ */
+struct kalert_binlog_record {
+	uint64_t ts_ns;
+	uint64_t seq;
+	uint32_t type;
+	uint32_t event;
+	uint32_t level;
+	uint32_t flags;
+};
+
+/* ----------------------------- Writer ------------------------------ */
+
+struct kalert_binlog;
+
+struct kalert_binlog *kalert_binlog_open(const char *dir, size_t seg_size);
+int kalert_binlog_append(struct kalert_binlog *log, uint64_t ts_ns,
+			 const struct kalert_notify_msg *notify);
+void kalert_binlog_set_limits(struct kalert_binlog *log, unsigned int max_age,
+			      unsigned int keep);
+int kalert_binlog_sync(struct kalert_binlog *log);
+void kalert_binlog_close(struct kalert_binlog *log);
+
+/* ----------------------------- Reader ------------------------------ */
+
+/**
+ * struct kalert_binlog_segment - read only mapping of one segment
+ * @hdr:     segment header
+ * @rec:     first record
+ * @count:   records valid when the segment was opened
+ * @map_len: length of the mapping
+ */
+struct kalert_binlog_segment {
+	const struct kalert_binlog_header *hdr;
+	const struct kalert_binlog_record *rec;
+	uint64_t count;
+	size_t map_len;
+};
+
+/* Return 0 to continue the scan, anything else stops it */
+typedef int (*kalert_binlog_cb_t)(const struct kalert_binlog_record *rec,
+				  void *data);
+
+int kalert_binlog_segment_open(const char *path,
+			       struct kalert_binlog_segment *seg);
+void kalert_binlog_segment_close(struct kalert_binlog_segment *seg);
+int kalert_binlog_scan(const char *path, kalert_binlog_cb_t cb, void *data);
+
+#endif /* LIBKALERT_BINLOG_H */
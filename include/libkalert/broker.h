@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Shared memory fan-out of notifications to local readers
+ *
+ * kalertd owns the only kernel channel and republishes every notification
+ * into a ring in a memfd: a struct kalert_broker_header, then
+ * header.capacity records. The writer fills a record and publishes it by
+ * storing header.head with release semantics; nothing is ever copied per
+ * reader. The ring is sealed against writes by anybody but the broker.
+ *
+ * A reader connects to the broker socket and passes an eventfd with
+ * SCM_RIGHTS. The broker answers with a struct kalert_broker_welcome, the
+ * ring memfd and a memfd of its own holding its struct
+ * kalert_broker_reader, the only memory it may write. Each reader keeps
+ * its own cursor in its slot and sets
+ * "armed" before it sleeps; the broker only writes the eventfds of armed
+ * readers, once per receive batch. A reader more than capacity records
+ * behind loses the oldest ones and counts them in its slot, the broker
+ * never waits for anybody. Closing the connection frees the slot.
+ *
+ * kalert_handle_open_broker() in libkalert.h is the reader side, behind
+ * the usual handle and dispatch API.
+ */
+
+#ifndef LIBKALERT_BROKER_H
+#define LIBKALERT_BROKER_H
+#include <stdint.h>
+#include <linux/kalert.h>
+
+#define KALERT_BROKER_MAGIC "KALBRKR"
+#define KALERT_BROKER_VERSION 2
+#define KALERT_BROKER_SOCKET "/run/kalertd/broker.sock"
+
+/* Reader slots, one bit each in a 64-bit word */
+#define KALERT_BROKER_READERS 64
+
+/* Default ring size in records */
+#define KALERT_BROKER_CAPACITY 65536
+
+/* Room for the notification and its payload in a record */
+#define KALERT_BROKER_MSG_MAX 104
+
+/**
+ * struct kalert_broker_header - first bytes of the shared memory
+ * @magic:       KALERT_BROKER_MAGIC, NUL terminated
+ * @version:     KALERT_BROKER_VERSION
+ * @record_size: sizeof(struct kalert_broker_record)
+ * @hdr_size:    offset of the first record
+ * @capacity:    records in the ring, a power of two
+ * @readers:     number of reader slots of the broker
+ * @head:        records ever published, written by the broker only
+ */
+struct kalert_broker_header {
+	char magic[8];
+	uint16_t version;
+	uint16_t record_size;
+	uint32_t hdr_size;
+	uint32_t capacity;
+	uint32_t readers;
+	uint64_t head __attribute__((aligned(64)));
+};
+
+/**
+ * struct kalert_broker_reader - one reader slot, in a memfd of its own
+ * @active:  set by the broker while the slot is connected
+ * @armed:   set by the reader before sleeping, cleared by the broker
+ *           when it writes the eventfd
+ * @pid:     reader's pid, from SO_PEERCRED
+ * @cursor:  next record the reader will look at
+ * @lost:    records overwritten before the reader got to them
+ * @wakeups: eventfd writes by the broker
+ */
+struct kalert_broker_reader {
+	uint32_t active;
+	uint32_t armed;
+	uint32_t pid;
+	uint32_t reserved;
+	uint64_t cursor;
+	uint64_t lost;
+	uint64_t wakeups;
+} __attribute__((aligned(64)));
+
+/**
+ * struct kalert_broker_record - one notification, two cache lines
+ * @seq:   position in the ring, for torn read checks
+ * @ts_ns: CLOCK_REALTIME when kalertd received it
+ * @len:   valid bytes in @msg
+ * @flags: KALERT_BROKER_TRUNCATED if the payload did not fit
+ * @msg:   struct kalert_notify_msg and its payload
+ */
+struct kalert_broker_record {
+	uint64_t seq;
+	uint64_t ts_ns;
+	uint32_t len;
+	uint32_t flags;
+	char msg[KALERT_BROKER_MSG_MAX] __attribute__((aligned(8)));
+};
+
+#define KALERT_BROKER_TRUNCATED 0x1
+
+/* Sent by the reader along with its eventfd */
+struct kalert_broker_hello {
+	uint32_t version;
+};
+
+/**
+ * struct kalert_broker_welcome - broker's answer, the memfds come with it
+ * @status: 0, or a negative errno and no memfd
+ * @slot:   reader slot index
+ * @size:   size of the ring memfd, the slot memfd is passed second
+ */
+struct kalert_broker_welcome {
+	int32_t status;
+	uint32_t slot;
+	uint64_t size;
+};
+
+/* ----------------------------- Broker ------------------------------ */
+
+struct kalert_broker;
+
+struct kalert_broker_stats {
+	uint64_t published; /* records written to the ring */
+	uint64_t truncated; /* records with a clipped payload */
+	uint64_t wakeups; /* eventfd writes */
+	uint64_t connects; /* readers accepted */
+	uint64_t rejects; /* readers refused, no slot or bad hello */
+	uint32_t readers; /* readers connected now */
+	uint64_t max_lag; /* records the slowest reader is behind */
+	uint64_t lost; /* records the readers lost, summed */
+};
+
+struct kalert_broker *kalert_broker_open(const char *path,
+					 unsigned int capacity);
+int kalert_broker_fd(const struct kalert_broker *b);
+int kalert_broker_process(struct kalert_broker *b);
+void kalert_broker_publish(struct kalert_broker *b, uint64_t ts_ns,
+			   const struct kalert_notify_msg *notify);
+void kalert_broker_wake(struct kalert_broker *b);
+void kalert_broker_get_stats(const struct kalert_broker *b,
+			     struct kalert_broker_stats *stats);
+void kalert_broker_close(struct kalert_broker *b);
+
+#endif /* LIBKALERT_BROKER_H */
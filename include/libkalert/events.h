@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Metadata of kalert events, types, levels and channel
+ * attributes, generated from the X-macro lists below
+ */
+
+#ifndef LIBKALERT_EVENTS_H
+#define LIBKALERT_EVENTS_H
+#include <linux/kalert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef U16_MAX
+#define U16_MAX 65535
+#endif
+
+#ifndef KALERT_EVENT_HEARTBEAT
+#define KALERT_EVENT_HEARTBEAT U16_MAX
+#endif
+
+/*
+ * X(id, name, type, default level) for every event of linux/kalert.h.
+ * This is the only place to touch when the kernel adds an event; names
+ * are emitted into JSON as is, so they must not need escaping.
+ */
+// clang-format off
+#define KALERT_EVENT_LIST(X)							\
+	X(KALERT_GEN_SOFTLOCKUP, "softlockup",     KALERT_NOTIFY_GEN, KALERT_WARN)	\
+	X(KALERT_GEN_RCUSTALL,   "rcu stall",      KALERT_NOTIFY_GEN, KALERT_WARN)	\
+	X(KALERT_GEN_HUNGTASK,   "hung task",      KALERT_NOTIFY_GEN, KALERT_WARN)	\
+	X(KALERT_MEM_ALLOCFAIL,  "mem alloc fail", KALERT_NOTIFY_MEM, KALERT_WARN)	\
+	X(KALERT_MEM_OOM,        "oom",            KALERT_NOTIFY_MEM, KALERT_ERROR)	\
+	X(KALERT_MEM_BAD_STATE,  "bad mem state",  KALERT_NOTIFY_MEM, KALERT_ERROR)	\
+	X(KALERT_MEM_LEAK,       "mem leak",       KALERT_NOTIFY_MEM, KALERT_WARN)	\
+	X(KALERT_FS_EXT4_ERR,    "ext4 err",       KALERT_NOTIFY_FS,  KALERT_ERROR)
+
+/* X(type, name) */
+#define KALERT_TYPE_LIST(X)			\
+	X(KALERT_NOTIFY_ALL,   "unknow")	\
+	X(KALERT_NOTIFY_GEN,   "generic")	\
+	X(KALERT_NOTIFY_MEM,   "mem")		\
+	X(KALERT_NOTIFY_IO,    "io")		\
+	X(KALERT_NOTIFY_FS,    "fs")		\
+	X(KALERT_NOTIFY_SCHED, "sched")		\
+	X(KALERT_NOTIFY_NET,   "net")		\
+	X(KALERT_NOTIFY_RAS,   "ras")		\
+	X(KALERT_NOTIFY_VIRT,  "virtual")	\
+	X(KALERT_NOTIFY_SEC,   "security")
+
+/* X(level, name) */
+#define KALERT_LEVEL_LIST(X)			\
+	X(KALERT_LEVEL_ALL, "unknow")		\
+	X(KALERT_INFO,      "info")		\
+	X(KALERT_WARN,      "warn")		\
+	X(KALERT_ERROR,     "error")		\
+	X(KALERT_FATAL,     "fatal")
+
+/* X(attr, name) */
+#define KALERT_CHNL_ATTR_LIST(X)			\
+	X(KALERT_ATTR_UNSPEC,    "unknow")		\
+	X(KALERT_ENABLE,         "enable")		\
+	X(KALERT_PORTID,         "portid")		\
+	X(KALERT_FILTER_LEVEL,   "filter_level")	\
+	X(KALERT_BACKLOG_LIMIT,  "backlog_limit")	\
+	X(KALERT_BACKLOG_DEPTH,  "backlog_depth")	\
+	X(KALERT_PACKLOSS_COUNT, "packloss_count")	\
+	X(KALERT_GET_STAT_MASK,  "get_stat_mask")
+// clang-format on
+
+/*
+ * A name with its length and its quoted JSON form precomputed, so
+ * formatters can copy it without strlen() or escaping.
+ */
+struct kalert_name {
+	const char *str;
+	const char *json; /* str as a JSON string, quotes included */
+	uint16_t len;
+	uint16_t json_len;
+};
+
+struct kalert_event_info {
+	struct kalert_name name;
+	uint32_t event; /* 0 for ids the list does not name */
+	uint32_t type; /* owning KALERT_NOTIFY_* type */
+	uint32_t level; /* default level */
+	bool known; /* listed in KALERT_EVENT_LIST */
+};
+
+/*
+ * Indexed by event - KALERT_EVENT_BASE. Every slot is valid: ids the list
+ * does not name carry "unknown". The two extra slots at the end describe
+ * the heartbeat and ids outside the event range.
+ */
+extern const struct kalert_event_info kalert_events[KALERT_EVENT_MAX + 2];
+extern const struct kalert_name kalert_types[KALERT_NOTIFY_MAX];
+extern const struct kalert_name kalert_levels[KALERT_LEVEL_MAX];
+extern const struct kalert_name kalert_chnl_attrs[KALERT_ATTR_MAX];
+
+/* Placeholder returned for out of range types, levels and attributes */
+extern const struct kalert_name kalert_name_unknown;
+
+/* Metadata of @event, never NULL */
+static inline const struct kalert_event_info *kalert_event_info(uint32_t event)
+{
+	uint32_t idx = event - KALERT_EVENT_BASE;
+
+	if (idx < KALERT_EVENT_MAX)
+		return &kalert_events[idx];
+	if (event == KALERT_EVENT_HEARTBEAT)
+		return &kalert_events[KALERT_EVENT_MAX];
+	return &kalert_events[KALERT_EVENT_MAX + 1];
+}
+
+static inline const struct kalert_name *kalert_type_name(uint32_t type)
+{
+	return type < KALERT_NOTIFY_MAX ? &kalert_types[type] :
+					  &kalert_name_unknown;
+}
+
+static inline const struct kalert_name *kalert_level_name(uint32_t level)
+{
+	return level < KALERT_LEVEL_MAX ? &kalert_levels[level] :
+					  &kalert_name_unknown;
+}
+
+static inline const struct kalert_name *kalert_chnl_attr_name(uint32_t attr)
+{
+	return attr < KALERT_ATTR_MAX ? &kalert_chnl_attrs[attr] :
+					&kalert_name_unknown;
+}
+
+#endif /* LIBKALERT_EVENTS_H */
@@ -16,6 +16,7 @@
 #include <sys/poll.h>
 #include <syslog.h>
 #include <stdbool.h>
+#include <libkalert/events.h>
 
 #define kalert_msg(priority, format, ...) \
 	syslog(priority, format, ##__VA_ARGS__)
@@ -43,69 +44,56 @@
 #define kalert_subscribe_event(fd, ids, level) \
 	__kalert_subscribe_event(fd, ids, KALERT_ARRAY_SIZE(ids), level)
 
+/* Handle based variant of kalert_subscribe_event() */
+#define kalert_handle_subscribe_event(h, ids, level) \
+	__kalert_handle_subscribe_event(h, ids, KALERT_ARRAY_SIZE(ids), level)
+
 #define KALERT_MAX_MSG_SIZE 8192 // MNL_SOCKET_BUFFER_SIZE
 #define KALERT_MASK(type) (1U << (type))
 
-#ifndef U16_MAX
-#define U16_MAX 65535
-#endif
-
-#ifndef KALERT_EVENT_HEARTBEAT
-#define KALERT_EVENT_HEARTBEAT U16_MAX
-#endif
-
 struct kalert_message {
 	struct nlmsghdr nlh;
 	char data[KALERT_MAX_MSG_SIZE];
 };
 
-// clang-format off
-/* kalert channel attribute -> string map */
-static const char* const kalert_chnl_attr_to_str[] = {
-	[KALERT_ATTR_UNSPEC] = "unknow",
-	[KALERT_ENABLE] = "enable",
-	[KALERT_PORTID] = "portid",
-	[KALERT_FILTER_LEVEL] = "filter_level",
-	[KALERT_BACKLOG_LIMIT] = "backlog_limit",
-	[KALERT_BACKLOG_DEPTH] = "backlog_depth",
-	[KALERT_PACKLOSS_COUNT] = "packloss_count",
-	[KALERT_GET_STAT_MASK] = "get_stat_mask"
-};
+/*
+ * Upper bounds of the encoded size of each request, for buffers handed to
+ * the kalert_build_*() request builders.
+ */
+#define KALERT_U32_ATTR_SIZE NLA_ALIGN(NLA_HDRLEN + sizeof(uint32_t))
+#define KALERT_U64_ATTR_SIZE NLA_ALIGN(NLA_HDRLEN + sizeof(uint64_t))
+#define KALERT_EVENT_MASK_SIZE                                         \
+	(sizeof(unsigned long) *                                       \
+	 ((KALERT_EVENT_MAX + 8 * sizeof(unsigned long) - 1) /         \
+	  (8 * sizeof(unsigned long))))
 
-static const char* const kalert_type_str[] = {
-	[KALERT_NOTIFY_ALL] = "unknow",
-	[KALERT_NOTIFY_GEN] = "generic",
-	[KALERT_NOTIFY_MEM] = "mem",
-	[KALERT_NOTIFY_IO] = "io",
-	[KALERT_NOTIFY_FS] = "fs",
-	[KALERT_NOTIFY_SCHED] = "sched",
-	[KALERT_NOTIFY_NET] = "net",
-	[KALERT_NOTIFY_RAS] = "ras",
-	[KALERT_NOTIFY_VIRT] = "virtual",
-	[KALERT_NOTIFY_SEC] = "security"
-};
+#define KALERT_SET_CHNL_REQ_SIZE \
+	(NLMSG_HDRLEN + KALERT_ATTR_MAX * KALERT_U32_ATTR_SIZE)
+#define KALERT_SUB_TYPE_REQ_SIZE \
+	(NLMSG_HDRLEN + KALERT_U64_ATTR_SIZE + KALERT_U32_ATTR_SIZE)
+#define KALERT_SUB_EVENT_REQ_SIZE                      \
+	(NLMSG_HDRLEN + KALERT_U32_ATTR_SIZE +         \
+	 NLA_ALIGN(NLA_HDRLEN + KALERT_EVENT_MASK_SIZE))
+#define KALERT_STATUS_REQ_SIZE (NLMSG_HDRLEN + KALERT_U64_ATTR_SIZE)
 
-static const char* const kalert_level_str[] = {
-	[KALERT_LEVEL_ALL] = "unknow",
-	[KALERT_INFO] = "info",
-	[KALERT_WARN] = "warn",
-	[KALERT_ERROR] = "error",
-	[KALERT_FATAL] = "fatal"
-};
+#define KALERT_MAX2(a, b) ((a) > (b) ? (a) : (b))
+#define KALERT_REQ_MAX_SIZE                                              \
+	KALERT_MAX2(KALERT_MAX2(KALERT_SET_CHNL_REQ_SIZE,                \
+				KALERT_SUB_TYPE_REQ_SIZE),               \
+		    KALERT_MAX2(KALERT_SUB_EVENT_REQ_SIZE,               \
+				KALERT_STATUS_REQ_SIZE))
 
-static const char * const kalert_event_str[] = {
-	[KALERT_GEN_SOFTLOCKUP - KALERT_EVENT_BASE] = "softlockup",
-	[KALERT_GEN_RCUSTALL   - KALERT_EVENT_BASE] = "rcu stall",
-	[KALERT_GEN_HUNGTASK   - KALERT_EVENT_BASE] = "hung task",
-	[KALERT_MEM_ALLOCFAIL  - KALERT_EVENT_BASE] = "mem alloc fail",
-	[KALERT_MEM_OOM        - KALERT_EVENT_BASE] = "oom",
-	[KALERT_MEM_BAD_STATE  - KALERT_EVENT_BASE] = "bad mem state",
-	[KALERT_MEM_LEAK       - KALERT_EVENT_BASE] = "mem leak",
-	[KALERT_FS_EXT4_ERR    - KALERT_EVENT_BASE] = "ext4 err",
+/* Upper bound of datagrams taken by one kalert_get_reply_batch() call */
+#define KALERT_REPLY_BATCH_MAX 64
+
+/* One reusable receive slot for kalert_get_reply_batch() */
+struct kalert_reply_slot {
+	int len; /* bytes received, or negative error if the slot was rejected */
+	uint64_t ts_ns; /* CLOCK_REALTIME the datagram was received */
+	struct kalert_message msg;
 };
-// clang-format on
 
-static inline bool kalert_notify_valid(struct kalert_notify_msg *notify)
+static inline bool kalert_notify_valid(const struct kalert_notify_msg *notify)
 {
 	if (notify->type >= KALERT_NOTIFY_MAX)
 		return false;
@@ -121,20 +109,272 @@ static inline bool kalert_notify_valid(struct kalert_notify_msg *notify)
 
 static inline const char *kalert_event_name(int eventid)
 {
-	int idx = eventid - KALERT_EVENT_BASE;
-	if (idx < 0 || (size_t)idx >= KALERT_ARRAY_SIZE(kalert_event_str))
-		return "unknown";
-	return kalert_event_str[idx] ?: "unknown";
+	return kalert_event_info(eventid)->name.str;
+}
+
+/*
+ * Zero-copy iterator over every notification in a received buffer.
+ *
+ * A single datagram may carry several netlink messages; the iterator walks
+ * them in place with NLMSG_NEXT and hands back pointers into the caller's
+ * buffer. Netlink control messages (NOOP, ERROR, DONE, ...), status
+ * replies and messages too short to hold a struct kalert_notify_msg are
+ * skipped.
+ */
+struct kalert_notify_iter {
+	struct nlmsghdr *nlh;
+	int remain;
+};
+
+static inline void kalert_notify_iter_init(struct kalert_notify_iter *iter,
+					   void *buf, int len)
+{
+	iter->nlh = (struct nlmsghdr *)buf;
+	iter->remain = len > 0 ? len : 0;
 }
 
+static inline struct kalert_notify_msg *
+kalert_notify_iter_next(struct kalert_notify_iter *iter)
+{
+	struct nlmsghdr *nlh;
+
+	while (NLMSG_OK(iter->nlh, (unsigned int)iter->remain)) {
+		nlh = iter->nlh;
+		iter->nlh = NLMSG_NEXT(iter->nlh, iter->remain);
+
+		if (nlh->nlmsg_type < NLMSG_MIN_TYPE ||
+		    nlh->nlmsg_type == KALERT_CMD_GET_STATUS)
+			continue;
+		if (NLMSG_PAYLOAD(nlh, 0) < sizeof(struct kalert_notify_msg))
+			continue;
+		return (struct kalert_notify_msg *)NLMSG_DATA(nlh);
+	}
+
+	return NULL;
+}
+
+/**
+ * kalert_for_each_notify - walk all notifications in a received buffer
+ * @notify: struct kalert_notify_msg * cursor
+ * @iter:   struct kalert_notify_iter * scratch state
+ * @buf:    received data, e.g. &slot->msg
+ * @len:    number of valid bytes in @buf, e.g. slot->len
+ *
+ * Example:
+ * @code
+ * kalert_for_each_notify(notify, &iter, &slot.msg, slot.len)
+ *	handle(notify);
+ * @endcode
+ */
+#define kalert_for_each_notify(notify, iter, buf, len)           \
+	for (kalert_notify_iter_init(iter, buf, len);            \
+	     ((notify) = kalert_notify_iter_next(iter)) != NULL;)
+
+/* Maximum number of requests in one struct kalert_batch */
+#define KALERT_BATCH_MAX 16
+
+/* Room for KALERT_BATCH_MAX requests of the largest kind, back to back */
+#define KALERT_BATCH_BUF_SIZE \
+	(KALERT_BATCH_MAX * NLMSG_ALIGN(KALERT_REQ_MAX_SIZE))
+
+/*
+ * A set of SET_CHNL / SUBSCRIBE requests sent with one syscall and
+ * acknowledged in one wait. Start with kalert_batch_init(); after
+ * kalert_batch_commit(), err[i] holds the ACK status of request i.
+ */
+struct kalert_batch {
+	unsigned int count;
+	unsigned int used;
+	unsigned int offset[KALERT_BATCH_MAX];
+	int err[KALERT_BATCH_MAX];
+	char buf[KALERT_BATCH_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+};
+
+/*
+ * Counters of the per-socket queue holding notifications that arrived
+ * while a request was waiting for its ACK.
+ */
+struct kalert_queue_stats {
+	uint64_t queued; /* notifications parked during an ACK wait */
+	uint64_t delivered; /* parked notifications returned to the caller */
+	uint64_t dropped; /* notifications lost because the queue was full */
+};
+
+/*
+ * Everything known about notifications that never reached the caller,
+ * see kalert_handle_get_loss_stats().
+ */
+struct kalert_loss_stats {
+	uint64_t overruns; /* receive buffer overflows (ENOBUFS) */
+	uint64_t queue_dropped; /* same as kalert_queue_stats.dropped */
+	uint64_t kernel_packloss; /* KALERT_PACKLOSS_COUNT from the kernel */
+	bool kernel_valid; /* kernel_packloss was fetched */
+};
+
+/*
+ * Decoded KALERT_CMD_GET_STATUS reply. mask has KALERT_MASK(attr) set for
+ * every attribute the kernel returned; the other fields stay 0.
+ */
+struct kalert_status {
+	uint32_t mask;
+	uint32_t enable;
+	uint32_t portid;
+	uint32_t filter_level;
+	uint32_t backlog_limit;
+	uint32_t backlog_depth; /* notifications waiting in the kernel */
+	uint64_t packloss_count; /* notifications the kernel failed to send */
+};
+
+/* Every attribute KALERT_GET_STAT_MASK can ask for */
+#define KALERT_STATUS_ALL                                           \
+	(KALERT_MASK(KALERT_ENABLE) | KALERT_MASK(KALERT_PORTID) |    \
+	 KALERT_MASK(KALERT_FILTER_LEVEL) |                           \
+	 KALERT_MASK(KALERT_BACKLOG_LIMIT) |                          \
+	 KALERT_MASK(KALERT_BACKLOG_DEPTH) |                          \
+	 KALERT_MASK(KALERT_PACKLOSS_COUNT))
+
 typedef enum { GET_REPLY_BLOCKING = 0, GET_REPLY_NONBLOCKING } reply_t;
 
+/*
+ * Opaque kalert channel handle. It owns the socket, the sequence counter,
+ * preallocated request/reply buffers and the parked notification queue,
+ * so threads driving their own handles never share state or allocate per
+ * call. One handle must not be used by two threads at once.
+ */
+struct kalert_handle;
+
+/*
+ * Notification callback of kalert_dispatch(). @notify points into the
+ * receive buffer and is only valid during the call.
+ */
+typedef void (*kalert_notify_cb_t)(const struct kalert_notify_msg *notify,
+				   void *data);
+
+/* Status callback of kalert_dispatch(), see kalert_handle_request_status() */
+typedef void (*kalert_status_cb_t)(const struct kalert_status *st, void *data);
+
+/* Filtered consumers per handle, one bit each in a 64-bit word */
+#define KALERT_CONSUMER_MAX 64
+
 /* Base interface */
 int kalert_open(void);
 void kalert_close(int fd);
 int kalert_send_request(int fd, struct kalert_message *req);
 int kalert_get_reply(int fd, struct kalert_message *rep, reply_t block,
 		     int peek);
+int kalert_get_reply_batch(int fd, struct kalert_reply_slot *slots,
+			   unsigned int nslots, reply_t block);
+int kalert_get_queue_stats(int fd, struct kalert_queue_stats *stats);
+int kalert_get_loss_stats(int fd, struct kalert_loss_stats *stats,
+			  bool query_kernel);
+int kalert_set_rcvbuf(int fd, int bytes);
+int kalert_get_status(int fd, uint64_t mask, struct kalert_status *st);
+int kalert_request_status(int fd, uint64_t mask);
+int kalert_parse_status(const struct nlmsghdr *nlh, struct kalert_status *st);
+
+/* Request builders, return the encoded length or a negative error code */
+int kalert_build_set_chnl(void *buf, size_t size, uint32_t attr_mask,
+			  const uint64_t *attr);
+int kalert_build_subscribe_type(void *buf, size_t size, uint64_t type_mask,
+				uint32_t level);
+int kalert_build_subscribe_event(void *buf, size_t size, const int *event_ids,
+				 size_t count, uint32_t level);
+int kalert_build_status(void *buf, size_t size, uint64_t mask);
+
+/* Handle based interface, safe for one handle per thread */
+struct kalert_handle *kalert_handle_open(void);
+void kalert_handle_close(struct kalert_handle *h);
+int kalert_handle_fd(const struct kalert_handle *h);
+uint32_t kalert_handle_portid(const struct kalert_handle *h);
+int kalert_handle_send_request(struct kalert_handle *h,
+			       struct kalert_message *req);
+int kalert_handle_get_reply(struct kalert_handle *h, struct kalert_message *rep,
+			    reply_t block, int peek);
+int kalert_handle_get_reply_batch(struct kalert_handle *h,
+				  struct kalert_reply_slot *slots,
+				  unsigned int nslots, reply_t block);
+int kalert_handle_get_queue_stats(struct kalert_handle *h,
+				  struct kalert_queue_stats *stats);
+int kalert_handle_get_loss_stats(struct kalert_handle *h,
+				 struct kalert_loss_stats *stats,
+				 bool query_kernel);
+int kalert_handle_set_rcvbuf(struct kalert_handle *h, int bytes);
+int kalert_handle_get_status(struct kalert_handle *h, uint64_t mask,
+			     struct kalert_status *st);
+int kalert_handle_request_status(struct kalert_handle *h, uint64_t mask);
+struct kalert_handle *kalert_handle_start_channel(void);
+int kalert_handle_setup_channel(struct kalert_handle *h);
+int kalert_handle_set_filter_level(struct kalert_handle *h,
+				   uint32_t filter_level);
+int kalert_handle_set_enable(struct kalert_handle *h, uint32_t enable);
+int kalert_handle_set_portid(struct kalert_handle *h, uint32_t portid);
+int __kalert_handle_subscribe_event(struct kalert_handle *h,
+				    const int *event_ids, size_t count,
+				    uint32_t level);
+int kalert_handle_subscribe_type(struct kalert_handle *h, uint64_t type_mask,
+				 uint32_t level);
+int kalert_dispatch_on_event(struct kalert_handle *h, int event,
+			     kalert_notify_cb_t cb, void *data);
+int kalert_dispatch_on_type(struct kalert_handle *h, uint32_t type,
+			    kalert_notify_cb_t cb, void *data);
+int kalert_dispatch_on_level(struct kalert_handle *h, uint32_t level,
+			     kalert_notify_cb_t cb, void *data);
+int kalert_dispatch_on_status(struct kalert_handle *h, kalert_status_cb_t cb,
+			      void *data);
+int kalert_dispatch(struct kalert_handle *h, int max_events);
+uint64_t kalert_dispatch_ts(struct kalert_handle *h);
+int kalert_consumer_add(struct kalert_handle *h, const int *event_ids,
+			size_t count, uint32_t min_level,
+			kalert_notify_cb_t cb, void *data);
+int kalert_consumer_set_events(struct kalert_handle *h, int id,
+			       const int *event_ids, size_t count);
+int kalert_consumer_set_level(struct kalert_handle *h, int id,
+			      uint32_t min_level);
+int kalert_consumer_remove(struct kalert_handle *h, int id);
+uint64_t kalert_consumer_match(const struct kalert_handle *h,
+			       const struct kalert_notify_msg *notify);
+int kalert_handle_batch_commit(struct kalert_handle *h,
+			       struct kalert_batch *batch);
+
+/*
+ * In-process fake kalert kernel, reached over a socketpair instead of
+ * NETLINK_KALERT. It speaks the SET_CHNL/SUBSCRIBE/GET_STATUS protocol,
+ * ACKs included, filters like the kernel and generates notifications at
+ * a configurable rate, for tests and benchmarks on any Linux box.
+ */
+struct kalert_fake_event {
+	uint32_t type;
+	uint32_t event;
+	uint32_t level;
+};
+
+struct kalert_fake_config {
+	uint32_t rate; /* notifications generated per second, 0 = none */
+	uint64_t count; /* stop after this many notifications, 0 = no limit */
+	const struct kalert_fake_event *events; /* cycled; NULL = built-in */
+	size_t nevents;
+	bool stamp; /* CLOCK_MONOTONIC send time as 8 bytes of data */
+};
+
+struct kalert_fake_stats {
+	uint64_t generated; /* notifications produced by the generator */
+	uint64_t filtered; /* dropped by channel level or subscription */
+	uint64_t delivered; /* queued to the user socket */
+	uint64_t lost; /* socket full, counted as kernel packet loss */
+	uint64_t requests; /* requests handled */
+};
+
+struct kalert_handle *
+kalert_handle_open_fake(const struct kalert_fake_config *cfg);
+int kalert_fake_set_rate(struct kalert_handle *h, uint32_t rate);
+int kalert_fake_get_stats(struct kalert_handle *h,
+			  struct kalert_fake_stats *stats);
+
+/*
+ * Reader of kalertd's shared memory broker, see libkalert/broker.h. Many
+ * local processes share the one kernel channel kalertd holds.
+ */
+struct kalert_handle *kalert_handle_open_broker(const char *path);
 
 /* Advance wrap interface */
 int kalert_start_channel(void);
@@ -145,4 +385,18 @@ int __kalert_subscribe_event(int fd, const int *event_ids, size_t count,
 			     uint32_t level);
 int kalert_subscribe_type(int fd, uint64_t type_mask, uint32_t level);
 
+/* Pipelined configuration: many requests, one send, one ACK wait */
+void kalert_batch_init(struct kalert_batch *batch);
+int kalert_batch_add_parameter(struct kalert_batch *batch, uint32_t attr_mask,
+			       const uint64_t *attr);
+int kalert_batch_add_subscribe_type(struct kalert_batch *batch,
+				    uint64_t type_mask, uint32_t level);
+int kalert_batch_add_subscribe_event(struct kalert_batch *batch,
+				     const int *event_ids, size_t count,
+				     uint32_t level);
+int kalert_batch_commit(int fd, struct kalert_batch *batch);
+
+/* Create the directory of a socket or file, e.g. /run/kalertd */
+int kalert_mkdir_parent(const char *path, unsigned int mode);
+
 #endif /* LIBKALERT_H */
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd statistics page, a memory mapped file read
+ * without any IPC
+ *
+ * kalertd rewrites a fixed layout struct kalert_daemon_stats in a small
+ * file under /run/kalertd at a steady pace. The copy is guarded by a
+ * seqlock: the writer makes header.seq odd, stores the words, then makes
+ * it even again; a reader copies the words and retries if seq was odd or
+ * moved meanwhile. Readers never write to the page, so any number of
+ * them cost the daemon nothing.
+ *
+ * The page is created beside its path and renamed into place, so a
+ * reader never maps a half initialized header. A writer that exits
+ * cleanly marks the page closed and removes it; after a crash the page
+ * stays with an updated_ns that stops moving.
+ */
+
+#ifndef LIBKALERT_STATPAGE_H
+#define LIBKALERT_STATPAGE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/kalert.h>
+
+#define KALERT_STATPAGE_MAGIC "KALSTAT"
+#define KALERT_STATPAGE_VERSION 1
+#define KALERT_STATPAGE_PATH "/run/kalertd/stats"
+
+/**
+ * struct kalert_daemon_stats - what kalertd publishes
+ *
+ * Every field is a 64-bit word. New fields are only ever appended; a
+ * reader gets 0 for the fields an older writer does not have. Times
+ * ending in _ns are CLOCK_MONOTONIC, comparable across processes, and 0
+ * when the event never happened.
+ *
+ * @pid:               kalertd's pid
+ * @started_ns:        CLOCK_REALTIME when kalertd started
+ * @updated_ns:        when this snapshot was taken
+ * @last_notify_ns:    last notification received
+ * @last_heartbeat_ns: last kernel heartbeat received
+ * @heartbeats:        kernel heartbeats received
+ * @heartbeat_stalls:  heartbeat stalls detected
+ * @status_ns:         when the channel status below was received
+ * @enable:            channel status: KALERT_ENABLE
+ * @portid:            channel status: KALERT_PORTID
+ * @filter_level:      channel status: KALERT_FILTER_LEVEL
+ * @backlog_limit:     channel status: KALERT_BACKLOG_LIMIT
+ * @backlog_depth:     channel status: KALERT_BACKLOG_DEPTH
+ * @packloss_count:    channel status: KALERT_PACKLOSS_COUNT
+ * @received:          notifications received
+ * @rate_limited:      dropped by the rate limits
+ * @coalesced:         folded into storm summaries of the text log
+ * @logged:            lines queued to the text log
+ * @log_lost:          lines the text log dropped or failed to write
+ * @socket_overruns:   receive buffer overflows of the kalert socket
+ * @by_type:           notifications received per type
+ * @by_level:          notifications received per level
+ * @by_event:          notifications received per event id - base
+ */
+struct kalert_daemon_stats {
+	uint64_t pid;
+	uint64_t started_ns;
+	uint64_t updated_ns;
+	uint64_t last_notify_ns;
+	uint64_t last_heartbeat_ns;
+	uint64_t heartbeats;
+	uint64_t heartbeat_stalls;
+	uint64_t status_ns;
+	uint64_t enable;
+	uint64_t portid;
+	uint64_t filter_level;
+	uint64_t backlog_limit;
+	uint64_t backlog_depth;
+	uint64_t packloss_count;
+	uint64_t received;
+	uint64_t rate_limited;
+	uint64_t coalesced;
+	uint64_t logged;
+	uint64_t log_lost;
+	uint64_t socket_overruns;
+	uint64_t by_type[KALERT_NOTIFY_MAX];
+	uint64_t by_level[KALERT_LEVEL_MAX];
+	uint64_t by_event[KALERT_EVENT_MAX];
+};
+
+/**
+ * struct kalert_statpage_header - first bytes of the page
+ * @magic:      KALERT_STATPAGE_MAGIC, NUL terminated
+ * @version:    KALERT_STATPAGE_VERSION
+ * @hdr_size:   offset of the stats
+ * @stats_size: sizeof(struct kalert_daemon_stats) of the writer
+ * @closed:     set when the writer went away cleanly
+ * @seq:        seqlock sequence, odd while the stats are being written
+ */
+struct kalert_statpage_header {
+	char magic[8];
+	uint16_t version;
+	uint16_t hdr_size;
+	uint32_t stats_size;
+	uint32_t closed;
+	uint32_t seq __attribute__((aligned(64)));
+};
+
+/* ----------------------------- Writer ------------------------------ */
+
+struct kalert_statpage;
+
+struct kalert_statpage *kalert_statpage_create(const char *path);
+void kalert_statpage_update(struct kalert_statpage *sp,
+			    const struct kalert_daemon_stats *st);
+void kalert_statpage_remove(struct kalert_statpage *sp);
+
+/* ----------------------------- Reader ------------------------------ */
+
+/**
+ * struct kalert_statpage_view - read only mapping of a page
+ * @hdr:     page header
+ * @stats:   first word of the stats
+ * @nwords:  words of the stats both sides know
+ * @map_len: length of the mapping
+ */
+struct kalert_statpage_view {
+	const struct kalert_statpage_header *hdr;
+	const uint64_t *stats;
+	size_t nwords;
+	size_t map_len;
+};
+
+int kalert_statpage_open(const char *path, struct kalert_statpage_view *v);
+int kalert_statpage_read(const struct kalert_statpage_view *v,
+			 struct kalert_daemon_stats *st);
+void kalert_statpage_close(struct kalert_statpage_view *v);
+
+#endif /* LIBKALERT_STATPAGE_H */
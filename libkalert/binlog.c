@@ -0,0 +1,524 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Binary event log writer and reader
+ *
+ * Appending a record is a 32 byte copy into a shared file mapping; the
+ * kernel writes the pages back on its own schedule, or on
+ * kalert_binlog_sync(). Segment files are allocated in full when created
+ * so the mapping never needs to grow.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkalert/binlog.h>
+
+#include "private.h"
+
+#define BINLOG_HDR_SIZE 64
+
+_Static_assert(sizeof(struct kalert_binlog_header) <= BINLOG_HDR_SIZE,
+	       "binlog header outgrew its slot");
+_Static_assert(sizeof(struct kalert_binlog_record) == 32,
+	       "binlog record layout changed");
+
+struct kalert_binlog {
+	char *dir;
+	size_t seg_size;
+	uint64_t next_seq;
+
+	/* retention, 0 means unlimited */
+	uint64_t max_age_ns;
+	unsigned int keep;
+
+	/* current segment, hdr is NULL until the first append */
+	int fd;
+	struct kalert_binlog_header *hdr;
+	struct kalert_binlog_record *rec;
+	size_t map_len;
+};
+
+static int segment_filter(const struct dirent *d)
+{
+	size_t len = strlen(d->d_name);
+	size_t plen = strlen(KALERT_BINLOG_PREFIX);
+	size_t slen = strlen(KALERT_BINLOG_SUFFIX);
+
+	return len > plen + slen &&
+	       !strncmp(d->d_name, KALERT_BINLOG_PREFIX, plen) &&
+	       !strcmp(d->d_name + len - slen, KALERT_BINLOG_SUFFIX);
+}
+
+/* Segment names sort in log order, the first seq is zero padded */
+static int list_segments(const char *dir, struct dirent ***list)
+{
+	return scandir(dir, list, segment_filter, alphasort);
+}
+
+static void free_list(struct dirent **list, int n)
+{
+	while (n-- > 0)
+		free(list[n]);
+	free(list);
+}
+
+static int header_valid(const struct kalert_binlog_header *hdr, size_t len)
+{
+	if (len < BINLOG_HDR_SIZE ||
+	    memcmp(hdr->magic, KALERT_BINLOG_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != KALERT_BINLOG_VERSION ||
+	    hdr->record_size != sizeof(struct kalert_binlog_record) ||
+	    hdr->hdr_size != BINLOG_HDR_SIZE)
+		return -EINVAL;
+
+	if (hdr->capacity > (len - BINLOG_HDR_SIZE) / hdr->record_size)
+		return -EINVAL;
+	return 0;
+}
+
+static int map_segment(const char *path, int flags,
+		       struct kalert_binlog_header **hdr, size_t *len)
+{
+	struct stat st;
+	void *map;
+	int fd, prot = PROT_READ;
+
+	fd = open(path, flags | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	if (flags & O_RDWR)
+		prot |= PROT_WRITE;
+	map = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return -errno;
+	}
+
+	if (header_valid(map, st.st_size)) {
+		munmap(map, st.st_size);
+		close(fd);
+		return -EINVAL;
+	}
+
+	*hdr = map;
+	*len = st.st_size;
+	return fd;
+}
+
+static void unmap_current(struct kalert_binlog *log, bool seal)
+{
+	if (!log->hdr)
+		return;
+
+	if (seal)
+		__atomic_store_n(&log->hdr->sealed, 1, __ATOMIC_RELEASE);
+	munmap(log->hdr, log->map_len);
+	close(log->fd);
+	log->hdr = NULL;
+	log->rec = NULL;
+	log->fd = -1;
+}
+
+static int new_segment(struct kalert_binlog *log)
+{
+	char path[PATH_MAX];
+	struct kalert_binlog_header *hdr;
+	struct timespec ts;
+	int fd, rc;
+
+	snprintf(path, sizeof(path), "%s/" KALERT_BINLOG_PREFIX "%020llu"
+		 KALERT_BINLOG_SUFFIX, log->dir,
+		 (unsigned long long)log->next_seq);
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	/* reserve the blocks now, a full disk fails here and not on a store */
+	rc = posix_fallocate(fd, 0, log->seg_size);
+	if (rc == EOPNOTSUPP || rc == EINVAL)
+		rc = ftruncate(fd, log->seg_size) < 0 ? errno : 0;
+	if (rc)
+		goto err;
+
+	hdr = mmap(NULL, log->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (hdr == MAP_FAILED) {
+		rc = errno;
+		goto err;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memcpy(hdr->magic, KALERT_BINLOG_MAGIC, sizeof(hdr->magic));
+	hdr->version = KALERT_BINLOG_VERSION;
+	hdr->record_size = sizeof(struct kalert_binlog_record);
+	hdr->hdr_size = BINLOG_HDR_SIZE;
+	hdr->capacity = (log->seg_size - BINLOG_HDR_SIZE) / hdr->record_size;
+	hdr->first_seq = log->next_seq;
+	hdr->created_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	hdr->count = 0;
+
+	log->fd = fd;
+	log->hdr = hdr;
+	log->rec = (void *)((char *)hdr + BINLOG_HDR_SIZE);
+	log->map_len = log->seg_size;
+	return 0;
+
+err:
+	close(fd);
+	unlink(path);
+	return -rc;
+}
+
+/* Delete the oldest segments until at most keep old ones are left */
+static void prune_segments(struct kalert_binlog *log)
+{
+	char path[PATH_MAX];
+	struct dirent **list;
+	int i, n;
+
+	if (!log->keep)
+		return;
+
+	n = list_segments(log->dir, &list);
+	for (i = 0; i < n - (int)log->keep - 1; i++) {
+		snprintf(path, sizeof(path), "%s/%s", log->dir,
+			 list[i]->d_name);
+		unlink(path);
+	}
+	if (n >= 0)
+		free_list(list, n);
+}
+
+/*
+ * Seq past anything a segment that cannot be mapped may hold: its first
+ * seq is in its name, and its size bounds its records.
+ */
+static uint64_t bad_segment_end(const char *path, const char *name)
+{
+	unsigned long long first;
+	struct stat st;
+	uint64_t cap = 0;
+
+	if (sscanf(name + strlen(KALERT_BINLOG_PREFIX), "%llu", &first) != 1)
+		first = 0;
+	if (stat(path, &st) == 0 && st.st_size > BINLOG_HDR_SIZE)
+		cap = (st.st_size - BINLOG_HDR_SIZE) /
+		      sizeof(struct kalert_binlog_record);
+
+	return first + (cap ?: 1);
+}
+
+/* Continue the last segment of the directory, if it has room left */
+static void resume_last(struct kalert_binlog *log)
+{
+	struct kalert_binlog_header *hdr;
+	struct dirent **list;
+	char path[PATH_MAX];
+	size_t len;
+	int n, fd;
+
+	n = list_segments(log->dir, &list);
+	if (n <= 0)
+		return;
+
+	snprintf(path, sizeof(path), "%s/%s", log->dir, list[n - 1]->d_name);
+	fd = map_segment(path, O_RDWR, &hdr, &len);
+	if (fd < 0) {
+		/* the next segment must not collide or sort before it */
+		log->next_seq = bad_segment_end(path, list[n - 1]->d_name);
+		free_list(list, n);
+		kalert_msg(LOG_WARNING, "Ignoring bad binary log segment %s",
+			   path);
+		return;
+	}
+	free_list(list, n);
+
+	if (hdr->count > hdr->capacity)
+		hdr->count = hdr->capacity;
+	log->next_seq = hdr->first_seq + hdr->count;
+
+	if (hdr->sealed || hdr->count == hdr->capacity) {
+		munmap(hdr, len);
+		close(fd);
+		return;
+	}
+
+	log->fd = fd;
+	log->hdr = hdr;
+	log->rec = (void *)((char *)hdr + BINLOG_HDR_SIZE);
+	log->map_len = len;
+}
+
+/**
+ * kalert_binlog_open - open a binary log for appending
+ * @dir:      log directory, created if missing
+ * @seg_size: segment file size in bytes, 0 for KALERT_BINLOG_SEGMENT_SIZE
+ *
+ * Appends continue the newest segment of @dir and its seq numbering.
+ * Only one writer may have a directory open at a time.
+ *
+ * Return: log handle, or NULL with errno set.
+ */
+struct kalert_binlog *kalert_binlog_open(const char *dir, size_t seg_size)
+{
+	struct kalert_binlog *log;
+
+	if (!dir) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (!seg_size)
+		seg_size = KALERT_BINLOG_SEGMENT_SIZE;
+	if (seg_size < BINLOG_HDR_SIZE + sizeof(struct kalert_binlog_record)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return NULL;
+
+	log = calloc(1, sizeof(*log));
+	if (!log)
+		return NULL;
+
+	log->dir = strdup(dir);
+	if (!log->dir) {
+		free(log);
+		return NULL;
+	}
+	log->seg_size = seg_size;
+	log->fd = -1;
+
+	resume_last(log);
+	return log;
+}
+
+/* Whether the next record must go to a new segment */
+static bool segment_done(const struct kalert_binlog *log, uint64_t ts_ns)
+{
+	const struct kalert_binlog_header *hdr = log->hdr;
+
+	if (!hdr || hdr->count == hdr->capacity)
+		return true;
+	/*
+	 * A record received just before the segment was opened, or a wall
+	 * clock step backwards, is older than the segment: it still fits.
+	 */
+	return log->max_age_ns && ts_ns > hdr->created_ns &&
+	       ts_ns - hdr->created_ns >= log->max_age_ns;
+}
+
+/**
+ * kalert_binlog_append - add a notification to the log
+ * @log:    binary log
+ * @ts_ns:  CLOCK_REALTIME receive time
+ * @notify: notification
+ *
+ * Return: 0 on success, negative error code if a new segment could not be
+ * created; the record is lost in that case.
+ */
+int kalert_binlog_append(struct kalert_binlog *log, uint64_t ts_ns,
+			 const struct kalert_notify_msg *notify)
+{
+	struct kalert_binlog_record *r;
+	uint64_t count;
+	int rc;
+
+	if (!log || !notify)
+		return -EINVAL;
+
+	if (segment_done(log, ts_ns)) {
+		unmap_current(log, true);
+		rc = new_segment(log);
+		if (rc < 0)
+			return rc;
+		prune_segments(log);
+	}
+
+	count = log->hdr->count;
+	r = &log->rec[count];
+	r->ts_ns = ts_ns;
+	r->seq = log->next_seq++;
+	r->type = notify->type;
+	r->event = notify->event;
+	r->level = notify->level;
+	r->flags = 0;
+
+	/* publish, readers only look at records below count */
+	__atomic_store_n(&log->hdr->count, count + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * kalert_binlog_set_limits - bound the size of a binary log
+ * @log:     binary log
+ * @max_age: start a new segment once the current one is this many seconds
+ *           old, 0 for no limit
+ * @keep:    old segments kept besides the current one, 0 keeps all
+ *
+ * Together with the segment size this caps the disk space of the log at
+ * (@keep + 1) segments. Old segments are deleted when a new one starts.
+ */
+void kalert_binlog_set_limits(struct kalert_binlog *log, unsigned int max_age,
+			      unsigned int keep)
+{
+	if (!log)
+		return;
+
+	log->max_age_ns = (uint64_t)max_age * 1000000000;
+	log->keep = keep;
+}
+
+/* Write the current segment back to disk and wait for it */
+int kalert_binlog_sync(struct kalert_binlog *log)
+{
+	if (!log)
+		return -EINVAL;
+	if (!log->hdr)
+		return 0;
+
+	return msync(log->hdr, log->map_len, MS_SYNC) < 0 ? -errno : 0;
+}
+
+/*
+ * Close the log. The current segment stays unsealed so the next
+ * kalert_binlog_open() of the directory continues it.
+ */
+void kalert_binlog_close(struct kalert_binlog *log)
+{
+	if (!log)
+		return;
+
+	unmap_current(log, false);
+	free(log->dir);
+	free(log);
+}
+
+/**
+ * kalert_binlog_segment_open - map a segment for reading
+ * @path: segment file
+ * @seg:  output
+ *
+ * seg->count is sampled once; a segment still being written can be
+ * reopened to see newer records.
+ *
+ * Return: 0 on success, negative error code otherwise, -EINVAL if @path
+ * is not a segment of a supported version.
+ */
+int kalert_binlog_segment_open(const char *path,
+			       struct kalert_binlog_segment *seg)
+{
+	struct kalert_binlog_header *hdr;
+	size_t len;
+	uint64_t count;
+	int fd;
+
+	if (!path || !seg)
+		return -EINVAL;
+
+	fd = map_segment(path, O_RDONLY, &hdr, &len);
+	if (fd < 0)
+		return fd;
+	close(fd);
+
+	count = __atomic_load_n(&hdr->count, __ATOMIC_ACQUIRE);
+	if (count > hdr->capacity)
+		count = hdr->capacity;
+	madvise(hdr, len, MADV_SEQUENTIAL);
+
+	seg->hdr = hdr;
+	seg->rec = (const void *)((const char *)hdr + hdr->hdr_size);
+	seg->count = count;
+	seg->map_len = len;
+	return 0;
+}
+
+void kalert_binlog_segment_close(struct kalert_binlog_segment *seg)
+{
+	if (!seg || !seg->hdr)
+		return;
+
+	munmap((void *)seg->hdr, seg->map_len);
+	memset(seg, 0, sizeof(*seg));
+}
+
+static int scan_segment(const char *path, kalert_binlog_cb_t cb, void *data)
+{
+	struct kalert_binlog_segment seg;
+	uint64_t i;
+	int rc;
+
+	rc = kalert_binlog_segment_open(path, &seg);
+	if (rc < 0)
+		return rc;
+
+	for (i = 0, rc = 0; i < seg.count && !rc; i++)
+		rc = cb(&seg.rec[i], data);
+
+	kalert_binlog_segment_close(&seg);
+	return rc;
+}
+
+/**
+ * kalert_binlog_scan - call @cb for every record of a log
+ * @path: segment file, or log directory to walk in order
+ * @cb:   record callback
+ * @data: passed to @cb
+ *
+ * Segments of a directory that fail to map are skipped with a warning.
+ *
+ * Return: 0 once every record was seen, the non zero value returned by
+ * @cb, or a negative error code.
+ */
+int kalert_binlog_scan(const char *path, kalert_binlog_cb_t cb, void *data)
+{
+	char seg_path[PATH_MAX];
+	struct dirent **list;
+	struct stat st;
+	int i, n, rc = 0;
+
+	if (!path || !cb)
+		return -EINVAL;
+
+	if (stat(path, &st) < 0)
+		return -errno;
+	if (!S_ISDIR(st.st_mode))
+		return scan_segment(path, cb, data);
+
+	n = list_segments(path, &list);
+	if (n < 0)
+		return -errno;
+
+	for (i = 0; i < n; i++) {
+		snprintf(seg_path, sizeof(seg_path), "%s/%s", path,
+			 list[i]->d_name);
+		rc = scan_segment(seg_path, cb, data);
+		if (rc < 0) {
+			kalert_msg(LOG_WARNING,
+				   "Skipping binary log segment %s (%s)",
+				   seg_path, strerror(-rc));
+			rc = 0;
+		} else if (rc) {
+			break;
+		}
+	}
+
+	free_list(list, n);
+	return rc;
+}
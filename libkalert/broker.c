@@ -0,0 +1,1021 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Shared memory fan-out broker and its reader transport
+ *
+ * See libkalert/broker.h for the layout and the protocol. The broker side
+ * is driven from the owner's event loop through kalert_broker_fd(); the
+ * reader side is a transport, so a broker handle takes the same dispatch
+ * callbacks as a kernel one.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <libkalert/broker.h>
+
+#include "private.h"
+
+/* epoll tag of the listening socket, readers use their slot index */
+#define BROKER_LISTEN KALERT_BROKER_READERS
+
+/* Events taken by one epoll_wait() of kalert_broker_process() */
+#define BROKER_EVENTS 16
+
+/* Replies a reader handle queues for requests it answers itself */
+#define BROKER_ACK_MAX 32
+
+/* How long a reader waits for the broker's welcome */
+#define BROKER_WELCOME_TIMEOUT 3
+
+/* Descriptors passed with the welcome: the ring, then the reader's slot */
+#define BROKER_FDS 2
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+/* Seals of the ring, F_SEAL_FUTURE_WRITE is added where the kernel has it */
+#define BROKER_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+struct kalert_broker {
+	struct kalert_broker_header *hdr;
+	struct kalert_broker_reader *reader[KALERT_BROKER_READERS];
+	struct kalert_broker_record *rec;
+	size_t size;
+	uint64_t mask; /* capacity - 1 */
+	uint64_t head; /* private copy of hdr->head */
+	uint64_t woken; /* head at the last kalert_broker_wake() */
+	uint64_t active; /* slots with a reader */
+	uint64_t pending; /* slots connected, hello not seen yet */
+	int memfd;
+	int lfd;
+	int epfd;
+	int conn[KALERT_BROKER_READERS];
+	int efd[KALERT_BROKER_READERS];
+	struct kalert_broker_stats stats;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+static size_t broker_hdr_size(void)
+{
+	return (sizeof(struct kalert_broker_header) + 127) & ~(size_t)127;
+}
+
+/* Pass the @nfds descriptors of @fds along with @buf over a Unix socket */
+static int send_fds(int sock, const void *buf, size_t len, const int *fds,
+		    unsigned int nfds)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(BROKER_FDS * sizeof(int))];
+	} cmsg;
+	struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+	struct cmsghdr *c;
+
+	if (nfds) {
+		memset(&cmsg, 0, sizeof(cmsg));
+		msg.msg_control = cmsg.buf;
+		msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		c = CMSG_FIRSTHDR(&msg);
+		c->cmsg_level = SOL_SOCKET;
+		c->cmsg_type = SCM_RIGHTS;
+		c->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy(CMSG_DATA(c), fds, nfds * sizeof(int));
+	}
+
+	return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)len ? 0 : -errno;
+}
+
+static int send_fd(int sock, const void *buf, size_t len, int fd)
+{
+	return send_fds(sock, buf, len, &fd, fd >= 0);
+}
+
+/*
+ * Receive into @buf, and up to BROKER_FDS passed descriptors into @fds.
+ * Missing ones are set to -1.
+ */
+static ssize_t recv_fds(int sock, void *buf, size_t len, int *fds)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(BROKER_FDS * sizeof(int))];
+	} cmsg;
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cmsg.buf,
+		.msg_controllen = sizeof(cmsg.buf),
+	};
+	struct cmsghdr *c;
+	unsigned int i, n;
+	ssize_t rc;
+
+	for (i = 0; i < BROKER_FDS; i++)
+		fds[i] = -1;
+	do {
+		rc = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0)
+		return -errno;
+
+	for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+		if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+			continue;
+		n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		if (n > BROKER_FDS)
+			n = BROKER_FDS;
+		memcpy(fds, CMSG_DATA(c), n * sizeof(int));
+	}
+
+	return rc;
+}
+
+static ssize_t recv_fd(int sock, void *buf, size_t len, int *fd)
+{
+	int fds[BROKER_FDS];
+	ssize_t rc;
+	unsigned int i;
+
+	rc = recv_fds(sock, buf, len, fds);
+	*fd = fds[0];
+	for (i = 1; i < BROKER_FDS; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	return rc;
+}
+
+/* ---------------------------- Broker ------------------------------ */
+
+static void broker_release(struct kalert_broker *b, unsigned int i)
+{
+	struct kalert_broker_reader *rd = b->reader[i];
+	uint64_t bit = 1ULL << i;
+
+	if (b->active & bit)
+		kalert_msg(LOG_INFO, "kalert broker reader %u (pid %u) left",
+			   i, rd->pid);
+
+	epoll_ctl(b->epfd, EPOLL_CTL_DEL, b->conn[i], NULL);
+	close(b->conn[i]);
+	if (b->efd[i] >= 0)
+		close(b->efd[i]);
+	b->conn[i] = -1;
+	b->efd[i] = -1;
+
+	if (rd)
+		munmap(rd, sizeof(*rd));
+	b->reader[i] = NULL;
+	b->active &= ~bit;
+	b->pending &= ~bit;
+}
+
+/*
+ * Map a fresh slot for reader @i. It lives in a memfd of its own, so the
+ * reader cannot touch anybody else's. Returns the memfd to pass.
+ */
+static int broker_slot_new(struct kalert_broker *b, unsigned int i)
+{
+	struct kalert_broker_reader *rd;
+	int fd, err;
+
+	fd = memfd_create("kalert-broker-slot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return -errno;
+
+	if (ftruncate(fd, sizeof(*rd)) < 0 ||
+	    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+		goto err;
+
+	rd = mmap(NULL, sizeof(*rd), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (rd == MAP_FAILED)
+		goto err;
+
+	b->reader[i] = rd;
+	return fd;
+
+err:
+	err = errno;
+	close(fd);
+	return -err;
+}
+
+static void broker_accept(struct kalert_broker *b, int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct kalert_broker_welcome w = { .status = -EBUSY };
+	uint64_t used = b->active | b->pending;
+	unsigned int i;
+
+	if (!~used) {
+		b->stats.rejects++;
+		send_fd(fd, &w, sizeof(w), -1);
+		close(fd);
+		return;
+	}
+
+	i = __builtin_ctzll(~used);
+	ev.data.u64 = i;
+	if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		close(fd);
+		return;
+	}
+
+	b->conn[i] = fd;
+	b->efd[i] = -1;
+	b->pending |= 1ULL << i;
+}
+
+/* First message of a reader: its eventfd, answered with the memfds */
+static void broker_hello(struct kalert_broker *b, unsigned int i)
+{
+	struct kalert_broker_welcome w = { .slot = i, .size = b->size };
+	struct kalert_broker_hello hello;
+	struct kalert_broker_reader *rd;
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fds[BROKER_FDS];
+	ssize_t rc;
+	int efd;
+
+	rc = recv_fd(b->conn[i], &hello, sizeof(hello), &efd);
+	if (rc == -EAGAIN)
+		return;
+
+	if (rc != (ssize_t)sizeof(hello) ||
+	    hello.version != KALERT_BROKER_VERSION || efd < 0) {
+		if (rc > 0) {
+			b->stats.rejects++;
+			w.status = -EPROTO;
+			send_fd(b->conn[i], &w, sizeof(w), -1);
+		}
+		if (efd >= 0)
+			close(efd);
+		broker_release(b, i);
+		return;
+	}
+
+	/* a reader must not be able to stall the broker with a full pipe */
+	fcntl(efd, F_SETFL, fcntl(efd, F_GETFL) | O_NONBLOCK);
+	b->efd[i] = efd;
+
+	if (getsockopt(b->conn[i], SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		cred.pid = 0;
+
+	fds[0] = b->memfd;
+	fds[1] = broker_slot_new(b, i);
+	if (fds[1] < 0) {
+		kalert_msg(LOG_WARNING, "kalert broker reader slot (%s)",
+			   strerror(-fds[1]));
+		w.status = fds[1];
+		send_fd(b->conn[i], &w, sizeof(w), -1);
+		broker_release(b, i);
+		return;
+	}
+
+	/* a new reader polls its fd before it ever looked at the ring */
+	rd = b->reader[i];
+	rd->armed = 1;
+	rd->pid = cred.pid;
+	rd->cursor = b->head;
+	rd->active = 1;
+
+	rc = send_fds(b->conn[i], &w, sizeof(w), fds, BROKER_FDS);
+	close(fds[1]);
+	if (rc < 0) {
+		broker_release(b, i);
+		return;
+	}
+
+	b->pending &= ~(1ULL << i);
+	b->active |= 1ULL << i;
+	b->stats.connects++;
+	kalert_msg(LOG_INFO, "kalert broker reader %u (pid %u) joined", i,
+		   rd->pid);
+}
+
+/* A reader sends nothing after its hello, anything else is a hang up */
+static void broker_conn_event(struct kalert_broker *b, unsigned int i)
+{
+	char buf[64];
+	ssize_t rc;
+
+	if (b->pending & (1ULL << i)) {
+		broker_hello(b, i);
+		return;
+	}
+
+	do {
+		rc = recv(b->conn[i], buf, sizeof(buf), MSG_DONTWAIT);
+	} while (rc > 0 || (rc < 0 && errno == EINTR));
+
+	if (rc == 0 || errno != EAGAIN)
+		broker_release(b, i);
+}
+
+static int broker_listen(struct kalert_broker *b, const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int rc;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+	kalert_mkdir_parent(path, 0755);
+
+	b->lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			0);
+	if (b->lfd < 0)
+		return -errno;
+
+	unlink(path);
+	if (bind(b->lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    chmod(path, 0660) < 0 || listen(b->lfd, 16) < 0) {
+		rc = -errno;
+		unlink(path);
+		return rc;
+	}
+
+	strcpy(b->path, path);
+	return 0;
+}
+
+static int broker_map(struct kalert_broker *b, uint64_t capacity)
+{
+	struct kalert_broker_header *hdr;
+	size_t hdr_size = broker_hdr_size();
+
+	b->size = hdr_size + capacity * sizeof(struct kalert_broker_record);
+
+	b->memfd = memfd_create("kalert-broker",
+				MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (b->memfd < 0)
+		return -errno;
+	if (ftruncate(b->memfd, b->size) < 0)
+		return -errno;
+
+	hdr = mmap(NULL, b->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   b->memfd, 0);
+	if (hdr == MAP_FAILED)
+		return -errno;
+
+	memcpy(hdr->magic, KALERT_BROKER_MAGIC, sizeof(hdr->magic));
+	hdr->version = KALERT_BROKER_VERSION;
+	hdr->record_size = sizeof(struct kalert_broker_record);
+	hdr->hdr_size = hdr_size;
+	hdr->capacity = capacity;
+	hdr->readers = KALERT_BROKER_READERS;
+
+	b->hdr = hdr;
+	b->rec = (struct kalert_broker_record *)((char *)hdr + hdr_size);
+	b->mask = capacity - 1;
+
+	/* from here on only our mapping can write the ring */
+	if (fcntl(b->memfd, F_ADD_SEALS,
+		  BROKER_SEALS | F_SEAL_FUTURE_WRITE) == 0)
+		return 0;
+	if (errno != EINVAL)
+		return -errno;
+
+	/* kernels before 5.1 cannot, readers still map it read only */
+	kalert_msg(LOG_WARNING, "kalert broker ring cannot be write sealed");
+	if (fcntl(b->memfd, F_ADD_SEALS, BROKER_SEALS) < 0)
+		return -errno;
+	return 0;
+}
+
+/**
+ * kalert_broker_open - create the shared ring and listen for readers
+ * @path:     socket path, replaced if it exists; NULL for
+ *            KALERT_BROKER_SOCKET
+ * @capacity: records in the ring, rounded up to a power of two; 0 for
+ *            KALERT_BROKER_CAPACITY
+ *
+ * Return: new broker, or NULL on error (errno is set).
+ */
+struct kalert_broker *kalert_broker_open(const char *path,
+					 unsigned int capacity)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct kalert_broker *b;
+	uint64_t cap = 1;
+	unsigned int i;
+	int rc;
+
+	if (!capacity)
+		capacity = KALERT_BROKER_CAPACITY;
+	while (cap < capacity)
+		cap <<= 1;
+	if (cap > UINT32_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->memfd = b->lfd = b->epfd = -1;
+	for (i = 0; i < KALERT_BROKER_READERS; i++)
+		b->conn[i] = b->efd[i] = -1;
+
+	rc = broker_map(b, cap);
+	if (rc < 0)
+		goto err;
+
+	rc = broker_listen(b, path ?: KALERT_BROKER_SOCKET);
+	if (rc < 0)
+		goto err;
+
+	b->epfd = epoll_create1(EPOLL_CLOEXEC);
+	ev.data.u64 = BROKER_LISTEN;
+	if (b->epfd < 0 || epoll_ctl(b->epfd, EPOLL_CTL_ADD, b->lfd, &ev) < 0) {
+		rc = -errno;
+		goto err;
+	}
+
+	return b;
+
+err:
+	kalert_broker_close(b);
+	errno = -rc;
+	return NULL;
+}
+
+/* Becomes readable when kalert_broker_process() has work to do */
+int kalert_broker_fd(const struct kalert_broker *b)
+{
+	return b ? b->epfd : -EBADF;
+}
+
+/**
+ * kalert_broker_process - accept readers and handle their hang ups
+ * @b: broker
+ *
+ * Never blocks. Call it whenever kalert_broker_fd() is readable.
+ *
+ * Return: number of events handled, or a negative error code.
+ */
+int kalert_broker_process(struct kalert_broker *b)
+{
+	struct epoll_event ev[BROKER_EVENTS];
+	int n, i, fd;
+
+	if (!b)
+		return -EBADF;
+
+	n = epoll_wait(b->epfd, ev, BROKER_EVENTS, 0);
+	if (n < 0)
+		return errno == EINTR ? 0 : -errno;
+
+	for (i = 0; i < n; i++) {
+		if (ev[i].data.u64 != BROKER_LISTEN) {
+			broker_conn_event(b, ev[i].data.u64);
+			continue;
+		}
+
+		while ((fd = accept4(b->lfd, NULL, NULL,
+				     SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+			broker_accept(b, fd);
+	}
+
+	return n;
+}
+
+/**
+ * kalert_broker_publish - append a notification to the ring
+ * @b:      broker
+ * @ts_ns:  CLOCK_REALTIME of receipt
+ * @notify: notification, its payload is clipped to what a record holds
+ *
+ * Readers see the record at once if they poll the ring; the sleeping
+ * ones are woken by the next kalert_broker_wake().
+ */
+void kalert_broker_publish(struct kalert_broker *b, uint64_t ts_ns,
+			   const struct kalert_notify_msg *notify)
+{
+	struct kalert_broker_record *rec = &b->rec[b->head & b->mask];
+	size_t len = sizeof(*notify) + notify->len;
+	uint32_t flags = 0;
+
+	if (len > KALERT_BROKER_MSG_MAX) {
+		len = KALERT_BROKER_MSG_MAX;
+		flags = KALERT_BROKER_TRUNCATED;
+		b->stats.truncated++;
+	}
+
+	/* see recent_add(): readers that see new bytes also see head move */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	rec->seq = b->head;
+	rec->ts_ns = ts_ns;
+	rec->len = len;
+	rec->flags = flags;
+	memcpy(rec->msg, notify, len);
+	if (flags)
+		((struct kalert_notify_msg *)rec->msg)->len =
+			len - sizeof(*notify);
+
+	__atomic_store_n(&b->hdr->head, ++b->head, __ATOMIC_RELEASE);
+	b->stats.published++;
+}
+
+/**
+ * kalert_broker_wake - wake the readers sleeping on the ring
+ * @b: broker
+ *
+ * Call once after a batch of kalert_broker_publish(). Only readers that
+ * armed themselves cost an eventfd write.
+ */
+void kalert_broker_wake(struct kalert_broker *b)
+{
+	struct kalert_broker_reader *rd;
+	uint64_t one = 1, mask;
+	unsigned int i;
+
+	if (b->woken == b->head)
+		return;
+	b->woken = b->head;
+
+	/* pairs with the reader's fence between arming and checking head */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for (mask = b->active; mask; mask &= mask - 1) {
+		i = __builtin_ctzll(mask);
+		rd = b->reader[i];
+		if (!__atomic_load_n(&rd->armed, __ATOMIC_RELAXED) ||
+		    !__atomic_exchange_n(&rd->armed, 0, __ATOMIC_RELAXED))
+			continue;
+		if (write(b->efd[i], &one, sizeof(one)) < 0)
+			continue;
+		rd->wakeups++;
+		b->stats.wakeups++;
+	}
+}
+
+void kalert_broker_get_stats(const struct kalert_broker *b,
+			     struct kalert_broker_stats *stats)
+{
+	const struct kalert_broker_reader *rd;
+	uint64_t mask, lag;
+
+	*stats = b->stats;
+	stats->readers = __builtin_popcountll(b->active);
+	stats->max_lag = 0;
+	stats->lost = 0;
+
+	for (mask = b->active; mask; mask &= mask - 1) {
+		rd = b->reader[__builtin_ctzll(mask)];
+		lag = b->head -
+		      __atomic_load_n(&rd->cursor, __ATOMIC_RELAXED);
+		if (lag > b->head)
+			lag = 0; /* a reader wrote nonsense */
+		if (lag > stats->max_lag)
+			stats->max_lag = lag;
+		stats->lost += __atomic_load_n(&rd->lost, __ATOMIC_RELAXED);
+	}
+}
+
+void kalert_broker_close(struct kalert_broker *b)
+{
+	unsigned int i;
+
+	if (!b)
+		return;
+
+	for (i = 0; i < KALERT_BROKER_READERS; i++) {
+		if (b->conn[i] >= 0)
+			broker_release(b, i);
+	}
+
+	if (b->lfd >= 0) {
+		close(b->lfd);
+		unlink(b->path);
+	}
+	if (b->epfd >= 0)
+		close(b->epfd);
+	if (b->hdr)
+		munmap(b->hdr, b->size);
+	if (b->memfd >= 0)
+		close(b->memfd);
+	free(b);
+}
+
+/* ------------------------ Reader transport ------------------------ */
+
+struct broker_ack {
+	struct nlmsghdr nlh;
+	struct nlmsgerr err;
+};
+
+struct broker_client {
+	int conn; /* closing it frees our slot */
+	int efd;
+	const struct kalert_broker_header *hdr;
+	struct kalert_broker_reader *slot;
+	const struct kalert_broker_record *rec;
+	size_t size;
+	uint64_t mask;
+	uint64_t cursor;
+	bool overrun; /* loss seen mid batch, reported by the next recv */
+	struct kalert_subscription sub;
+	unsigned int nacks;
+	struct broker_ack ack[BROKER_ACK_MAX];
+};
+
+static int client_connect(struct broker_client *bc, const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct timeval tv = { .tv_sec = BROKER_WELCOME_TIMEOUT };
+	struct kalert_broker_hello hello = {
+		.version = KALERT_BROKER_VERSION,
+	};
+	struct kalert_broker_welcome w;
+	int fds[BROKER_FDS];
+	struct stat st;
+	ssize_t rc;
+	unsigned int i;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	bc->conn = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (bc->conn < 0)
+		return -errno;
+	if (connect(bc->conn, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -errno;
+
+	setsockopt(bc->conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	rc = send_fd(bc->conn, &hello, sizeof(hello), bc->efd);
+	if (rc < 0)
+		return rc;
+
+	rc = recv_fds(bc->conn, &w, sizeof(w), fds);
+	if (rc < 0)
+		return rc == -EAGAIN ? -ETIMEDOUT : rc;
+	if (rc != (ssize_t)sizeof(w) ||
+	    (!w.status && (fds[0] < 0 || fds[1] < 0))) {
+		rc = -EPROTO;
+		goto out;
+	}
+	if (w.status < 0) {
+		rc = w.status;
+		goto out;
+	}
+
+	/* the ring is read only to us, only the slot is ours to write */
+	bc->hdr = mmap(NULL, w.size, PROT_READ, MAP_SHARED, fds[0], 0);
+	if (bc->hdr == MAP_FAILED) {
+		bc->hdr = NULL;
+		rc = -errno;
+		goto out;
+	}
+	bc->size = w.size;
+
+	if (fstat(fds[1], &st) < 0 || st.st_size < (off_t)sizeof(*bc->slot)) {
+		rc = -EPROTO;
+		goto out;
+	}
+	bc->slot = mmap(NULL, sizeof(*bc->slot), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fds[1], 0);
+	if (bc->slot == MAP_FAILED) {
+		bc->slot = NULL;
+		rc = -errno;
+		goto out;
+	}
+
+	if (memcmp(bc->hdr->magic, KALERT_BROKER_MAGIC,
+		   sizeof(bc->hdr->magic)) ||
+	    bc->hdr->version != KALERT_BROKER_VERSION ||
+	    bc->hdr->record_size != sizeof(struct kalert_broker_record) ||
+	    !bc->hdr->capacity ||
+	    (bc->hdr->capacity & (bc->hdr->capacity - 1)) ||
+	    w.slot >= bc->hdr->readers ||
+	    bc->hdr->hdr_size < sizeof(*bc->hdr) ||
+	    bc->hdr->hdr_size + (uint64_t)bc->hdr->capacity *
+					sizeof(*bc->rec) > w.size) {
+		rc = -EPROTO;
+		goto out;
+	}
+
+	bc->rec = (const struct kalert_broker_record *)((char *)bc->hdr +
+							bc->hdr->hdr_size);
+	bc->mask = bc->hdr->capacity - 1;
+	bc->cursor = bc->slot->cursor;
+	rc = 0;
+out:
+	for (i = 0; i < BROKER_FDS; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	return rc;
+}
+
+static void broker_client_free(struct broker_client *bc)
+{
+	if (bc->hdr)
+		munmap((void *)bc->hdr, bc->size);
+	if (bc->slot)
+		munmap(bc->slot, sizeof(*bc->slot));
+	if (bc->conn >= 0)
+		close(bc->conn);
+	if (bc->efd >= 0)
+		close(bc->efd);
+	free(bc);
+}
+
+static int broker_open(struct kalert_handle *h, const void *arg)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct broker_client *bc;
+	int rc;
+
+	bc = calloc(1, sizeof(*bc));
+	if (!bc)
+		return -ENOMEM;
+	bc->conn = -1;
+
+	/* until a subscription narrows it, everything kalertd received */
+	bc->sub.active = true;
+	bc->sub.type_mask = 1ULL << KALERT_NOTIFY_ALL;
+	bc->sub.level = KALERT_LEVEL_ALL;
+
+	bc->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (bc->efd < 0) {
+		rc = -errno;
+		goto err;
+	}
+
+	rc = client_connect(bc, arg ?: KALERT_BROKER_SOCKET);
+	if (rc < 0) {
+		kalert_msg(LOG_ERR, "Connecting to kalert broker %s (%s)",
+			   (const char *)(arg ?: KALERT_BROKER_SOCKET),
+			   strerror(-rc));
+		goto err;
+	}
+
+	/* readable on a wakeup, and when the broker goes away */
+	h->fd = epoll_create1(EPOLL_CLOEXEC);
+	if (h->fd < 0 || epoll_ctl(h->fd, EPOLL_CTL_ADD, bc->efd, &ev) < 0 ||
+	    epoll_ctl(h->fd, EPOLL_CTL_ADD, bc->conn, &ev) < 0) {
+		rc = -errno;
+		if (h->fd >= 0)
+			close(h->fd);
+		goto err;
+	}
+
+	h->portid = getpid();
+	h->priv = bc;
+	return 0;
+
+err:
+	broker_client_free(bc);
+	return rc;
+}
+
+/*
+ * The channel belongs to kalertd. Subscriptions are applied here, to
+ * what the ring carries; everything else is refused.
+ */
+static int broker_send(struct kalert_handle *h, struct mmsghdr *msgs,
+		       unsigned int vlen)
+{
+	struct broker_client *bc = h->priv;
+	struct broker_ack *ack;
+	struct nlmsghdr *nlh;
+	unsigned int i;
+	int len, err;
+
+	for (i = 0; i < vlen; i++) {
+		if (bc->nacks == BROKER_ACK_MAX)
+			break;
+
+		nlh = msgs[i].msg_hdr.msg_iov[0].iov_base;
+		len = msgs[i].msg_hdr.msg_iov[0].iov_len;
+		for (; NLMSG_OK(nlh, len) && bc->nacks < BROKER_ACK_MAX;
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == KALERT_CMD_SUBSCRIBE)
+				err = kalert_subscription_parse(&bc->sub, nlh);
+			else
+				err = -EOPNOTSUPP;
+
+			if (!err && !(nlh->nlmsg_flags & NLM_F_ACK))
+				continue;
+
+			ack = &bc->ack[bc->nacks++];
+			memset(ack, 0, sizeof(*ack));
+			ack->nlh.nlmsg_len = NLMSG_LENGTH(sizeof(ack->err));
+			ack->nlh.nlmsg_type = NLMSG_ERROR;
+			ack->nlh.nlmsg_seq = nlh->nlmsg_seq;
+			ack->nlh.nlmsg_pid = nlh->nlmsg_pid;
+			ack->err.error = err;
+			ack->err.msg = *nlh;
+		}
+	}
+
+	if (bc->nacks)
+		eventfd_write(bc->efd, 1);
+
+	return i ? (int)i : -ENOBUFS;
+}
+
+static void broker_fill(struct mmsghdr *msg, const void *data,
+			unsigned int len, uint16_t type, uint64_t ts_ns)
+{
+	struct iovec *iov = msg->msg_hdr.msg_iov;
+	struct sockaddr_nl *nladdr = msg->msg_hdr.msg_name;
+	struct nlmsghdr *nlh = iov->iov_base;
+
+	if (nladdr) {
+		memset(nladdr, 0, sizeof(*nladdr));
+		nladdr->nl_family = AF_NETLINK;
+		msg->msg_hdr.msg_namelen = sizeof(*nladdr);
+	}
+	/* the receive time is the kernel's, taken by the broker */
+	kalert_rx_ts_put(&msg->msg_hdr, ts_ns);
+
+	if (type == NLMSG_ERROR) {
+		/* a queued ACK, already framed */
+		memcpy(nlh, data, len);
+		msg->msg_len = len;
+		return;
+	}
+
+	memset(nlh, 0, sizeof(*nlh));
+	nlh->nlmsg_len = NLMSG_LENGTH(len);
+	nlh->nlmsg_type = type;
+	memcpy(NLMSG_DATA(nlh), data, len);
+	msg->msg_len = nlh->nlmsg_len;
+}
+
+/*
+ * Copy records from the cursor on into @msgs. A record is only used if
+ * head, read again after the copy, shows the broker did not lap it
+ * meanwhile. Sets *@lost to the records the broker overwrote first.
+ *
+ * A peek still consumes what it skips before the first record it
+ * returns, lost or filtered out by the subscription: nothing would ever
+ * return them, and leaving them would keep the ring looking non empty.
+ */
+static int broker_read_ring(struct broker_client *bc, struct mmsghdr *msgs,
+			    unsigned int vlen, bool peek, uint64_t *lost)
+{
+	const struct kalert_notify_msg *notify;
+	struct kalert_broker_record rec;
+	uint64_t cap = bc->mask + 1;
+	uint64_t cur = bc->cursor;
+	uint64_t skip = cur;
+	uint64_t head;
+	unsigned int n = 0;
+
+	*lost = 0;
+	head = __atomic_load_n(&bc->hdr->head, __ATOMIC_ACQUIRE);
+
+	while (n < vlen && cur < head) {
+		/* the slot after head - cap may be rewritten right now */
+		if (head - cur >= cap) {
+			if (peek && n)
+				break;
+			*lost += head - cap + 1 - cur;
+			cur = head - cap + 1;
+			skip = cur;
+		}
+
+		rec = bc->rec[cur & bc->mask];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&bc->hdr->head, __ATOMIC_RELAXED);
+		if (cur + cap <= head)
+			continue;
+		cur++;
+
+		notify = (const struct kalert_notify_msg *)rec.msg;
+		if (rec.len < sizeof(*notify) || rec.len > sizeof(rec.msg) ||
+		    !kalert_subscription_match(&bc->sub, notify->type,
+					       notify->event, notify->level)) {
+			if (!n)
+				skip = cur;
+			continue;
+		}
+
+		broker_fill(&msgs[n++], rec.msg, rec.len, NLMSG_MIN_TYPE,
+			    rec.ts_ns);
+	}
+
+	if (!peek || !n)
+		skip = cur;
+	bc->cursor = skip;
+	__atomic_store_n(&bc->slot->cursor, skip, __ATOMIC_RELAXED);
+	if (*lost)
+		__atomic_store_n(&bc->slot->lost, bc->slot->lost + *lost,
+				 __ATOMIC_RELAXED);
+
+	return n;
+}
+
+static int broker_recv(struct kalert_handle *h, struct mmsghdr *msgs,
+		       unsigned int vlen, int flags)
+{
+	struct broker_client *bc = h->priv;
+	struct pollfd pfd = { .fd = h->fd, .events = POLLIN };
+	bool peek = flags & MSG_PEEK;
+	unsigned int n, i;
+	eventfd_t cnt;
+	uint64_t lost;
+	char c;
+
+	for (;;) {
+		for (n = 0; n < vlen && n < bc->nacks; n++)
+			broker_fill(&msgs[n], &bc->ack[n], sizeof(bc->ack[n]),
+				    NLMSG_ERROR, 0);
+		if (n && !peek) {
+			bc->nacks -= n;
+			for (i = 0; i < bc->nacks; i++)
+				bc->ack[i] = bc->ack[i + n];
+		}
+
+		/* like a socket, report the overflow before what follows */
+		if (bc->overrun && !n) {
+			if (!peek)
+				bc->overrun = false;
+			return -ENOBUFS;
+		}
+
+		n += broker_read_ring(bc, msgs + n, vlen - n, peek, &lost);
+		if (lost) {
+			if (!n)
+				return -ENOBUFS;
+			bc->overrun = true;
+		}
+		if (n)
+			return n;
+
+		/* the broker closed our connection */
+		if (recv(bc->conn, &c, 1, MSG_DONTWAIT) == 0)
+			return -ECONNRESET;
+
+		/*
+		 * Caught up: reset the eventfd, arm, then look at head once
+		 * more. Either we see what the broker published meanwhile,
+		 * or the broker sees us armed and writes the eventfd.
+		 */
+		eventfd_read(bc->efd, &cnt);
+		__atomic_store_n(&bc->slot->armed, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&bc->hdr->head, __ATOMIC_RELAXED) !=
+		    bc->cursor) {
+			/* keep the fd readable for what a short batch leaves */
+			eventfd_write(bc->efd, 1);
+			continue;
+		}
+
+		if (flags & MSG_DONTWAIT)
+			return -EAGAIN;
+		if (poll(&pfd, 1, -1) < 0)
+			return -errno;
+	}
+}
+
+static void broker_close(struct kalert_handle *h)
+{
+	close(h->fd);
+	broker_client_free(h->priv);
+}
+
+const struct kalert_transport kalert_broker_transport = {
+	.name = "broker",
+	.open = broker_open,
+	.send = broker_send,
+	.recv = broker_recv,
+	.close = broker_close,
+};
+
+/**
+ * kalert_handle_open_broker - read notifications from kalertd's broker
+ * @path: broker socket, NULL for KALERT_BROKER_SOCKET
+ *
+ * The handle reads the shared ring kalertd republishes the kernel
+ * channel into, with the usual kalert_dispatch() callbacks and no
+ * kernel round trip per reader. It gets every notification until a
+ * subscription narrows it, the subscription is applied locally. Channel
+ * and status requests fail with -EOPNOTSUPP. Records overwritten before
+ * they were read are reported like a socket overrun.
+ *
+ * Return: new handle, or NULL on error (errno is set).
+ */
+struct kalert_handle *kalert_handle_open_broker(const char *path)
+{
+	return kalert_handle_open_transport(&kalert_broker_transport, path);
+}
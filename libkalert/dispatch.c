@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Callback dispatch of received notifications
+ *
+ * Callbacks live in flat tables indexed by event - KALERT_EVENT_BASE, by
+ * type and by level. Empty entries point at a no-op, so delivering one
+ * notification is three table loads and three indirect calls whatever
+ * the number of registrations. Filtered consumers (filter.c) come last.
+ */
+
+#include <stdlib.h>
+#include "private.h"
+
+static void dispatch_noop(const struct kalert_notify_msg *notify, void *data)
+{
+	(void)notify;
+	(void)data;
+}
+
+static void entries_reset(struct dispatch_entry *e, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		e[i].cb = dispatch_noop;
+		e[i].data = NULL;
+	}
+}
+
+/* The table is only allocated for handles that register a callback */
+struct kalert_dispatch *kalert_dispatch_get(struct kalert_handle *h)
+{
+	struct kalert_dispatch *d = h->dispatch;
+
+	if (d)
+		return d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+
+	entries_reset(d->event, KALERT_ARRAY_SIZE(d->event));
+	entries_reset(d->type, KALERT_ARRAY_SIZE(d->type));
+	entries_reset(d->level, KALERT_ARRAY_SIZE(d->level));
+	h->dispatch = d;
+	return d;
+}
+
+void kalert_dispatch_free(struct kalert_handle *h)
+{
+	free(h->dispatch);
+	h->dispatch = NULL;
+}
+
+static int entry_set(struct kalert_dispatch *d, struct dispatch_entry *e,
+		     kalert_notify_cb_t cb, void *data)
+{
+	d->callbacks -= e->cb != dispatch_noop;
+	d->callbacks += cb != NULL;
+	e->cb = cb ?: dispatch_noop;
+	e->data = cb ? data : NULL;
+	return 0;
+}
+
+/**
+ * kalert_dispatch_on_event - register a callback for one event id
+ * @h:     kalert handle
+ * @event: event id, KALERT_EVENT_BASE..KALERT_EVENT_END or
+ *         KALERT_EVENT_HEARTBEAT
+ * @cb:    callback, NULL removes the current one
+ * @data:  passed to @cb
+ *
+ * There is one callback per event id, per type and per level; registering
+ * again replaces the previous one. A notification fires its event, type
+ * and level callbacks, in that order.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int kalert_dispatch_on_event(struct kalert_handle *h, int event,
+			     kalert_notify_cb_t cb, void *data)
+{
+	struct kalert_dispatch *d;
+	int idx;
+
+	if (!h)
+		return -EBADF;
+
+	if (event == KALERT_EVENT_HEARTBEAT)
+		idx = DISPATCH_HEARTBEAT;
+	else if (event >= KALERT_EVENT_BASE && event < KALERT_EVENT_END)
+		idx = event - KALERT_EVENT_BASE;
+	else
+		return -EINVAL;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+	return entry_set(d, &d->event[idx], cb, data);
+}
+
+/* Register a callback for every notification of @type */
+int kalert_dispatch_on_type(struct kalert_handle *h, uint32_t type,
+			    kalert_notify_cb_t cb, void *data)
+{
+	struct kalert_dispatch *d;
+
+	if (!h)
+		return -EBADF;
+	if (type >= KALERT_NOTIFY_MAX)
+		return -EINVAL;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+	return entry_set(d, &d->type[type], cb, data);
+}
+
+/* Register a callback for every notification of @level */
+int kalert_dispatch_on_level(struct kalert_handle *h, uint32_t level,
+			     kalert_notify_cb_t cb, void *data)
+{
+	struct kalert_dispatch *d;
+
+	if (!h)
+		return -EBADF;
+	if (level >= KALERT_LEVEL_MAX)
+		return -EINVAL;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+	return entry_set(d, &d->level[level], cb, data);
+}
+
+static inline void dispatch_one(const struct kalert_dispatch *d,
+				const struct kalert_notify_msg *notify)
+{
+	const struct dispatch_entry *e;
+	unsigned int idx;
+	uint64_t match;
+
+	/* the heartbeat is the only valid id past KALERT_EVENT_END */
+	idx = notify->event - KALERT_EVENT_BASE;
+	if (idx > DISPATCH_HEARTBEAT)
+		idx = DISPATCH_HEARTBEAT;
+
+	/* nobody wants it: one AND, and no call through the empty tables */
+	match = d->event_consumers[idx] & d->level_consumers[notify->level];
+	if (!match && !d->callbacks)
+		return;
+
+	e = &d->event[idx];
+	e->cb(notify, e->data);
+	e = &d->type[notify->type];
+	e->cb(notify, e->data);
+	e = &d->level[notify->level];
+	e->cb(notify, e->data);
+
+	while (match) {
+		e = &d->consumer[__builtin_ctzll(match)].entry;
+		e->cb(notify, e->data);
+		match &= match - 1;
+	}
+}
+
+/**
+ * kalert_dispatch - drain the socket and fire the registered callbacks
+ * @h:          kalert handle
+ * @max_events: stop receiving once this many notifications were
+ *              dispatched, 0 or negative drains the socket
+ *
+ * Never blocks, so it fits an event loop's read handler. Datagrams are
+ * received in batches and always dispatched whole, so a datagram carrying
+ * several messages may take the count slightly past @max_events. Invalid
+ * notifications are skipped. A receive buffer overrun is accounted in the
+ * loss stats and draining goes on.
+ *
+ * Return: number of notifications dispatched, or a negative error code if
+ * nothing was dispatched and receiving failed with something else than
+ * EAGAIN.
+ */
+int kalert_dispatch(struct kalert_handle *h, int max_events)
+{
+	struct kalert_notify_iter iter;
+	struct kalert_notify_msg *notify;
+	struct kalert_dispatch *d;
+	unsigned int want;
+	int done = 0;
+	int n, i;
+
+	if (!h)
+		return -EBADF;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+
+	for (;;) {
+		want = DISPATCH_BATCH;
+		if (max_events > 0) {
+			if (done >= max_events)
+				break;
+			if ((unsigned int)(max_events - done) < want)
+				want = max_events - done;
+		}
+
+		n = kalert_handle_get_reply_batch(h, d->slots, want,
+						  GET_REPLY_NONBLOCKING);
+		if (n == -ENOBUFS)
+			continue;
+		if (n < 0) {
+			if (n == -EAGAIN || done)
+				break;
+			return n;
+		}
+
+		for (i = 0; i < n; i++) {
+			/* rejected by the receive checks, nothing in it to trust */
+			if (d->slots[i].len <= 0)
+				continue;
+			d->ts_ns = d->slots[i].ts_ns;
+			if (h->status_seq)
+				kalert_dispatch_status(h, d, &d->slots[i].msg,
+						       d->slots[i].len);
+			kalert_for_each_notify(notify, &iter, &d->slots[i].msg,
+					       d->slots[i].len) {
+				if (!kalert_notify_valid(notify))
+					continue;
+				dispatch_one(d, notify);
+				done++;
+			}
+		}
+
+		if ((unsigned int)n < want)
+			break;
+	}
+
+	return done;
+}
+
+/**
+ * kalert_dispatch_ts - receipt time of the notification being dispatched
+ * @h: kalert handle
+ *
+ * For callbacks run by kalert_dispatch(). All messages of one datagram
+ * share the time it was received. Outside of a callback it is the time of
+ * the last datagram dispatched.
+ *
+ * Return: CLOCK_REALTIME in ns, 0 if nothing was dispatched yet.
+ */
+uint64_t kalert_dispatch_ts(struct kalert_handle *h)
+{
+	return h && h->dispatch ? h->dispatch->ts_ns : 0;
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Event, type, level and channel attribute metadata tables
+ * generated from the lists in <libkalert/events.h>
+ */
+
+#include <libkalert/libkalert.h>
+
+#define NAME_INIT(s)                                             \
+	{ .str = s, .json = "\"" s "\"", .len = sizeof(s) - 1, \
+	  .json_len = sizeof(s) + 1 }
+
+#define EVENT_UNKNOWN                                          \
+	{ .name = NAME_INIT("unknown"), .type = KALERT_NOTIFY_ALL, \
+	  .level = KALERT_LEVEL_ALL }
+
+#define EVENT_ENTRY(id, s, t, l)                                    \
+	[(id) - KALERT_EVENT_BASE] = { .name = NAME_INIT(s),        \
+				       .event = (id),               \
+				       .type = (t),                 \
+				       .level = (l),                \
+				       .known = true },
+
+#define NAME_ENTRY(idx, s) [idx] = NAME_INIT(s),
+
+/*
+ * Every slot starts as "unknown" and the listed events override theirs,
+ * so lookups never have to check for holes.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+const struct kalert_event_info kalert_events[KALERT_EVENT_MAX + 2] = {
+	[0 ... KALERT_EVENT_MAX - 1] = EVENT_UNKNOWN,
+	KALERT_EVENT_LIST(EVENT_ENTRY)
+	[KALERT_EVENT_MAX] = { .name = NAME_INIT("heartbeat"),
+			      .event = KALERT_EVENT_HEARTBEAT,
+			      .type = KALERT_NOTIFY_ALL,
+			      .level = KALERT_LEVEL_ALL,
+			      .known = true },
+	[KALERT_EVENT_MAX + 1] = EVENT_UNKNOWN,
+};
+#pragma GCC diagnostic pop
+
+const struct kalert_name kalert_types[KALERT_NOTIFY_MAX] = {
+	KALERT_TYPE_LIST(NAME_ENTRY)
+};
+
+const struct kalert_name kalert_levels[KALERT_LEVEL_MAX] = {
+	KALERT_LEVEL_LIST(NAME_ENTRY)
+};
+
+const struct kalert_name kalert_chnl_attrs[KALERT_ATTR_MAX] = {
+	KALERT_CHNL_ATTR_LIST(NAME_ENTRY)
+};
+
+const struct kalert_name kalert_name_unknown = NAME_INIT("unknown");
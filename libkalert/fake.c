@@ -0,0 +1,481 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Loopback transport with an in-process fake kalert kernel
+ *
+ * The fake kernel runs in its own thread at the far end of a socketpair.
+ * It answers SET_CHNL, SUBSCRIBE and GET_STATUS like the kernel module
+ * does, ACKs included, and generates notifications at a configurable
+ * rate, filtered by the channel settings and the subscription. This lets
+ * libkalert and kalertd be exercised without NETLINK_KALERT.
+ */
+
+#include <libkalert/libkalert.h>
+#include <libmnl/libmnl.h>
+#include <linux/sockios.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "private.h"
+
+/* Notifications the generator may emit back to back before polling again */
+#define FAKE_BURST_MAX 256
+
+#define NSEC_PER_SEC 1000000000LL
+
+struct fake_kernel {
+	int fd; /* kernel end of the socketpair */
+	pthread_t thread;
+
+	uint32_t rate; /* atomic, notifications per second */
+	uint64_t limit;
+	bool stamp;
+	struct kalert_fake_event *events;
+	size_t nevents;
+	size_t next_event;
+
+	/* channel state, only touched by the fake kernel thread */
+	uint32_t chnl[KALERT_ATTR_MAX];
+	struct kalert_subscription sub;
+
+	struct kalert_fake_stats stats; /* atomics */
+	char buf[KALERT_MAX_MSG_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+};
+
+/* Every known event at its default level */
+#define FAKE_EVENT(id, name, t, l) { .type = (t), .event = (id), .level = (l) },
+static const struct kalert_fake_event default_events[] = {
+	KALERT_EVENT_LIST(FAKE_EVENT)
+};
+#undef FAKE_EVENT
+
+#define STAT_INC(fk, field) \
+	__atomic_add_fetch(&(fk)->stats.field, 1, __ATOMIC_RELAXED)
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int fake_send(struct fake_kernel *fk, struct nlmsghdr *nlh, int flags)
+{
+	int rc;
+
+	do {
+		rc = send(fk->fd, nlh, nlh->nlmsg_len, flags);
+	} while (rc < 0 && errno == EINTR);
+
+	return rc < 0 ? -errno : 0;
+}
+
+static void fake_ack(struct fake_kernel *fk, const struct nlmsghdr *req,
+		     int error)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct nlmsgerr err;
+	} ack;
+
+	memset(&ack, 0, sizeof(ack));
+	ack.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(ack.err));
+	ack.nlh.nlmsg_type = NLMSG_ERROR;
+	ack.nlh.nlmsg_seq = req->nlmsg_seq;
+	ack.nlh.nlmsg_pid = req->nlmsg_pid;
+	ack.err.error = error;
+	ack.err.msg = *req;
+
+	fake_send(fk, &ack.nlh, 0);
+}
+
+static int fake_set_chnl(struct fake_kernel *fk, const struct nlmsghdr *nlh)
+{
+	const struct nlattr *attr;
+	uint16_t type;
+
+	/* Validate everything first, a bad request changes nothing */
+	mnl_attr_for_each(attr, nlh, 0) {
+		type = mnl_attr_get_type(attr);
+		if (type == KALERT_ATTR_UNSPEC || type >= KALERT_ATTR_MAX ||
+		    type == KALERT_BACKLOG_DEPTH ||
+		    type == KALERT_GET_STAT_MASK)
+			return -EINVAL;
+		if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
+			return -EINVAL;
+		if (type == KALERT_FILTER_LEVEL &&
+		    mnl_attr_get_u32(attr) >= KALERT_LEVEL_MAX)
+			return -EINVAL;
+	}
+
+	mnl_attr_for_each(attr, nlh, 0) {
+		type = mnl_attr_get_type(attr);
+		fk->chnl[type] = mnl_attr_get_u32(attr);
+	}
+
+	return 0;
+}
+
+static int fake_get_status(struct fake_kernel *fk, const struct nlmsghdr *req)
+{
+	const struct nlattr *attr;
+	struct nlmsghdr *nlh;
+	uint64_t mask = ~0ULL;
+	int outq = 0;
+	int i;
+
+	mnl_attr_for_each(attr, req, 0) {
+		if (mnl_attr_get_type(attr) == KALERT_GET_STAT_MASK &&
+		    mnl_attr_validate(attr, MNL_TYPE_U64) == 0)
+			mask = mnl_attr_get_u64(attr);
+	}
+
+	/* Approximate the backlog from the bytes still queued to the user */
+	if (ioctl(fk->fd, SIOCOUTQ, &outq) == 0)
+		fk->chnl[KALERT_BACKLOG_DEPTH] =
+			outq / NLMSG_SPACE(sizeof(struct kalert_notify_msg));
+
+	nlh = mnl_nlmsg_put_header(fk->buf);
+	nlh->nlmsg_type = KALERT_CMD_GET_STATUS;
+	nlh->nlmsg_seq = req->nlmsg_seq;
+	nlh->nlmsg_pid = req->nlmsg_pid;
+
+	for (i = 1; i < KALERT_ATTR_MAX; i++) {
+		if (i == KALERT_GET_STAT_MASK || !(mask & KALERT_MASK(i)))
+			continue;
+		mnl_attr_put_u32(nlh, i, fk->chnl[i]);
+	}
+
+	return fake_send(fk, nlh, 0);
+}
+
+static void fake_handle_request(struct fake_kernel *fk,
+				const struct nlmsghdr *nlh)
+{
+	int err;
+
+	STAT_INC(fk, requests);
+
+	switch (nlh->nlmsg_type) {
+	case KALERT_CMD_SET_CHNL:
+		err = fake_set_chnl(fk, nlh);
+		break;
+	case KALERT_CMD_SUBSCRIBE:
+		err = kalert_subscription_parse(&fk->sub, nlh);
+		break;
+	case KALERT_CMD_GET_STATUS:
+		err = fake_get_status(fk, nlh);
+		break;
+	default:
+		err = -EOPNOTSUPP;
+	}
+
+	/* Like netlink_rcv_skb(): errors are always reported */
+	if (err || (nlh->nlmsg_flags & NLM_F_ACK))
+		fake_ack(fk, nlh, err);
+}
+
+/* Handle every queued request, return -1 once the user end is gone */
+static int fake_handle_requests(struct fake_kernel *fk)
+{
+	char req[KALERT_MAX_MSG_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	int len;
+
+	for (;;) {
+		len = recv(fk->fd, req, sizeof(req), MSG_DONTWAIT);
+		if (len == 0)
+			return -1;
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN ? 0 : -1;
+		}
+
+		for (nlh = (struct nlmsghdr *)req; NLMSG_OK(nlh, len);
+		     nlh = NLMSG_NEXT(nlh, len))
+			fake_handle_request(fk, nlh);
+	}
+}
+
+static bool fake_wants(struct fake_kernel *fk,
+		       const struct kalert_fake_event *ev)
+{
+	/* The registered channel port gets everything above its level */
+	if (fk->chnl[KALERT_ENABLE] && fk->chnl[KALERT_PORTID] &&
+	    ev->level >= fk->chnl[KALERT_FILTER_LEVEL])
+		return true;
+
+	return kalert_subscription_match(&fk->sub, ev->type, ev->event,
+					 ev->level);
+}
+
+static void fake_emit(struct fake_kernel *fk)
+{
+	const struct kalert_fake_event *ev;
+	struct kalert_notify_msg *notify;
+	struct nlmsghdr *nlh;
+	long long stamp;
+	int rc;
+
+	ev = &fk->events[fk->next_event++ % fk->nevents];
+	STAT_INC(fk, generated);
+
+	if (!fake_wants(fk, ev)) {
+		STAT_INC(fk, filtered);
+		return;
+	}
+
+	/* Kernel originated broadcasts carry seq 0 */
+	nlh = mnl_nlmsg_put_header(fk->buf);
+	nlh->nlmsg_type = NLMSG_MIN_TYPE;
+	notify = mnl_nlmsg_get_payload(nlh);
+	memset(notify, 0, sizeof(*notify));
+	notify->type = ev->type;
+	notify->event = ev->event;
+	notify->level = ev->level;
+	nlh->nlmsg_len += sizeof(*notify);
+
+	/* lets benchmarks measure the delivery latency */
+	if (fk->stamp) {
+		stamp = now_ns();
+		memcpy(notify->data, &stamp, sizeof(stamp));
+		notify->len = sizeof(stamp);
+		nlh->nlmsg_len += sizeof(stamp);
+	}
+
+	rc = fake_send(fk, nlh, MSG_DONTWAIT);
+	if (rc == -EAGAIN || rc == -ENOBUFS) {
+		fk->chnl[KALERT_PACKLOSS_COUNT]++;
+		STAT_INC(fk, lost);
+		return;
+	}
+	if (rc == 0)
+		STAT_INC(fk, delivered);
+}
+
+static void *fake_kernel_run(void *arg)
+{
+	struct fake_kernel *fk = arg;
+	struct pollfd pfd = { .fd = fk->fd, .events = POLLIN };
+	struct timespec timeout;
+	long long next = now_ns();
+	long long now, wait;
+	uint32_t rate;
+	int burst;
+
+	for (;;) {
+		rate = __atomic_load_n(&fk->rate, __ATOMIC_RELAXED);
+		if (fk->limit && fk->stats.generated >= fk->limit)
+			rate = 0;
+
+		now = now_ns();
+		if (!rate) {
+			/* idle, but notice rate changes reasonably fast */
+			wait = NSEC_PER_SEC / 10;
+			next = now;
+		} else {
+			/* never build up more than a second of backlog */
+			if (next < now - NSEC_PER_SEC)
+				next = now;
+			wait = next > now ? next - now : 0;
+		}
+
+		timeout.tv_sec = wait / NSEC_PER_SEC;
+		timeout.tv_nsec = wait % NSEC_PER_SEC;
+		if (ppoll(&pfd, 1, &timeout, NULL) < 0 && errno != EINTR)
+			break;
+
+		if (pfd.revents & (POLLHUP | POLLERR))
+			break;
+		if ((pfd.revents & POLLIN) && fake_handle_requests(fk) < 0)
+			break;
+
+		if (!rate)
+			continue;
+
+		now = now_ns();
+		for (burst = 0; next <= now && burst < FAKE_BURST_MAX;
+		     burst++) {
+			if (fk->limit && fk->stats.generated >= fk->limit)
+				break;
+			fake_emit(fk);
+			next += NSEC_PER_SEC / rate;
+		}
+	}
+
+	return NULL;
+}
+
+/* ---------------------- Fake transport ops ---------------------- */
+static int fake_open(struct kalert_handle *h, const void *arg)
+{
+	const struct kalert_fake_config *cfg = arg;
+	const struct kalert_fake_event *events = default_events;
+	size_t nevents = KALERT_ARRAY_SIZE(default_events);
+	struct fake_kernel *fk;
+	int sv[2];
+	int rc;
+
+	if (cfg && cfg->events && cfg->nevents) {
+		events = cfg->events;
+		nevents = cfg->nevents;
+	}
+
+	fk = calloc(1, sizeof(*fk));
+	if (!fk)
+		return -ENOMEM;
+
+	fk->events = malloc(nevents * sizeof(*events));
+	if (!fk->events) {
+		rc = -ENOMEM;
+		goto err_free;
+	}
+	memcpy(fk->events, events, nevents * sizeof(*events));
+	fk->nevents = nevents;
+	if (cfg) {
+		fk->rate = cfg->rate;
+		fk->limit = cfg->count;
+		fk->stamp = cfg->stamp;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		rc = -errno;
+		goto err_free;
+	}
+
+	h->fd = sv[0];
+	h->portid = getpid();
+	fk->fd = sv[1];
+
+	rc = -pthread_create(&fk->thread, NULL, fake_kernel_run, fk);
+	if (rc < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		goto err_free;
+	}
+
+	h->priv = fk;
+	return 0;
+
+err_free:
+	free(fk->events);
+	free(fk);
+	return rc;
+}
+
+static int fake_send_ops(struct kalert_handle *h, struct mmsghdr *msgs,
+			 unsigned int vlen)
+{
+	unsigned int i;
+	int rc;
+
+	/* the socketpair is connected, drop the netlink destination */
+	for (i = 0; i < vlen; i++) {
+		msgs[i].msg_hdr.msg_name = NULL;
+		msgs[i].msg_hdr.msg_namelen = 0;
+	}
+
+	rc = sendmmsg(h->fd, msgs, vlen, 0);
+	return rc < 0 ? -errno : rc;
+}
+
+static int fake_recv_ops(struct kalert_handle *h, struct mmsghdr *msgs,
+			 unsigned int vlen, int flags)
+{
+	struct sockaddr_nl *nladdr;
+	int rc, i;
+
+	rc = recvmmsg(h->fd, msgs, vlen, flags, NULL);
+	if (rc < 0)
+		return -errno;
+
+	/* everything on this socket comes from the fake kernel */
+	for (i = 0; i < rc; i++) {
+		nladdr = msgs[i].msg_hdr.msg_name;
+		if (!nladdr)
+			continue;
+		memset(nladdr, 0, sizeof(*nladdr));
+		nladdr->nl_family = AF_NETLINK;
+		msgs[i].msg_hdr.msg_namelen = sizeof(*nladdr);
+	}
+
+	return rc;
+}
+
+static void fake_close(struct kalert_handle *h)
+{
+	struct fake_kernel *fk = h->priv;
+
+	shutdown(h->fd, SHUT_RDWR);
+	pthread_join(fk->thread, NULL);
+	close(fk->fd);
+	close(h->fd);
+	free(fk->events);
+	free(fk);
+}
+
+const struct kalert_transport kalert_fake_transport = {
+	.name = "fake",
+	.open = fake_open,
+	.send = fake_send_ops,
+	.recv = fake_recv_ops,
+	.close = fake_close,
+};
+
+/**
+ * kalert_handle_open_fake - open a handle backed by an in-process fake kernel
+ * @cfg: generator settings, NULL for a silent fake kernel
+ *
+ * The returned handle works with every kalert_handle_* call. The fake
+ * kernel delivers its notifications once the channel is started or a
+ * subscription is made, exactly like the real module.
+ *
+ * Return: new handle, or NULL on error (errno is set).
+ */
+struct kalert_handle *
+kalert_handle_open_fake(const struct kalert_fake_config *cfg)
+{
+	return kalert_handle_open_transport(&kalert_fake_transport, cfg);
+}
+
+/* Change the generation rate of a fake handle at run time */
+int kalert_fake_set_rate(struct kalert_handle *h, uint32_t rate)
+{
+	struct fake_kernel *fk;
+
+	if (!h || h->ops != &kalert_fake_transport)
+		return -EINVAL;
+
+	fk = h->priv;
+	__atomic_store_n(&fk->rate, rate, __ATOMIC_RELAXED);
+	return 0;
+}
+
+int kalert_fake_get_stats(struct kalert_handle *h,
+			  struct kalert_fake_stats *stats)
+{
+	struct fake_kernel *fk;
+
+	if (!h || h->ops != &kalert_fake_transport || !stats)
+		return -EINVAL;
+
+	fk = h->priv;
+	stats->generated =
+		__atomic_load_n(&fk->stats.generated, __ATOMIC_RELAXED);
+	stats->filtered =
+		__atomic_load_n(&fk->stats.filtered, __ATOMIC_RELAXED);
+	stats->delivered =
+		__atomic_load_n(&fk->stats.delivered, __ATOMIC_RELAXED);
+	stats->lost = __atomic_load_n(&fk->stats.lost, __ATOMIC_RELAXED);
+	stats->requests =
+		__atomic_load_n(&fk->stats.requests, __ATOMIC_RELAXED);
+	return 0;
+}
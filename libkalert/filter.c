@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: User space pre-filtering for several consumers sharing
+ * one kalert handle
+ *
+ * The kernel filters per socket. When one process hosts several
+ * consumers, each one registers its own event set and minimum level
+ * here. The per-consumer bitmaps are kept transposed in the dispatch
+ * table, one 64-bit word per event id and per level, so matching a
+ * notification against every consumer is two loads and an AND.
+ */
+
+#include <libmnl/libmnl.h>
+
+#include "private.h"
+
+/* Rebuild consumer @id's column of the bit sliced matrix */
+static void consumer_sync(struct kalert_dispatch *d, unsigned int id)
+{
+	const struct kalert_consumer *c = &d->consumer[id];
+	uint64_t bit = 1ULL << id;
+	unsigned int i;
+	bool set;
+
+	for (i = 0; i < KALERT_EVENT_MAX; i++) {
+		set = c->used &&
+		      (c->events[i / BITS_PER_LONG] >> (i % BITS_PER_LONG)) & 1;
+		if (set)
+			d->event_consumers[i] |= bit;
+		else
+			d->event_consumers[i] &= ~bit;
+	}
+
+	for (i = 0; i < KALERT_LEVEL_MAX; i++) {
+		if (c->used && i >= c->min_level)
+			d->level_consumers[i] |= bit;
+		else
+			d->level_consumers[i] &= ~bit;
+	}
+}
+
+static int consumer_set_events(struct kalert_consumer *c, const int *event_ids,
+			       size_t count)
+{
+	size_t i;
+
+	/* no list means every event */
+	if (!event_ids || !count) {
+		for (i = 0; i < KALERT_ARRAY_SIZE(c->events); i++)
+			c->events[i] = ~0UL;
+		return 0;
+	}
+
+	return events_to_bitmap(event_ids, count, c->events, KALERT_EVENT_MAX);
+}
+
+static struct kalert_consumer *consumer_get(struct kalert_handle *h, int id,
+					    struct kalert_dispatch **d)
+{
+	if (!h || !h->dispatch)
+		return NULL;
+	if (id < 0 || id >= KALERT_CONSUMER_MAX)
+		return NULL;
+	if (!h->dispatch->consumer[id].used)
+		return NULL;
+
+	*d = h->dispatch;
+	return &(*d)->consumer[id];
+}
+
+/**
+ * kalert_consumer_add - register a filtered consumer on a handle
+ * @h:         kalert handle
+ * @event_ids: events the consumer wants, NULL for all
+ * @count:     number of entries in @event_ids
+ * @min_level: lowest level delivered
+ * @cb:        called by kalert_dispatch() for every matching notification
+ * @data:      passed to @cb
+ *
+ * Consumers are independent of the per event, type and level callbacks
+ * and of each other; a notification is handed to every consumer it
+ * matches, in consumer id order, after those callbacks. The kernel
+ * subscription of the handle still has to cover the union of what the
+ * consumers want.
+ *
+ * Return: consumer id (0..KALERT_CONSUMER_MAX - 1) or a negative error
+ * code. -ENOSPC when every slot is taken.
+ */
+int kalert_consumer_add(struct kalert_handle *h, const int *event_ids,
+			size_t count, uint32_t min_level,
+			kalert_notify_cb_t cb, void *data)
+{
+	struct kalert_dispatch *d;
+	struct kalert_consumer *c;
+	unsigned int id;
+	int rc;
+
+	if (!h)
+		return -EBADF;
+	if (!cb || min_level >= KALERT_LEVEL_MAX)
+		return -EINVAL;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+
+	for (id = 0; id < KALERT_CONSUMER_MAX; id++) {
+		if (!d->consumer[id].used)
+			break;
+	}
+	if (id == KALERT_CONSUMER_MAX)
+		return -ENOSPC;
+
+	c = &d->consumer[id];
+	rc = consumer_set_events(c, event_ids, count);
+	if (rc < 0)
+		return rc;
+
+	c->entry.cb = cb;
+	c->entry.data = data;
+	c->min_level = min_level;
+	c->used = true;
+	consumer_sync(d, id);
+	return id;
+}
+
+/* Replace the event set of consumer @id, NULL selects every event */
+int kalert_consumer_set_events(struct kalert_handle *h, int id,
+			       const int *event_ids, size_t count)
+{
+	struct kalert_dispatch *d;
+	struct kalert_consumer *c;
+	unsigned long old[KALERT_ARRAY_SIZE(c->events)];
+	int rc;
+
+	c = consumer_get(h, id, &d);
+	if (!c)
+		return -EINVAL;
+
+	/* keep the previous set if the new one is rejected */
+	memcpy(old, c->events, sizeof(old));
+	rc = consumer_set_events(c, event_ids, count);
+	if (rc < 0) {
+		memcpy(c->events, old, sizeof(old));
+		return rc;
+	}
+
+	consumer_sync(d, id);
+	return 0;
+}
+
+int kalert_consumer_set_level(struct kalert_handle *h, int id,
+			      uint32_t min_level)
+{
+	struct kalert_dispatch *d;
+	struct kalert_consumer *c;
+
+	c = consumer_get(h, id, &d);
+	if (!c || min_level >= KALERT_LEVEL_MAX)
+		return -EINVAL;
+
+	c->min_level = min_level;
+	consumer_sync(d, id);
+	return 0;
+}
+
+int kalert_consumer_remove(struct kalert_handle *h, int id)
+{
+	struct kalert_dispatch *d;
+	struct kalert_consumer *c;
+
+	c = consumer_get(h, id, &d);
+	if (!c)
+		return -EINVAL;
+
+	memset(c, 0, sizeof(*c));
+	consumer_sync(d, id);
+	return 0;
+}
+
+/**
+ * kalert_consumer_match - consumers interested in a notification
+ * @h:      kalert handle
+ * @notify: notification, as returned by the iterator
+ *
+ * For applications that drain the socket themselves instead of calling
+ * kalert_dispatch(). Cheap enough to run before any validation beyond
+ * the type and level bounds, or any formatting.
+ *
+ * Return: bitmask of consumer ids, 0 if nobody wants @notify.
+ */
+uint64_t kalert_consumer_match(const struct kalert_handle *h,
+			       const struct kalert_notify_msg *notify)
+{
+	const struct kalert_dispatch *d = h ? h->dispatch : NULL;
+	uint32_t idx;
+
+	if (!d || notify->level >= KALERT_LEVEL_MAX)
+		return 0;
+
+	idx = notify->event - KALERT_EVENT_BASE;
+	if (idx >= KALERT_EVENT_MAX)
+		return 0;
+
+	return d->event_consumers[idx] & d->level_consumers[notify->level];
+}
+
+/**
+ * kalert_subscription_parse - decode a SUBSCRIBE request
+ * @sub: replaced by the new subscription, untouched on error
+ * @nlh: KALERT_CMD_SUBSCRIBE request
+ *
+ * Return: 0, or -EINVAL for a malformed request.
+ */
+int kalert_subscription_parse(struct kalert_subscription *sub,
+			      const struct nlmsghdr *nlh)
+{
+	struct kalert_subscription new = { .level = KALERT_LEVEL_ALL };
+	const struct nlattr *attr;
+	size_t len;
+
+	mnl_attr_for_each(attr, nlh, 0) {
+		switch (mnl_attr_get_type(attr)) {
+		case KALERT_SUB_TYPE_MASK:
+			if (mnl_attr_validate(attr, MNL_TYPE_U64) < 0)
+				return -EINVAL;
+			new.type_mask = mnl_attr_get_u64(attr);
+			break;
+		case KALERT_SUB_LEVEL:
+			if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
+				return -EINVAL;
+			new.level = mnl_attr_get_u32(attr);
+			break;
+		case KALERT_SUB_EVENT_MASK:
+			len = mnl_attr_get_payload_len(attr);
+			if (len > sizeof(new.events))
+				len = sizeof(new.events);
+			memcpy(new.events, mnl_attr_get_payload(attr), len);
+			new.by_event = true;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	new.active = true;
+	*sub = new;
+	return 0;
+}
+
+/* Whether the kernel would deliver a notification under @sub */
+bool kalert_subscription_match(const struct kalert_subscription *sub,
+			       uint32_t type, uint32_t event, uint32_t level)
+{
+	uint32_t idx;
+
+	if (!sub->active || level < sub->level)
+		return false;
+
+	if (sub->by_event) {
+		idx = event - KALERT_EVENT_BASE;
+		if (idx >= KALERT_EVENT_MAX)
+			return false;
+		return sub->events[idx / BITS_PER_LONG] &
+		       (1UL << (idx % BITS_PER_LONG));
+	}
+
+	return sub->type_mask &
+	       ((1ULL << KALERT_NOTIFY_ALL) | (1ULL << type));
+}
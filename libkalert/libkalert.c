@@ -7,35 +7,15 @@
  */
 
 #include <libkalert/libkalert.h>
-#include <libmnl/libmnl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #include "private.h"
 
-#define ATTR_MASK_ALLOWED_SET                                         \
-	((1U << KALERT_ENABLE) | (1U << KALERT_PORTID) |              \
-	 (1U << KALERT_FILTER_LEVEL) | (1U << KALERT_BACKLOG_LIMIT) | \
-	 (1U << KALERT_PACKLOSS_COUNT))
-
-int kalert_request_status(int fd, uint64_t mask)
-{
-	struct kalert_message req;
-
-	memset(&req, 0, sizeof(req));
-	req.nlh.nlmsg_len = NLMSG_LENGTH(0);
-	req.nlh.nlmsg_type = KALERT_CMD_GET_STATUS;
-
-	mnl_attr_put_u64(&req.nlh, KALERT_GET_STAT_MASK, mask);
-
-	int rc = kalert_send_request(fd, &req);
-	if (rc < 0)
-		kalert_msg(LOG_WARNING, "Error sending status request (%s)",
-			   strerror(-rc));
-	return rc;
-}
-
 /**
- * kalert_set_parameter - Set a configuration parameter for the kalert channel
+ * kalert_handle_set_parameter - Set a configuration parameter for the kalert channel
+ * @h:         kalert handle
  * @attr_mask: The attribute type mask to specify attr to set(see enum kalert_chnl_attr_t).
  * @attr:     Attr value arry to set. The expected type depends on
  *            attr type(use 64-bit unsigned integer values to store).
@@ -49,33 +29,20 @@ int kalert_request_status(int fd, uint64_t mask)
  *   0 on success,
  *   a negative error code from on failure.
  */
-int kalert_set_parameter(int fd, uint32_t attr_mask, uint64_t *attr)
+int kalert_handle_set_parameter(struct kalert_handle *h, uint32_t attr_mask,
+				const uint64_t *attr)
 {
-	struct kalert_message req;
 	int rc;
-	int i;
 
-	if (fd < 0)
+	if (!h)
 		return -EBADF;
 
-	if (attr_mask & ~ATTR_MASK_ALLOWED_SET) {
-		kalert_msg(LOG_WARNING,
-			   "Parameters to set are not allowed, mask:%x",
-			   attr_mask);
-		return -EINVAL;
-	}
-
-	memset(&req, 0, sizeof(req));
-	req.nlh.nlmsg_len = NLMSG_LENGTH(0);
-	req.nlh.nlmsg_type = KALERT_CMD_SET_CHNL;
-
-	for (i = 1; i < KALERT_ATTR_MAX; i++) {
-		if (attr_mask & KALERT_MASK(i)) {
-			mnl_attr_put_u32(&req.nlh, i, attr[i]);
-		}
-	}
+	rc = kalert_build_set_chnl(h->req.buf, sizeof(h->req), attr_mask,
+				   attr);
+	if (rc < 0)
+		return rc;
 
-	rc = kalert_send_request(fd, &req);
+	rc = kalert_send_nlmsg(h, &h->req.nlh);
 	if (rc < 0) {
 		kalert_msg(LOG_WARNING,
 			   "Error setting kalert channel parameter (%s)",
@@ -86,38 +53,117 @@ int kalert_set_parameter(int fd, uint32_t attr_mask, uint64_t *attr)
 	return 0;
 }
 
-int kalert_set_portid(int fd, uint32_t portid)
+int kalert_set_parameter(int fd, uint32_t attr_mask, uint64_t *attr)
+{
+	return kalert_handle_set_parameter(kalert_fd_handle(fd), attr_mask,
+					   attr);
+}
+
+int kalert_handle_set_portid(struct kalert_handle *h, uint32_t portid)
 {
 	uint64_t attr[KALERT_ATTR_MAX];
 
 	attr[KALERT_PORTID] = portid;
-	return kalert_set_parameter(fd, KALERT_MASK(KALERT_PORTID), attr);
+	return kalert_handle_set_parameter(h, KALERT_MASK(KALERT_PORTID), attr);
 }
 
-int kalert_set_filter_level(int fd, uint32_t filter_level)
+int kalert_set_portid(int fd, uint32_t portid)
 {
-	uint64_t attr[KALERT_ATTR_MAX];
+	return kalert_handle_set_portid(kalert_fd_handle(fd), portid);
+}
 
-	if (filter_level >= KALERT_LEVEL_MAX) {
-		kalert_msg(LOG_WARNING,
-			   "Try to set an invalid filter level: %d",
-			   filter_level);
-		return -EINVAL;
-	}
+int kalert_handle_set_filter_level(struct kalert_handle *h,
+				   uint32_t filter_level)
+{
+	uint64_t attr[KALERT_ATTR_MAX];
 
 	attr[KALERT_FILTER_LEVEL] = filter_level;
-	return kalert_set_parameter(fd, KALERT_MASK(KALERT_FILTER_LEVEL), attr);
+	return kalert_handle_set_parameter(h, KALERT_MASK(KALERT_FILTER_LEVEL),
+					   attr);
+}
+
+int kalert_set_filter_level(int fd, uint32_t filter_level)
+{
+	return kalert_handle_set_filter_level(kalert_fd_handle(fd),
+					      filter_level);
+}
+
+int kalert_handle_set_enable(struct kalert_handle *h, uint32_t enable)
+{
+	uint64_t attr[KALERT_ATTR_MAX];
+
+	attr[KALERT_ENABLE] = enable;
+	return kalert_handle_set_parameter(h, KALERT_MASK(KALERT_ENABLE), attr);
 }
 
 int kalert_set_enable(int fd, uint32_t enable)
 {
+	return kalert_handle_set_enable(kalert_fd_handle(fd), enable);
+}
+
+/**
+ * kalert_handle_setup_channel - (re)register a handle as the channel receiver
+ * @h: kalert handle
+ *
+ * Enable the framework and register @h's port as the receiver of kalert
+ * notifications, with the default filter level KALERT_WARN. Safe to run
+ * again on a live handle, e.g. when the channel looks stalled; settings
+ * applied on top of the defaults have to be applied again afterwards.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int kalert_handle_setup_channel(struct kalert_handle *h)
+{
+	struct kalert_batch batch;
 	uint64_t attr[KALERT_ATTR_MAX];
+	int rc;
 
-	if (enable != 0 && enable != 1)
-		return -EINVAL;
+	if (!h)
+		return -EBADF;
 
-	attr[KALERT_ENABLE] = enable;
-	return kalert_set_parameter(fd, KALERT_MASK(KALERT_ENABLE), attr);
+	attr[KALERT_ENABLE] = 1;
+	attr[KALERT_PORTID] = h->portid;
+	attr[KALERT_FILTER_LEVEL] = KALERT_WARN;
+
+	kalert_batch_init(&batch);
+	kalert_batch_add_parameter(&batch,
+				   KALERT_MASK(KALERT_ENABLE) |
+					   KALERT_MASK(KALERT_PORTID) |
+					   KALERT_MASK(KALERT_FILTER_LEVEL),
+				   attr);
+	rc = kalert_handle_batch_commit(h, &batch);
+	if (rc < 0)
+		kalert_msg(LOG_WARNING,
+			   "Error to start and set kalert channel(%s)",
+			   strerror(-rc));
+	return rc;
+}
+
+/**
+ * kalert_handle_start_channel - Open and initialize a kalert netlink channel
+ *
+ * Handle based variant of kalert_start_channel().
+ *
+ * Return: the new handle, or NULL on failure (errno is set).
+ */
+struct kalert_handle *kalert_handle_start_channel(void)
+{
+	struct kalert_handle *h;
+	int rc;
+
+	h = kalert_handle_open();
+	if (!h) {
+		fprintf(stderr, "Cannot open netlink kalert socket\n");
+		return NULL;
+	}
+
+	rc = kalert_handle_setup_channel(h);
+	if (rc < 0) {
+		kalert_handle_close(h);
+		errno = -rc;
+		return NULL;
+	}
+	return h;
 }
 
 /**
@@ -135,7 +181,6 @@ int kalert_set_enable(int fd, uint32_t enable)
  */
 int kalert_start_channel(void)
 {
-	uint64_t attr[KALERT_ATTR_MAX];
 	int sock_fd;
 	int rc;
 
@@ -144,39 +189,28 @@ int kalert_start_channel(void)
 		return -EBADF;
 	}
 
-	attr[KALERT_ENABLE] = 1;
-	attr[KALERT_PORTID] = getpid();
-	attr[KALERT_FILTER_LEVEL] = KALERT_WARN;
-	rc = kalert_set_parameter(sock_fd,
-				  KALERT_MASK(KALERT_ENABLE) |
-					  KALERT_MASK(KALERT_PORTID) |
-					  KALERT_MASK(KALERT_FILTER_LEVEL),
-				  attr);
+	rc = kalert_handle_setup_channel(kalert_fd_handle(sock_fd));
 	if (rc < 0) {
-		kalert_msg(LOG_WARNING,
-			   "Error to start and set kalert channel(%s)",
-			   strerror(-rc));
+		kalert_close(sock_fd);
 		return rc;
 	}
 	return sock_fd;
 }
 
-int kalert_subscribe_type(int fd, uint64_t type_mask, uint32_t level)
+int kalert_handle_subscribe_type(struct kalert_handle *h, uint64_t type_mask,
+				 uint32_t level)
 {
-	struct kalert_message req;
 	int rc;
 
-	if (!TYPE_MASK_VALID(type_mask) || level >= KALERT_LEVEL_MAX)
-		return -EINVAL;
-
-	memset(&req, 0, sizeof(req));
-	req.nlh.nlmsg_len = NLMSG_LENGTH(0);
-	req.nlh.nlmsg_type = KALERT_CMD_SUBSCRIBE;
+	if (!h)
+		return -EBADF;
 
-	mnl_attr_put_u64(&req.nlh, KALERT_SUB_TYPE_MASK, type_mask);
-	mnl_attr_put_u32(&req.nlh, KALERT_SUB_LEVEL, level);
+	rc = kalert_build_subscribe_type(h->req.buf, sizeof(h->req), type_mask,
+					 level);
+	if (rc < 0)
+		return rc;
 
-	rc = kalert_send_request(fd, &req);
+	rc = kalert_send_nlmsg(h, &h->req.nlh);
 	if (rc < 0) {
 		kalert_msg(LOG_WARNING, "Error sending subscribe request (%s)",
 			   strerror(-rc));
@@ -185,34 +219,212 @@ int kalert_subscribe_type(int fd, uint64_t type_mask, uint32_t level)
 	return rc;
 }
 
+int kalert_subscribe_type(int fd, uint64_t type_mask, uint32_t level)
+{
+	return kalert_handle_subscribe_type(kalert_fd_handle(fd), type_mask,
+					    level);
+}
+
+int __kalert_handle_subscribe_event(struct kalert_handle *h,
+				    const int *event_ids, size_t count,
+				    uint32_t level)
+{
+	int rc;
+
+	if (!h)
+		return -EBADF;
+
+	rc = kalert_build_subscribe_event(h->req.buf, sizeof(h->req), event_ids,
+					  count, level);
+	if (rc < 0)
+		return rc;
+
+	rc = kalert_send_nlmsg(h, &h->req.nlh);
+	if (rc < 0) {
+		kalert_msg(LOG_WARNING,
+			   "Error sending event subscribe request (%d: %s)",
+			   -rc, strerror(-rc));
+	}
+
+	return rc;
+}
+
 int __kalert_subscribe_event(int fd, const int *event_ids, size_t count,
 			     uint32_t level)
 {
-	struct kalert_message req;
-	unsigned long event_mask[BITS_TO_LONGS(KALERT_EVENT_MAX)];
+	return __kalert_handle_subscribe_event(kalert_fd_handle(fd), event_ids,
+					       count, level);
+}
+
+void kalert_batch_init(struct kalert_batch *batch)
+{
+	batch->count = 0;
+	batch->used = 0;
+}
+
+/* Room for one more request, NULL if the batch is full */
+static struct nlmsghdr *batch_reserve(struct kalert_batch *batch,
+				      size_t *room)
+{
+	if (batch->count == KALERT_BATCH_MAX)
+		return NULL;
+
+	*room = sizeof(batch->buf) - batch->used;
+	return (struct nlmsghdr *)(batch->buf + batch->used);
+}
+
+static int batch_queue(struct kalert_batch *batch, struct nlmsghdr *nlh)
+{
+	batch->offset[batch->count] = batch->used;
+	batch->err[batch->count] = 0;
+	batch->used += NLMSG_ALIGN(nlh->nlmsg_len);
+	return batch->count++;
+}
+
+/**
+ * kalert_batch_add_parameter - queue a SET_CHNL request
+ * @batch:     batch initialized with kalert_batch_init()
+ * @attr_mask: attributes to set, as for kalert_set_parameter()
+ * @attr:      attribute values indexed by attribute type
+ *
+ * Return: index of the request in the batch, or a negative error code.
+ */
+int kalert_batch_add_parameter(struct kalert_batch *batch, uint32_t attr_mask,
+			       const uint64_t *attr)
+{
+	struct nlmsghdr *nlh;
+	size_t room;
+	int rc;
+
+	nlh = batch_reserve(batch, &room);
+	if (!nlh)
+		return -ENOSPC;
+
+	rc = kalert_build_set_chnl(nlh, room, attr_mask, attr);
+	if (rc < 0)
+		return rc;
+
+	return batch_queue(batch, nlh);
+}
+
+/**
+ * kalert_batch_add_subscribe_type - queue a SUBSCRIBE request by type mask
+ *
+ * Return: index of the request in the batch, or a negative error code.
+ */
+int kalert_batch_add_subscribe_type(struct kalert_batch *batch,
+				    uint64_t type_mask, uint32_t level)
+{
+	struct nlmsghdr *nlh;
+	size_t room;
+	int rc;
+
+	nlh = batch_reserve(batch, &room);
+	if (!nlh)
+		return -ENOSPC;
+
+	rc = kalert_build_subscribe_type(nlh, room, type_mask, level);
+	if (rc < 0)
+		return rc;
+
+	return batch_queue(batch, nlh);
+}
+
+/**
+ * kalert_batch_add_subscribe_event - queue a SUBSCRIBE request by event ids
+ *
+ * Return: index of the request in the batch, or a negative error code.
+ */
+int kalert_batch_add_subscribe_event(struct kalert_batch *batch,
+				     const int *event_ids, size_t count,
+				     uint32_t level)
+{
+	struct nlmsghdr *nlh;
+	size_t room;
 	int rc;
 
-	if (!event_ids || count == 0)
-		return -EINVAL;
+	nlh = batch_reserve(batch, &room);
+	if (!nlh)
+		return -ENOSPC;
 
-	rc = events_to_bitmap(event_ids, count, event_mask, KALERT_EVENT_MAX);
+	rc = kalert_build_subscribe_event(nlh, room, event_ids, count, level);
 	if (rc < 0)
 		return rc;
 
-	memset(&req, 0, sizeof(req));
-	req.nlh.nlmsg_len = NLMSG_LENGTH(0);
-	req.nlh.nlmsg_type = KALERT_CMD_SUBSCRIBE;
+	return batch_queue(batch, nlh);
+}
+
+/**
+ * kalert_handle_batch_commit - send all queued requests and collect their ACKs
+ * @h:     kalert handle
+ * @batch: requests queued with kalert_batch_add_*()
+ *
+ * On return batch->err[i] holds the ACK status of the i-th request. The
+ * batch is left intact so it can be inspected; call kalert_batch_init()
+ * before reusing it.
+ *
+ * Return:
+ *   0 if every request was acknowledged successfully,
+ *   otherwise the first error found.
+ */
+int kalert_handle_batch_commit(struct kalert_handle *h,
+			       struct kalert_batch *batch)
+{
+	struct nlmsghdr *reqs[KALERT_BATCH_MAX];
+	unsigned int i;
+	int rc;
+
+	if (!h)
+		return -EBADF;
+
+	if (batch->count == 0)
+		return 0;
 
-	mnl_attr_put_u32(&req.nlh, KALERT_SUB_LEVEL, level);
-	mnl_attr_put(&req.nlh, KALERT_SUB_EVENT_MASK, sizeof(event_mask),
-		     event_mask);
+	for (i = 0; i < batch->count; i++)
+		reqs[i] = (struct nlmsghdr *)(batch->buf + batch->offset[i]);
 
-	rc = kalert_send_request(fd, &req);
+	rc = kalert_send_request_batch(h, reqs, batch->err, batch->count);
 	if (rc < 0) {
-		kalert_msg(LOG_WARNING,
-			   "Error sending event subscribe request (%d: %s)",
-			   -rc, strerror(-rc));
+		for (i = 0; i < batch->count; i++) {
+			if (batch->err[i] < 0)
+				kalert_msg(LOG_WARNING,
+					   "kalert batch request %u failed (%s)",
+					   i, strerror(-batch->err[i]));
+		}
 	}
 
 	return rc;
 }
+
+int kalert_batch_commit(int fd, struct kalert_batch *batch)
+{
+	return kalert_handle_batch_commit(kalert_fd_handle(fd), batch);
+}
+
+/**
+ * kalert_mkdir_parent - create the directory @path lives in
+ * @path: file or socket path
+ * @mode: mode of the directory if it is created
+ *
+ * Only the last directory is created; one that exists already is fine.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int kalert_mkdir_parent(const char *path, unsigned int mode)
+{
+	char dir[PATH_MAX];
+	char *slash;
+
+	if (strlen(path) >= sizeof(dir))
+		return -ENAMETOOLONG;
+	strcpy(dir, path);
+
+	slash = strrchr(dir, '/');
+	if (!slash || slash == dir)
+		return 0;
+	*slash = '\0';
+
+	if (mkdir(dir, mode) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
@@ -8,30 +8,60 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "libkalert/libkalert.h"
 #include "private.h"
 
-/* Single thread only */
-static uint32_t next_seq(void)
+/* Safe to call from any thread, each handle counts on its own */
+static uint32_t next_seq(struct kalert_handle *h)
 {
-	static uint32_t seq = 0;
-	return ++seq;
+	return __atomic_add_fetch(&h->seq, 1, __ATOMIC_RELAXED);
 }
 
 /*
- * This function opens a connection to the kernel's kalert
- * module. On error, a negative value is returned. On success,
- * the file descriptor is returned - which can be 0 or higher.
+ * Bind to this process's PID when it is free, so kalert_start_channel()
+ * can register it as the notification port. Further handles of the same
+ * process fall back to a kernel-assigned port id.
  */
-int kalert_open(void)
+static int kalert_bind(int fd, uint32_t *portid)
 {
 	struct sockaddr_nl local_addr;
+	socklen_t addrlen = sizeof(local_addr);
+
+	memset(&local_addr, 0, sizeof(local_addr));
+	local_addr.nl_family = AF_NETLINK;
+	local_addr.nl_pid = getpid(); // Bind to this process's PID
+
+	if (bind(fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
+		if (errno != EADDRINUSE)
+			return -errno;
+
+		local_addr.nl_pid = 0;
+		if (bind(fd, (struct sockaddr *)&local_addr,
+			 sizeof(local_addr)) < 0)
+			return -errno;
+	}
+
+	if (getsockname(fd, (struct sockaddr *)&local_addr, &addrlen) < 0)
+		return -errno;
+
+	*portid = local_addr.nl_pid;
+	return 0;
+}
+
+/* ---------------------- Netlink transport ----------------------- */
+static int netlink_open(struct kalert_handle *h, const void *arg)
+{
+	int rc;
+
+	(void)arg;
 
-	int fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KALERT);
-	if (fd < 0) {
+	h->fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KALERT);
+	if (h->fd < 0) {
 		if (errno == EINVAL || errno == EPROTONOSUPPORT ||
 		    errno == EAFNOSUPPORT)
 			kalert_msg(LOG_ERR, "Kalert not support in kernel");
@@ -39,73 +69,217 @@ int kalert_open(void)
 			kalert_msg(LOG_ERR,
 				   "Opening kalert netlink socket (%s)",
 				   strerror(errno));
+		return -errno;
 	}
 
-	memset(&local_addr, 0, sizeof(local_addr));
-	local_addr.nl_family = AF_NETLINK;
-	local_addr.nl_pid = getpid(); // Bind to this process's PID
+	rc = kalert_bind(h->fd, &h->portid);
+	if (rc < 0) {
+		kalert_msg(LOG_ERR, "Binding kalert netlink socket (%s)",
+			   strerror(-rc));
+		close(h->fd);
+		return rc;
+	}
 
-	if (bind(fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
-		perror("bind");
-		close(fd);
+	return 0;
+}
+
+static int netlink_send(struct kalert_handle *h, struct mmsghdr *msgs,
+			unsigned int vlen)
+{
+	int rc = sendmmsg(h->fd, msgs, vlen, 0);
+
+	return rc < 0 ? -errno : rc;
+}
+
+static int netlink_recv(struct kalert_handle *h, struct mmsghdr *msgs,
+			unsigned int vlen, int flags)
+{
+	int rc = recvmmsg(h->fd, msgs, vlen, flags, NULL);
+
+	return rc < 0 ? -errno : rc;
+}
+
+static void netlink_close(struct kalert_handle *h)
+{
+	close(h->fd);
+}
+
+const struct kalert_transport kalert_netlink_transport = {
+	.name = "netlink",
+	.open = netlink_open,
+	.send = netlink_send,
+	.recv = netlink_recv,
+	.close = netlink_close,
+};
+
+/* Open a handle on top of @ops, NULL on error (errno is set) */
+struct kalert_handle *kalert_handle_open_transport(
+	const struct kalert_transport *ops, const void *arg)
+{
+	struct kalert_handle *h;
+	int rc;
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+
+	h->ops = ops;
+	rc = ops->open(h, arg);
+	if (rc < 0) {
+		free(h);
+		errno = -rc;
+		return NULL;
+	}
+
+	/*
+	 * Receive times come from the socket. Transports whose fd is not
+	 * one fill the SCM_TIMESTAMPNS themselves, see kalert_rx_ts_put().
+	 */
+	setsockopt(h->fd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+		   sizeof(int));
+	return h;
+}
+
+/**
+ * kalert_handle_open - open a connection to the kernel's kalert module
+ *
+ * The handle owns the netlink socket, its sequence counter, preallocated
+ * send and receive buffers and the queue of notifications parked during
+ * ACK waits. Different threads may drive different handles concurrently
+ * without any locking; a single handle must not be used by two threads
+ * at the same time.
+ *
+ * Return: new handle, or NULL on error (errno is set).
+ */
+struct kalert_handle *kalert_handle_open(void)
+{
+	return kalert_handle_open_transport(&kalert_netlink_transport, NULL);
+}
+
+void kalert_handle_close(struct kalert_handle *h)
+{
+	if (!h)
+		return;
+
+	h->ops->close(h);
+	kalert_dispatch_free(h);
+	free(h);
+}
+
+int kalert_handle_fd(const struct kalert_handle *h)
+{
+	return h ? h->fd : -EBADF;
+}
+
+uint32_t kalert_handle_portid(const struct kalert_handle *h)
+{
+	return h ? h->portid : 0;
+}
+
+/*
+ * This function opens a connection to the kernel's kalert
+ * module. On error, a negative value is returned. On success,
+ * the file descriptor is returned - which can be 0 or higher.
+ */
+int kalert_open(void)
+{
+	struct kalert_handle *h = kalert_handle_open();
+
+	if (!h)
+		return -1;
+
+	if (kalert_fd_register(h) < 0) {
+		kalert_msg(LOG_ERR, "Too many open kalert sockets");
+		kalert_handle_close(h);
 		return -1;
 	}
 
-	return fd;
+	return h->fd;
 }
 
 void kalert_close(int fd)
 {
-	if (fd >= 0)
-		close(fd);
+	kalert_handle_close(kalert_fd_unregister(fd));
+}
+
+/*
+ * The socket receive queue overflowed and the kernel dropped messages
+ * for us. ENOBUFS is reported only once per overflow, so count it where
+ * it is seen and let the caller resync from the loss counters.
+ */
+static void kalert_note_overrun(struct kalert_handle *h)
+{
+	h->overruns++;
+	kalert_msg(LOG_WARNING,
+		   "kalert socket receive buffer overrun, notifications lost");
+}
+
+/*
+ * An overrun seen where it could not be returned, while waiting for an
+ * ACK or behind parked messages, is returned by the next receive call.
+ * It is counted already.
+ */
+static bool kalert_take_overrun(struct kalert_handle *h)
+{
+	if (!h->overrun_unreported)
+		return false;
+	h->overrun_unreported = false;
+	errno = ENOBUFS;
+	return true;
 }
 
 /**
- * kalert_get_reply - receive a netlink reply message from the kernel
- * @fd:    file descriptor of an open netlink socket
- * @rep:   output parameter, pointer to a user-allocated kalert_message buffer
- * @block: whether to wait for data (e.g., REPLY_BLOCK / REPLY_NONBLOCK)
- * @peek:  whether to only peek at the message without removing it (non-zero = MSG_PEEK)
+ * kalert_handle_set_rcvbuf - size the socket receive buffer
+ * @h:     kalert handle
+ * @bytes: requested size
  *
- * Return:
- *   >0  : number of bytes received
- *   =0  : no data available (possible in non-blocking mode)
- *   <0  : error occurred (errno will be set accordingly)
+ * SO_RCVBUFFORCE is tried first so privileged daemons can go beyond
+ * net.core.rmem_max; without CAP_NET_ADMIN this falls back to SO_RCVBUF,
+ * which the kernel caps at rmem_max.
+ *
+ * Return: the effective buffer size reported by the kernel, or a
+ * negative error code.
  */
-int kalert_get_reply(int fd, struct kalert_message *rep, reply_t block,
-		     int peek)
+int kalert_handle_set_rcvbuf(struct kalert_handle *h, int bytes)
 {
-	int len;
-	struct sockaddr_nl nladdr;
-	socklen_t nladdrlen = sizeof(nladdr);
+	socklen_t len = sizeof(bytes);
 
-	if (fd < 0)
+	if (!h)
 		return -EBADF;
+	if (bytes <= 0)
+		return -EINVAL;
 
-	if (block == GET_REPLY_NONBLOCKING)
-		peek |= MSG_DONTWAIT;
-
-retry:
-	len = recvfrom(fd, rep, sizeof(*rep), peek, (struct sockaddr *)&nladdr,
-		       &nladdrlen);
+	if (setsockopt(h->fd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes,
+		       sizeof(bytes)) < 0 &&
+	    setsockopt(h->fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) < 0)
+		return -errno;
 
-	if (len < 0) {
-		if (errno == EINTR)
-			goto retry;
-		if (errno != EAGAIN)
-			kalert_msg(LOG_ERR,
-				   "Error receiving kalert netlink packet (%s)",
-				   strerror(errno));
+	if (getsockopt(h->fd, SOL_SOCKET, SO_RCVBUF, &bytes, &len) < 0)
 		return -errno;
-	}
 
-	if (nladdrlen != sizeof(nladdr)) {
+	return bytes;
+}
+
+int kalert_set_rcvbuf(int fd, int bytes)
+{
+	return kalert_handle_set_rcvbuf(kalert_fd_handle(fd), bytes);
+}
+
+/*
+ * Validate one datagram received from the kalert socket: it must come from
+ * the kernel (nl_pid 0) and hold a well-formed netlink message.
+ */
+static int kalert_check_reply(const struct sockaddr_nl *nladdr,
+			      socklen_t nladdrlen, struct kalert_message *rep,
+			      int len)
+{
+	if (nladdrlen != sizeof(*nladdr)) {
 		kalert_msg(LOG_ERR,
 			   "Bad address size reading kalert netlink socket");
 		return -EPROTO;
 	}
 
-	if (nladdr.nl_pid) {
+	if (nladdr->nl_pid) {
 		kalert_msg(LOG_ERR,
 			   "Spoofed packet received on kalert netlink socket");
 		return -EINVAL;
@@ -115,42 +289,331 @@ retry:
 		if (len == sizeof(*rep)) {
 			kalert_msg(LOG_ERR,
 				   "Netlink event from kernel is too big");
-			errno = EFBIG;
-		} else {
-			kalert_msg(LOG_ERR,
-				   "Netlink message from kernel was not OK");
-			errno = EBADE;
+			return -EFBIG;
 		}
-		return -errno;
+		kalert_msg(LOG_ERR, "Netlink message from kernel was not OK");
+		return -EBADE;
 	}
 
 	return len;
 }
 
+static uint64_t realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * kalert_rx_ts - receipt time of a datagram
+ * @mh: header filled by a transport's recv op
+ *
+ * Return: CLOCK_REALTIME in ns from the SCM_TIMESTAMPNS of @mh, 0 if it
+ * has none.
+ */
+uint64_t kalert_rx_ts(const struct msghdr *mh)
+{
+	struct cmsghdr *cmsg;
+	struct timespec ts;
+
+	for (cmsg = CMSG_FIRSTHDR(mh); cmsg;
+	     cmsg = CMSG_NXTHDR((struct msghdr *)mh, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_TIMESTAMPNS ||
+		    cmsg->cmsg_len < CMSG_LEN(sizeof(ts)))
+			continue;
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+		return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+	return 0;
+}
+
+/* For transports that do not receive from a socket, 0 leaves none */
+void kalert_rx_ts_put(struct msghdr *mh, uint64_t ts_ns)
+{
+	struct cmsghdr *cmsg;
+	struct timespec ts = {
+		.tv_sec = ts_ns / 1000000000,
+		.tv_nsec = ts_ns % 1000000000,
+	};
+
+	if (!ts_ns || !mh->msg_control ||
+	    mh->msg_controllen < CMSG_SPACE(sizeof(ts))) {
+		mh->msg_controllen = 0;
+		return;
+	}
+
+	cmsg = mh->msg_control;
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TIMESTAMPNS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(ts));
+	memcpy(CMSG_DATA(cmsg), &ts, sizeof(ts));
+	mh->msg_controllen = CMSG_SPACE(sizeof(ts));
+}
+
+/* Receive one datagram straight from the transport, bypassing the queue */
+static int kalert_recv(struct kalert_handle *h, struct kalert_message *rep,
+		       int flags)
+{
+	struct sockaddr_nl nladdr;
+	struct iovec iov = { .iov_base = rep, .iov_len = sizeof(*rep) };
+	char ctrl[KALERT_RX_CTRL_SIZE] __attribute__((aligned(8)));
+	struct mmsghdr msg = {
+		.msg_hdr = {
+			.msg_name = &nladdr,
+			.msg_namelen = sizeof(nladdr),
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = ctrl,
+			.msg_controllen = sizeof(ctrl),
+		},
+	};
+	int rc;
+
+	do {
+		rc = h->ops->recv(h, &msg, 1, flags);
+	} while (rc == -EINTR);
+
+	if (rc < 0) {
+		if (rc == -ENOBUFS)
+			kalert_note_overrun(h);
+		else if (rc != -EAGAIN)
+			kalert_msg(LOG_ERR,
+				   "Error receiving kalert netlink packet (%s)",
+				   strerror(-rc));
+		errno = -rc;
+		return rc;
+	}
+
+	h->rx_ts_ns = kalert_rx_ts(&msg.msg_hdr) ?: realtime_ns();
+	rc = kalert_check_reply(&nladdr, msg.msg_hdr.msg_namelen, rep,
+				msg.msg_len);
+	if (rc < 0)
+		errno = -rc;
+	return rc;
+}
+
+/**
+ * kalert_handle_get_reply - receive a netlink reply message from the kernel
+ * @h:     kalert handle
+ * @rep:   output parameter, pointer to a user-allocated kalert_message buffer
+ * @block: whether to wait for data (e.g., REPLY_BLOCK / REPLY_NONBLOCK)
+ * @peek:  whether to only peek at the message without removing it (non-zero = MSG_PEEK)
+ *
+ * Notifications parked while an earlier request waited for its ACK are
+ * returned first, in arrival order. A receive buffer overrun seen while
+ * waiting for that ACK is returned as -ENOBUFS once they are all read.
+ *
+ * Return:
+ *   >0  : number of bytes received
+ *   =0  : no data available (possible in non-blocking mode)
+ *   <0  : error occurred (errno will be set accordingly)
+ */
+int kalert_handle_get_reply(struct kalert_handle *h, struct kalert_message *rep,
+			    reply_t block, int peek)
+{
+	int len;
+
+	if (!h)
+		return -EBADF;
+
+	len = kalert_pending_pop(h, rep, sizeof(*rep), peek & MSG_PEEK,
+				 &h->rx_ts_ns);
+	if (len > 0)
+		return len;
+
+	if (!(peek & MSG_PEEK) && kalert_take_overrun(h))
+		return -ENOBUFS;
+
+	if (block == GET_REPLY_NONBLOCKING)
+		peek |= MSG_DONTWAIT;
+
+	return kalert_recv(h, rep, peek);
+}
+
+int kalert_get_reply(int fd, struct kalert_message *rep, reply_t block,
+		     int peek)
+{
+	return kalert_handle_get_reply(kalert_fd_handle(fd), rep, block, peek);
+}
+
+/**
+ * kalert_handle_get_reply_batch - receive several netlink messages with one syscall
+ * @h:      kalert handle
+ * @slots:  array of caller-owned slots, reused across calls
+ * @nslots: number of entries in @slots (at most KALERT_REPLY_BATCH_MAX
+ *          are filled per call)
+ * @block:  GET_REPLY_BLOCKING waits for the first message only, then
+ *          returns whatever else is already queued
+ *
+ * Parked notifications fill the first slots, as in kalert_get_reply().
+ * Every received slot gets the same checks as kalert_get_reply(). A slot
+ * that fails them has its len set to the negative error code, so one bad
+ * datagram does not hide the rest of the batch. Each slot carries the
+ * socket's receive time of its datagram, or the time of the call if the
+ * transport has none.
+ *
+ * A receive buffer overrun is returned as -ENOBUFS, by the next call when
+ * parked notifications were already filled in or when it happened while
+ * waiting for an ACK.
+ *
+ * Return:
+ *   >0  : number of slots filled
+ *   <0  : error occurred (-EAGAIN when nothing is queued in non-blocking
+ *         mode)
+ */
+int kalert_handle_get_reply_batch(struct kalert_handle *h,
+				  struct kalert_reply_slot *slots,
+				  unsigned int nslots, reply_t block)
+{
+	struct mmsghdr msgs[KALERT_REPLY_BATCH_MAX];
+	struct iovec iov[KALERT_REPLY_BATCH_MAX];
+	struct sockaddr_nl addrs[KALERT_REPLY_BATCH_MAX];
+	char ctrl[KALERT_REPLY_BATCH_MAX][KALERT_RX_CTRL_SIZE]
+		__attribute__((aligned(8)));
+	uint64_t now_ns = 0;
+	int queued = 0;
+	int flags;
+	int n, i;
+
+	if (!h)
+		return -EBADF;
+
+	if (!slots || nslots == 0)
+		return -EINVAL;
+
+	if (nslots > KALERT_REPLY_BATCH_MAX)
+		nslots = KALERT_REPLY_BATCH_MAX;
+
+	while (queued < (int)nslots) {
+		n = kalert_pending_pop(h, &slots[queued].msg,
+				       sizeof(slots[queued].msg), false,
+				       &slots[queued].ts_ns);
+		if (n <= 0)
+			break;
+		slots[queued++].len = n;
+	}
+	if (queued == (int)nslots)
+		return queued;
+	if (!queued && kalert_take_overrun(h))
+		return -ENOBUFS;
+	slots += queued;
+	nslots -= queued;
+
+	flags = block == GET_REPLY_NONBLOCKING || queued ? MSG_DONTWAIT :
+							   MSG_WAITFORONE;
+
+	memset(msgs, 0, nslots * sizeof(msgs[0]));
+	for (i = 0; i < (int)nslots; i++) {
+		iov[i].iov_base = &slots[i].msg;
+		iov[i].iov_len = sizeof(slots[i].msg);
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = ctrl[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+	}
+
+	do {
+		n = h->ops->recv(h, msgs, nslots, flags);
+	} while (n == -EINTR);
+
+	if (n < 0) {
+		if (n == -ENOBUFS) {
+			kalert_note_overrun(h);
+			h->overrun_unreported = queued > 0;
+		}
+		if (queued)
+			return queued;
+		if (n != -EAGAIN && n != -ENOBUFS)
+			kalert_msg(LOG_ERR,
+				   "Error receiving kalert netlink packet (%s)",
+				   strerror(-n));
+		return n;
+	}
+
+	for (i = 0; i < n; i++) {
+		slots[i].len = kalert_check_reply(&addrs[i],
+						  msgs[i].msg_hdr.msg_namelen,
+						  &slots[i].msg,
+						  msgs[i].msg_len);
+		slots[i].ts_ns = kalert_rx_ts(&msgs[i].msg_hdr);
+		if (!slots[i].ts_ns) {
+			/* one clock read for the batch, it arrived as one */
+			if (!now_ns)
+				now_ns = realtime_ns();
+			slots[i].ts_ns = now_ns;
+		}
+	}
+
+	return queued + n;
+}
+
+int kalert_get_reply_batch(int fd, struct kalert_reply_slot *slots,
+			   unsigned int nslots, reply_t block)
+{
+	return kalert_handle_get_reply_batch(kalert_fd_handle(fd), slots,
+					     nslots, block);
+}
+
+static long long monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
 /**
- * check_ack - Wait for ACK/error reply matching a given seq
- * @fd:        netlink socket fd
- * @seq:       sequence number of the request we wait for
+ * check_acks - Wait for the ACK/error replies of a set of requests
+ * @h:         kalert handle
+ * @seqs:      sequence numbers of the requests we wait for
+ * @errs:      output, ACK status of each request (0 or -errno)
+ * @count:     number of requests
+ * @cb:        optional, called for non-ACK replies to these requests
+ * @data:      passed to @cb
+ *
+ * Each message is read exactly once, into the handle's receive buffer.
+ * Messages with another seq (async notifications, late replies) are
+ * parked in the handle's pending queue so the next kalert_get_reply*()
+ * call returns them instead of losing them. A receive buffer overrun does
+ * not end the wait, it is left for the next kalert_get_reply*() call to
+ * report. Requests left without an ACK get -ETIMEDOUT.
  *
  * Returns:
- *   0 on success (ACK received)
+ *   0 on success (all ACKs received)
  *   -ETIMEDOUT if timeout
  *   -errno on other failures
  */
-static int check_ack(int fd, int seq)
+static int check_acks(struct kalert_handle *h, const uint32_t *seqs,
+		      int *errs, unsigned int count, kalert_reply_cb_t cb,
+		      void *data)
 {
-	struct kalert_message rep;
+	struct kalert_message *rep = &h->rep;
 	int timeout_ms = 3000; // wait 3s a time
 	int retries = 5; // retry 5 times
+	long long deadline = monotonic_ms() + (long long)timeout_ms * retries;
+	unsigned int waiting = count;
+	unsigned int i;
+	int rc = 0;
 	struct pollfd pfd = {
-		.fd = fd,
+		.fd = h->fd,
 		.events = POLLIN,
 	};
 
-	while (retries--) {
-		int rc;
+	for (i = 0; i < count; i++)
+		errs[i] = -ETIMEDOUT;
+
+	while (waiting) {
+		long long left = deadline - monotonic_ms();
 
-		rc = poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms);
+		if (left <= 0)
+			return -ETIMEDOUT;
+
+		rc = poll(&pfd, 1, left < timeout_ms ? (int)left : timeout_ms);
 		if (rc == 0)
 			return -ETIMEDOUT;
 		if (rc < 0) {
@@ -159,85 +622,210 @@ static int check_ack(int fd, int seq)
 			return -errno;
 		}
 
-		/* Peek the next message */
-		rc = kalert_get_reply(fd, &rep, GET_REPLY_NONBLOCKING,
-				      MSG_PEEK);
+		rc = kalert_recv(h, rep, MSG_DONTWAIT);
+		if (rc == -ENOBUFS) {
+			/* our ACK may still come, the loss is reported later */
+			h->overrun_unreported = true;
+			continue;
+		}
 		if (rc < 0) {
 			if (rc == -EAGAIN)
 				continue;
 			return rc;
 		}
 
-		/* Skip unrelated seq (async notifications, other replies) */
-		if (rep.nlh.nlmsg_seq != (unsigned int)seq) {
-			/* consume and discard */
-			(void)kalert_get_reply(fd, &rep, GET_REPLY_NONBLOCKING,
-					       0);
+		for (i = 0; i < count; i++) {
+			if (rep->nlh.nlmsg_seq == seqs[i])
+				break;
+		}
+
+		/* Keep unrelated messages for the next receive call */
+		if (i == count) {
+			kalert_pending_push(h, rep, rc, h->rx_ts_ns);
 			continue;
 		}
 
-		/* It's our ACK/error reply */
-		if (rep.nlh.nlmsg_type == NLMSG_ERROR) {
-			struct nlmsgerr *err_msg = NLMSG_DATA(&rep.nlh);
-			int error = err_msg->error;
-			/* consume */
-			(void)kalert_get_reply(fd, &rep, GET_REPLY_NONBLOCKING,
-					       0);
-			return error;
+		/* It's one of our ACK/error replies */
+		if (rep->nlh.nlmsg_type == NLMSG_ERROR &&
+		    errs[i] == -ETIMEDOUT) {
+			struct nlmsgerr *err_msg = NLMSG_DATA(&rep->nlh);
+			errs[i] = err_msg->error;
+			waiting--;
 		}
 
-		/* consume and ignore other messages */
-		(void)kalert_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
+		/* hand other replies to these requests to the caller */
+		if (rep->nlh.nlmsg_type != NLMSG_ERROR && cb)
+			cb(&rep->nlh, data);
 	}
 
-	/* should never reach here */
-	return -EIO;
+	for (i = 0; i < count; i++) {
+		if (errs[i] < 0)
+			return errs[i];
+	}
+	return 0;
 }
 
-static int kalert_send(int fd, struct kalert_message *req, int *seq)
+static const struct sockaddr_nl kernel_addr = { .nl_family = AF_NETLINK };
+
+/* Transmit @vlen messages, retrying on EINTR and short sends */
+static int kalert_xmit(struct kalert_handle *h, struct mmsghdr *msgs,
+		       unsigned int vlen)
 {
-	int retval;
-	static const struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+	unsigned int sent = 0;
+	int rc;
 
-	*seq = next_seq();
-	req->nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req->nlh.nlmsg_seq = *seq;
+	while (sent < vlen) {
+		rc = h->ops->send(h, msgs + sent, vlen - sent);
+		if (rc < 0) {
+			if (rc == -EINTR)
+				continue;
+			return sent ? (int)sent : rc;
+		}
+		sent += rc;
+	}
 
-	do {
-		retval = sendto(fd, req, req->nlh.nlmsg_len, 0,
-				(struct sockaddr *)&addr, sizeof(addr));
-	} while (retval < 0 && errno == EINTR);
+	return sent;
+}
 
-	if (retval < 0)
-		return -errno;
+static void kalert_prepare(struct kalert_handle *h, struct nlmsghdr *req,
+			   uint16_t flags, struct mmsghdr *msg,
+			   struct iovec *iov, uint32_t *seq)
+{
+	*seq = next_seq(h);
+	req->nlmsg_flags = flags;
+	req->nlmsg_seq = *seq;
+
+	iov->iov_base = req;
+	iov->iov_len = req->nlmsg_len;
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_hdr.msg_name = (void *)&kernel_addr;
+	msg->msg_hdr.msg_namelen = sizeof(kernel_addr);
+	msg->msg_hdr.msg_iov = iov;
+	msg->msg_hdr.msg_iovlen = 1;
+}
 
-	return retval;
+/*
+ * Send one encoded request and wait for its ACK, passing any non-ACK
+ * reply (e.g. a GET_STATUS answer) to @cb.
+ */
+int kalert_send_nlmsg_cb(struct kalert_handle *h, struct nlmsghdr *req,
+			 kalert_reply_cb_t cb, void *data)
+{
+	struct mmsghdr msg;
+	struct iovec iov;
+	uint32_t seq;
+	int err;
+	int rc;
+
+	if (!h || !req)
+		return -EINVAL;
+
+	kalert_prepare(h, req, NLM_F_REQUEST | NLM_F_ACK, &msg, &iov, &seq);
+	rc = kalert_xmit(h, &msg, 1);
+	if (rc < 0)
+		return rc;
+
+	return check_acks(h, &seq, &err, 1, cb, data);
+}
+
+int kalert_send_nlmsg(struct kalert_handle *h, struct nlmsghdr *req)
+{
+	return kalert_send_nlmsg_cb(h, req, NULL, NULL);
+}
+
+/*
+ * Send one encoded request without asking for an ACK nor waiting for the
+ * answer, which will come through the normal receive path. The kernel
+ * still reports failures with an NLMSG_ERROR. Returns the request's seq
+ * through @seq.
+ */
+int kalert_send_nlmsg_async(struct kalert_handle *h, struct nlmsghdr *req,
+			    uint32_t *seq)
+{
+	struct mmsghdr msg;
+	struct iovec iov;
+	int rc;
+
+	if (!h || !req)
+		return -EINVAL;
+
+	kalert_prepare(h, req, NLM_F_REQUEST, &msg, &iov, seq);
+	rc = kalert_xmit(h, &msg, 1);
+	return rc < 0 ? rc : 0;
 }
 
 /**
- * kalert_send_request - send a netlink request and wait for acknowledgement
- * @fd:   file descriptor of an open netlink socket
+ * kalert_handle_send_request - send a netlink request and wait for acknowledgement
+ * @h:    kalert handle
  * @req:  pointer to the kalert_message to send (caller must fill payload)
  *
  * This function wraps kalert_send(), then waits for an ACK reply
- * from the kernel using check_ack(). It ensures the request was
+ * from the kernel using check_acks(). It ensures the request was
  * delivered and acknowledged.
  *
  * Return:
  *   =0   : request acknowledged successfully
  *   <0   : error occurred (errno will be set accordingly)
  */
+int kalert_handle_send_request(struct kalert_handle *h,
+			       struct kalert_message *req)
+{
+	return kalert_send_nlmsg(h, &req->nlh);
+}
+
 int kalert_send_request(int fd, struct kalert_message *req)
 {
+	return kalert_handle_send_request(kalert_fd_handle(fd), req);
+}
+
+/**
+ * kalert_send_request_batch - send several requests, then wait for all ACKs
+ * @h:     kalert handle
+ * @reqs:  requests to send, payload filled by the caller
+ * @errs:  output, ACK status of each request (0 or -errno)
+ * @count: number of requests, at most KALERT_BATCH_MAX
+ *
+ * All requests leave with a single sendmmsg() and their ACKs are matched
+ * by sequence number in one wait, so a batch costs one round trip instead
+ * of one per request.
+ *
+ * Return:
+ *   =0   : every request acknowledged successfully
+ *   <0   : first error found (see @errs for each request)
+ */
+int kalert_send_request_batch(struct kalert_handle *h, struct nlmsghdr **reqs,
+			      int *errs, unsigned int count)
+{
+	struct mmsghdr msgs[KALERT_BATCH_MAX];
+	struct iovec iov[KALERT_BATCH_MAX];
+	uint32_t seqs[KALERT_BATCH_MAX];
+	unsigned int sent;
+	unsigned int i;
 	int rc;
-	int seq;
 
-	if (fd < 0 || !req)
+	if (!h)
+		return -EBADF;
+
+	if (!reqs || !errs || count == 0 || count > KALERT_BATCH_MAX)
 		return -EINVAL;
 
-	rc = kalert_send(fd, req, &seq);
-	if (rc == (int)req->nlh.nlmsg_len) {
-		return check_ack(fd, seq);
+	for (i = 0; i < count; i++)
+		kalert_prepare(h, reqs[i], NLM_F_REQUEST | NLM_F_ACK, &msgs[i],
+			       &iov[i], &seqs[i]);
+
+	rc = kalert_xmit(h, msgs, count);
+	if (rc < 0) {
+		for (i = 0; i < count; i++)
+			errs[i] = rc;
+		return rc;
 	}
+
+	sent = rc;
+	for (i = sent; i < count; i++)
+		errs[i] = -EIO;
+
+	rc = check_acks(h, seqs, errs, sent, NULL, NULL);
+	if (rc == 0 && sent < count)
+		rc = errs[sent];
 	return rc;
 }
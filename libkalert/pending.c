@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Per-handle queue of notifications received while a
+ * request was waiting for its ACK, and the fd -> handle map behind the
+ * fd based API
+ */
+
+#include "private.h"
+
+/* Single thread only, like the fd based API it serves */
+static struct kalert_handle *socks[KALERT_MAX_SOCKS];
+
+int kalert_fd_register(struct kalert_handle *h)
+{
+	int i;
+
+	for (i = 0; i < KALERT_MAX_SOCKS; i++) {
+		if (!socks[i]) {
+			socks[i] = h;
+			return 0;
+		}
+	}
+	return -EMFILE;
+}
+
+struct kalert_handle *kalert_fd_handle(int fd)
+{
+	int i;
+
+	if (fd < 0)
+		return NULL;
+
+	for (i = 0; i < KALERT_MAX_SOCKS; i++) {
+		if (socks[i] && socks[i]->fd == fd)
+			return socks[i];
+	}
+	return NULL;
+}
+
+struct kalert_handle *kalert_fd_unregister(int fd)
+{
+	struct kalert_handle *h;
+	int i;
+
+	if (fd < 0)
+		return NULL;
+
+	for (i = 0; i < KALERT_MAX_SOCKS; i++) {
+		h = socks[i];
+		if (h && h->fd == fd) {
+			socks[i] = NULL;
+			return h;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Find room for @len bytes in pend_buf. Entries are laid out in FIFO
+ * order and wrap to the start of the buffer when the tail runs out of
+ * contiguous space. Returns the offset, or -1 if there is no room.
+ */
+static long pending_alloc(struct kalert_handle *h, uint32_t len)
+{
+	struct kalert_pending *first, *last;
+	uint32_t tail;
+
+	if (h->count == 0)
+		return len <= KALERT_PENDING_BYTES ? 0 : -1;
+
+	first = &h->queue[h->head];
+	last = &h->queue[(h->head + h->count - 1) % KALERT_PENDING_MAX];
+	tail = last->off + NLMSG_ALIGN(last->len);
+
+	if (last->off >= first->off) {
+		/* not wrapped: free space at the end, then before first */
+		if (tail + len <= KALERT_PENDING_BYTES)
+			return tail;
+		if (len <= first->off)
+			return 0;
+		return -1;
+	}
+
+	/* wrapped: the only free space is between tail and first */
+	if (tail + len <= first->off)
+		return tail;
+	return -1;
+}
+
+/*
+ * Park a copy of a received datagram. When the queue is full the new
+ * message is dropped and accounted in qstats.dropped; older ones are kept
+ * so delivery order is preserved.
+ */
+void kalert_pending_push(struct kalert_handle *h, const void *msg, int len,
+			 uint64_t ts_ns)
+{
+	struct kalert_pending *p;
+	long off;
+
+	if (h->count == KALERT_PENDING_MAX) {
+		h->qstats.dropped++;
+		return;
+	}
+
+	off = pending_alloc(h, len);
+	if (off < 0) {
+		h->qstats.dropped++;
+		return;
+	}
+	memcpy(h->pend_buf + off, msg, len);
+
+	p = &h->queue[(h->head + h->count) % KALERT_PENDING_MAX];
+	p->off = off;
+	p->len = len;
+	p->ts_ns = ts_ns;
+	h->count++;
+	h->qstats.queued++;
+}
+
+/*
+ * Copy the oldest parked datagram into @buf and its receipt time into
+ * @ts_ns. Returns its length, or 0 if nothing is queued.
+ */
+int kalert_pending_pop(struct kalert_handle *h, void *buf, size_t size,
+		       bool peek, uint64_t *ts_ns)
+{
+	struct kalert_pending *p;
+	int len;
+
+	if (!h || !h->count)
+		return 0;
+
+	p = &h->queue[h->head];
+	len = p->len < size ? (int)p->len : (int)size;
+	memcpy(buf, h->pend_buf + p->off, len);
+	*ts_ns = p->ts_ns;
+
+	if (peek)
+		return len;
+
+	h->head = (h->head + 1) % KALERT_PENDING_MAX;
+	h->count--;
+	h->qstats.delivered++;
+	return len;
+}
+
+/**
+ * kalert_handle_get_queue_stats - counters of the parked notification queue
+ * @h:     kalert handle
+ * @stats: output
+ *
+ * Return: 0 on success, -EBADF if @h is NULL.
+ */
+int kalert_handle_get_queue_stats(struct kalert_handle *h,
+				  struct kalert_queue_stats *stats)
+{
+	if (!h)
+		return -EBADF;
+	if (!stats)
+		return -EINVAL;
+
+	*stats = h->qstats;
+	return 0;
+}
+
+int kalert_get_queue_stats(int fd, struct kalert_queue_stats *stats)
+{
+	return kalert_handle_get_queue_stats(kalert_fd_handle(fd), stats);
+}
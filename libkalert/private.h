@@ -11,6 +11,9 @@
 
 #include <libkalert/libkalert.h>
 #include <limits.h>
+#include <sys/socket.h>
+#include <stddef.h>
+#include <time.h>
 
 #define TYPE_MASK_VALID(mask) \
 	(((mask) != 0) &&     \
@@ -41,4 +44,164 @@ static inline int events_to_bitmap(const int *event_ids, size_t count,
 
 	return 0;
 }
+
+/* Maximum number of sockets opened through the fd based API */
+#define KALERT_MAX_SOCKS 16
+
+/* Notifications parked per handle while a request waits for its ACK */
+#define KALERT_PENDING_MAX 64
+#define KALERT_PENDING_BYTES (64 * 1024)
+
+struct kalert_pending {
+	uint32_t off;
+	uint32_t len;
+	uint64_t ts_ns; /* receipt, see kalert_rx_ts() */
+};
+
+/* Control buffer of one receive, room for an SCM_TIMESTAMPNS */
+#define KALERT_RX_CTRL_SIZE CMSG_SPACE(sizeof(struct timespec))
+
+struct kalert_handle;
+
+/* Slots for KALERT_EVENT_BASE..KALERT_EVENT_END, then the heartbeat */
+#define DISPATCH_HEARTBEAT KALERT_EVENT_MAX
+
+/* Datagrams taken by one receive call of kalert_dispatch() */
+#define DISPATCH_BATCH 16
+
+struct dispatch_entry {
+	kalert_notify_cb_t cb;
+	void *data;
+};
+
+struct kalert_consumer {
+	struct dispatch_entry entry;
+	bool used;
+	uint32_t min_level;
+	unsigned long events[BITS_TO_LONGS(KALERT_EVENT_MAX)];
+};
+
+/*
+ * A SUBSCRIBE request as the kernel applies it: a type mask, or an event
+ * bitmap when one was given, plus a minimum level. Used by transports
+ * that filter on the kernel's behalf.
+ */
+struct kalert_subscription {
+	bool active;
+	bool by_event;
+	uint64_t type_mask;
+	uint32_t level;
+	unsigned long events[BITS_TO_LONGS(KALERT_EVENT_MAX)];
+};
+
+struct kalert_dispatch {
+	struct dispatch_entry event[KALERT_EVENT_MAX + 1];
+	struct dispatch_entry type[KALERT_NOTIFY_MAX];
+	struct dispatch_entry level[KALERT_LEVEL_MAX];
+	unsigned int callbacks; /* entries above not pointing at the no-op */
+
+	/*
+	 * Consumer filters, bit sliced: bit c of event_consumers[idx] is set
+	 * when consumer c wants event idx, bit c of level_consumers[l] when
+	 * l reaches its minimum level. A notification matches the AND of
+	 * the two words, all consumers checked at once.
+	 */
+	uint64_t event_consumers[KALERT_EVENT_MAX + 1];
+	uint64_t level_consumers[KALERT_LEVEL_MAX];
+	struct kalert_consumer consumer[KALERT_CONSUMER_MAX];
+
+	kalert_status_cb_t status_cb;
+	void *status_data;
+
+	uint64_t ts_ns; /* receipt of the datagram being dispatched */
+	struct kalert_reply_slot slots[DISPATCH_BATCH];
+};
+
+/*
+ * Transport backend of a handle. recv() must fill msg_name of every
+ * message with the sender's struct sockaddr_nl, so the generic receive
+ * path can run the same checks whatever the backend. Operations return a
+ * count or a negative errno.
+ */
+struct kalert_transport {
+	const char *name;
+	int (*open)(struct kalert_handle *h, const void *arg);
+	int (*send)(struct kalert_handle *h, struct mmsghdr *msgs,
+		    unsigned int vlen);
+	int (*recv)(struct kalert_handle *h, struct mmsghdr *msgs,
+		    unsigned int vlen, int flags);
+	void (*close)(struct kalert_handle *h);
+};
+
+extern const struct kalert_transport kalert_netlink_transport;
+extern const struct kalert_transport kalert_fake_transport;
+extern const struct kalert_transport kalert_broker_transport;
+
+struct kalert_handle {
+	const struct kalert_transport *ops;
+	void *priv; /* transport private data */
+	int fd;
+	uint32_t portid;
+	uint32_t seq; /* atomic, see next_seq() */
+	uint64_t overruns; /* ENOBUFS seen on the socket */
+	bool overrun_unreported; /* ENOBUFS not returned to the caller yet */
+	struct kalert_dispatch *dispatch; /* callbacks, see dispatch.c */
+	uint32_t status_seq; /* outstanding async status request, 0 if none */
+
+	/* preallocated request and ACK buffers */
+	union {
+		struct nlmsghdr nlh;
+		char buf[KALERT_REQ_MAX_SIZE];
+	} req;
+	struct kalert_message rep;
+	uint64_t rx_ts_ns; /* receipt of the last kalert_recv() datagram */
+
+	/* bounded FIFO of parked datagrams, stored back to back in pend_buf */
+	unsigned int head;
+	unsigned int count;
+	struct kalert_pending queue[KALERT_PENDING_MAX];
+	struct kalert_queue_stats qstats;
+	char pend_buf[KALERT_PENDING_BYTES]
+		__attribute__((aligned(NLMSG_ALIGNTO)));
+};
+
+/* Called for replies that share the seq of a pending request */
+typedef void (*kalert_reply_cb_t)(const struct nlmsghdr *nlh, void *data);
+
+/* netlink.c */
+struct kalert_handle *
+kalert_handle_open_transport(const struct kalert_transport *ops,
+			     const void *arg);
+int kalert_send_nlmsg(struct kalert_handle *h, struct nlmsghdr *req);
+int kalert_send_nlmsg_cb(struct kalert_handle *h, struct nlmsghdr *req,
+			 kalert_reply_cb_t cb, void *data);
+int kalert_send_nlmsg_async(struct kalert_handle *h, struct nlmsghdr *req,
+			    uint32_t *seq);
+int kalert_send_request_batch(struct kalert_handle *h, struct nlmsghdr **reqs,
+			      int *errs, unsigned int count);
+uint64_t kalert_rx_ts(const struct msghdr *mh);
+void kalert_rx_ts_put(struct msghdr *mh, uint64_t ts_ns);
+
+/* dispatch.c */
+struct kalert_dispatch *kalert_dispatch_get(struct kalert_handle *h);
+void kalert_dispatch_free(struct kalert_handle *h);
+
+/* filter.c */
+int kalert_subscription_parse(struct kalert_subscription *sub,
+			      const struct nlmsghdr *nlh);
+bool kalert_subscription_match(const struct kalert_subscription *sub,
+			       uint32_t type, uint32_t event, uint32_t level);
+
+/* status.c */
+void kalert_dispatch_status(struct kalert_handle *h,
+			    const struct kalert_dispatch *d, void *buf, int len);
+
+/* pending.c */
+int kalert_fd_register(struct kalert_handle *h);
+struct kalert_handle *kalert_fd_handle(int fd);
+struct kalert_handle *kalert_fd_unregister(int fd);
+void kalert_pending_push(struct kalert_handle *h, const void *msg, int len,
+			 uint64_t ts_ns);
+int kalert_pending_pop(struct kalert_handle *h, void *buf, size_t size,
+		       bool peek, uint64_t *ts_ns);
 #endif /* __PRIVATE_H */
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Compact request builders
+ *
+ * Requests are a few dozen bytes. The builders encode them into right
+ * sized caller buffers (see KALERT_*_REQ_SIZE) and only initialize the
+ * bytes they emit: no struct kalert_message, no memset of 8 KB.
+ */
+
+#include <libkalert/libkalert.h>
+#include <libmnl/libmnl.h>
+
+#include "private.h"
+
+#define ATTR_MASK_ALLOWED_SET                                         \
+	((1U << KALERT_ENABLE) | (1U << KALERT_PORTID) |              \
+	 (1U << KALERT_FILTER_LEVEL) | (1U << KALERT_BACKLOG_LIMIT) | \
+	 (1U << KALERT_PACKLOSS_COUNT))
+
+/*
+ * Header of a new request. flags and seq are filled when it is sent,
+ * but must not carry garbage from a previous use of the buffer.
+ */
+static struct nlmsghdr *req_init(void *buf, uint16_t type)
+{
+	struct nlmsghdr *nlh = buf;
+
+	nlh->nlmsg_len = NLMSG_LENGTH(0);
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = 0;
+	nlh->nlmsg_seq = 0;
+	nlh->nlmsg_pid = 0;
+	return nlh;
+}
+
+/**
+ * kalert_build_set_chnl - encode a SET_CHNL request
+ * @buf:       destination, NLMSG_ALIGNTO aligned
+ * @size:      room in @buf, at least KALERT_SET_CHNL_REQ_SIZE
+ * @attr_mask: attributes to set, as for kalert_set_parameter()
+ * @attr:      attribute values indexed by attribute type
+ *
+ * Return: length of the request, or a negative error code.
+ */
+int kalert_build_set_chnl(void *buf, size_t size, uint32_t attr_mask,
+			  const uint64_t *attr)
+{
+	struct nlmsghdr *nlh;
+	int i;
+
+	if (!buf || size < KALERT_SET_CHNL_REQ_SIZE)
+		return -ENOSPC;
+
+	if (attr_mask & ~ATTR_MASK_ALLOWED_SET) {
+		kalert_msg(LOG_WARNING,
+			   "Parameters to set are not allowed, mask:%x",
+			   attr_mask);
+		return -EINVAL;
+	}
+
+	if ((attr_mask & KALERT_MASK(KALERT_FILTER_LEVEL)) &&
+	    attr[KALERT_FILTER_LEVEL] >= KALERT_LEVEL_MAX) {
+		kalert_msg(LOG_WARNING,
+			   "Try to set an invalid filter level: %llu",
+			   (unsigned long long)attr[KALERT_FILTER_LEVEL]);
+		return -EINVAL;
+	}
+
+	if ((attr_mask & KALERT_MASK(KALERT_ENABLE)) &&
+	    attr[KALERT_ENABLE] != 0 && attr[KALERT_ENABLE] != 1)
+		return -EINVAL;
+
+	nlh = req_init(buf, KALERT_CMD_SET_CHNL);
+	for (i = 1; i < KALERT_ATTR_MAX; i++) {
+		if (attr_mask & KALERT_MASK(i))
+			mnl_attr_put_u32(nlh, i, attr[i]);
+	}
+
+	return nlh->nlmsg_len;
+}
+
+/* Encode a SUBSCRIBE request by type mask, see kalert_build_set_chnl() */
+int kalert_build_subscribe_type(void *buf, size_t size, uint64_t type_mask,
+				uint32_t level)
+{
+	struct nlmsghdr *nlh;
+
+	if (!buf || size < KALERT_SUB_TYPE_REQ_SIZE)
+		return -ENOSPC;
+	if (!TYPE_MASK_VALID(type_mask) || level >= KALERT_LEVEL_MAX)
+		return -EINVAL;
+
+	nlh = req_init(buf, KALERT_CMD_SUBSCRIBE);
+	mnl_attr_put_u64(nlh, KALERT_SUB_TYPE_MASK, type_mask);
+	mnl_attr_put_u32(nlh, KALERT_SUB_LEVEL, level);
+	return nlh->nlmsg_len;
+}
+
+/* Encode a SUBSCRIBE request by event list, see kalert_build_set_chnl() */
+int kalert_build_subscribe_event(void *buf, size_t size, const int *event_ids,
+				 size_t count, uint32_t level)
+{
+	unsigned long event_mask[BITS_TO_LONGS(KALERT_EVENT_MAX)];
+	struct nlmsghdr *nlh;
+	int rc;
+
+	if (!buf || size < KALERT_SUB_EVENT_REQ_SIZE)
+		return -ENOSPC;
+	if (!event_ids || count == 0)
+		return -EINVAL;
+
+	rc = events_to_bitmap(event_ids, count, event_mask, KALERT_EVENT_MAX);
+	if (rc < 0)
+		return rc;
+
+	nlh = req_init(buf, KALERT_CMD_SUBSCRIBE);
+	mnl_attr_put_u32(nlh, KALERT_SUB_LEVEL, level);
+	mnl_attr_put(nlh, KALERT_SUB_EVENT_MASK, sizeof(event_mask),
+		     event_mask);
+	return nlh->nlmsg_len;
+}
+
+/* Encode a GET_STATUS request, see kalert_build_set_chnl() */
+int kalert_build_status(void *buf, size_t size, uint64_t mask)
+{
+	struct nlmsghdr *nlh;
+
+	if (!buf || size < KALERT_STATUS_REQ_SIZE)
+		return -ENOSPC;
+
+	nlh = req_init(buf, KALERT_CMD_GET_STATUS);
+	mnl_attr_put_u64(nlh, KALERT_GET_STAT_MASK, mask);
+	return nlh->nlmsg_len;
+}
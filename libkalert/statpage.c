@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd statistics page, seqlock writer and reader
+ *
+ * See libkalert/statpage.h. Both sides move the stats one 64-bit word at
+ * a time with relaxed atomics; the seqlock fences order them against
+ * the sequence number.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libkalert/statpage.h>
+
+#include "private.h"
+
+/* Reader attempts before giving up on a writer stuck mid update */
+#define STATPAGE_RETRIES 1000
+
+/* Attempts spun before yielding the CPU to the writer */
+#define STATPAGE_SPINS 64
+
+#define STATPAGE_HDR_SIZE 128
+
+#define STATPAGE_WORDS (sizeof(struct kalert_daemon_stats) / sizeof(uint64_t))
+
+struct kalert_statpage {
+	struct kalert_statpage_header *hdr;
+	uint64_t *stats;
+	size_t map_len;
+	uint32_t seq; /* private copy of hdr->seq */
+	char path[PATH_MAX];
+};
+
+/**
+ * kalert_statpage_create - create the page and publish it at @path
+ * @path: page file, replaced if it exists; NULL for KALERT_STATPAGE_PATH
+ *
+ * The stats read as all zero until the first kalert_statpage_update().
+ *
+ * Return: new page, or NULL on error (errno is set).
+ */
+struct kalert_statpage *kalert_statpage_create(const char *path)
+{
+	char tmp[PATH_MAX + 8];
+	struct kalert_statpage *sp;
+	struct kalert_statpage_header *hdr;
+	size_t len = STATPAGE_HDR_SIZE + sizeof(struct kalert_daemon_stats);
+	int fd, err;
+
+	if (!path)
+		path = KALERT_STATPAGE_PATH;
+	if (strlen(path) >= PATH_MAX) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	sp = calloc(1, sizeof(*sp));
+	if (!sp)
+		return NULL;
+	strcpy(sp->path, path);
+
+	kalert_mkdir_parent(path, 0755);
+	snprintf(tmp, sizeof(tmp), "%s.new", path);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		goto err_free;
+
+	if (ftruncate(fd, len) < 0)
+		goto err_unlink;
+
+	hdr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		goto err_unlink;
+
+	memcpy(hdr->magic, KALERT_STATPAGE_MAGIC, sizeof(hdr->magic));
+	hdr->version = KALERT_STATPAGE_VERSION;
+	hdr->hdr_size = STATPAGE_HDR_SIZE;
+	hdr->stats_size = sizeof(struct kalert_daemon_stats);
+
+	/* readers only ever see a complete header */
+	if (rename(tmp, path) < 0) {
+		err = errno;
+		munmap(hdr, len);
+		errno = err;
+		goto err_unlink;
+	}
+	close(fd);
+
+	sp->hdr = hdr;
+	sp->stats = (uint64_t *)((char *)hdr + STATPAGE_HDR_SIZE);
+	sp->map_len = len;
+	return sp;
+
+err_unlink:
+	err = errno;
+	close(fd);
+	unlink(tmp);
+	errno = err;
+err_free:
+	free(sp);
+	return NULL;
+}
+
+static void statpage_write(struct kalert_statpage *sp, const uint64_t *w,
+			   size_t nwords)
+{
+	size_t i;
+
+	__atomic_store_n(&sp->hdr->seq, ++sp->seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (i = 0; i < nwords; i++)
+		__atomic_store_n(&sp->stats[i], w[i], __ATOMIC_RELAXED);
+
+	__atomic_store_n(&sp->hdr->seq, ++sp->seq, __ATOMIC_RELEASE);
+}
+
+/* Publish a new snapshot, readers retry while it is being copied */
+void kalert_statpage_update(struct kalert_statpage *sp,
+			    const struct kalert_daemon_stats *st)
+{
+	if (!sp || !st)
+		return;
+
+	statpage_write(sp, (const uint64_t *)st, STATPAGE_WORDS);
+}
+
+/* Mark the page closed for its readers and remove it */
+void kalert_statpage_remove(struct kalert_statpage *sp)
+{
+	if (!sp)
+		return;
+
+	/* under the seqlock, so a reader sees it with the last snapshot */
+	__atomic_store_n(&sp->hdr->seq, ++sp->seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&sp->hdr->closed, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&sp->hdr->seq, ++sp->seq, __ATOMIC_RELEASE);
+
+	unlink(sp->path);
+	munmap(sp->hdr, sp->map_len);
+	free(sp);
+}
+
+/**
+ * kalert_statpage_open - map a page for reading
+ * @path: page file, NULL for KALERT_STATPAGE_PATH
+ * @v:    output
+ *
+ * Return: 0 on success, negative error code otherwise, -EINVAL if @path
+ * is not a page of a supported version.
+ */
+int kalert_statpage_open(const char *path, struct kalert_statpage_view *v)
+{
+	const struct kalert_statpage_header *hdr;
+	struct stat st;
+	size_t words;
+	int fd, rc;
+
+	if (!v)
+		return -EINVAL;
+
+	fd = open(path ?: KALERT_STATPAGE_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		goto out;
+	}
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		rc = -errno;
+		goto out;
+	}
+
+	if (memcmp(hdr->magic, KALERT_STATPAGE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != KALERT_STATPAGE_VERSION ||
+	    hdr->hdr_size < sizeof(*hdr) ||
+	    hdr->hdr_size + (uint64_t)hdr->stats_size > (uint64_t)st.st_size) {
+		munmap((void *)hdr, st.st_size);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	words = hdr->stats_size / sizeof(uint64_t);
+	v->hdr = hdr;
+	v->stats = (const uint64_t *)((const char *)hdr + hdr->hdr_size);
+	v->nwords = words < STATPAGE_WORDS ? words : STATPAGE_WORDS;
+	v->map_len = st.st_size;
+	rc = 0;
+out:
+	close(fd);
+	return rc;
+}
+
+/**
+ * kalert_statpage_read - take a consistent snapshot
+ * @v:  mapped page
+ * @st: output, fields the writer does not know are 0
+ *
+ * Never blocks the writer and never waits on it beyond a few retries.
+ *
+ * Return: 0 on success, -ESTALE once the writer closed the page (open
+ * the path again to follow a restarted kalertd), -EBUSY if the writer
+ * seems to have died in the middle of an update.
+ */
+int kalert_statpage_read(const struct kalert_statpage_view *v,
+			 struct kalert_daemon_stats *st)
+{
+	uint64_t *w = (uint64_t *)st;
+	uint32_t s1, s2;
+	unsigned int tries;
+	size_t i;
+
+	if (!v || !v->hdr || !st)
+		return -EINVAL;
+
+	memset(st, 0, sizeof(*st));
+
+	for (tries = 0; tries < STATPAGE_RETRIES; tries++) {
+		s1 = __atomic_load_n(&v->hdr->seq, __ATOMIC_ACQUIRE);
+		if (s1 & 1) {
+			if (tries >= STATPAGE_SPINS)
+				sched_yield();
+			continue;
+		}
+
+		for (i = 0; i < v->nwords; i++)
+			w[i] = __atomic_load_n(&v->stats[i], __ATOMIC_RELAXED);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&v->hdr->seq, __ATOMIC_RELAXED);
+		if (s1 != s2)
+			continue;
+
+		if (__atomic_load_n(&v->hdr->closed, __ATOMIC_RELAXED))
+			return -ESTALE;
+		return 0;
+	}
+
+	return -EBUSY;
+}
+
+void kalert_statpage_close(struct kalert_statpage_view *v)
+{
+	if (!v || !v->hdr)
+		return;
+
+	munmap((void *)v->hdr, v->map_len);
+	memset(v, 0, sizeof(*v));
+}
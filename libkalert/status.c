@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Channel status queries and loss accounting
+ */
+
+#include <libkalert/libkalert.h>
+#include <libmnl/libmnl.h>
+
+#include "private.h"
+
+static int status_attr_cb(const struct nlattr *attr, void *data)
+{
+	struct kalert_status *st = data;
+	uint16_t type = mnl_attr_get_type(attr);
+	uint64_t val;
+
+	if (mnl_attr_type_valid(attr, KALERT_ATTR_MAX - 1) < 0)
+		return MNL_CB_OK;
+
+	/* accept both widths, counters are u32 on older kernels */
+	if (mnl_attr_validate(attr, MNL_TYPE_U64) == 0)
+		val = mnl_attr_get_u64(attr);
+	else if (mnl_attr_validate(attr, MNL_TYPE_U32) == 0)
+		val = mnl_attr_get_u32(attr);
+	else
+		return MNL_CB_OK;
+
+	switch (type) {
+	case KALERT_ENABLE:
+		st->enable = val;
+		break;
+	case KALERT_PORTID:
+		st->portid = val;
+		break;
+	case KALERT_FILTER_LEVEL:
+		st->filter_level = val;
+		break;
+	case KALERT_BACKLOG_LIMIT:
+		st->backlog_limit = val;
+		break;
+	case KALERT_BACKLOG_DEPTH:
+		st->backlog_depth = val;
+		break;
+	case KALERT_PACKLOSS_COUNT:
+		st->packloss_count = val;
+		break;
+	default:
+		return MNL_CB_OK;
+	}
+
+	st->mask |= KALERT_MASK(type);
+	return MNL_CB_OK;
+}
+
+/**
+ * kalert_parse_status - decode a KALERT_CMD_GET_STATUS reply
+ * @nlh: received netlink message
+ * @st:  output, fields not present in the reply are left at 0
+ *
+ * Return: 0 on success, -EINVAL if @nlh is not a status reply.
+ */
+int kalert_parse_status(const struct nlmsghdr *nlh, struct kalert_status *st)
+{
+	if (!nlh || !st || nlh->nlmsg_type != KALERT_CMD_GET_STATUS)
+		return -EINVAL;
+
+	memset(st, 0, sizeof(*st));
+	mnl_attr_parse(nlh, 0, status_attr_cb, st);
+	return 0;
+}
+
+static void status_reply(const struct nlmsghdr *nlh, void *data)
+{
+	kalert_parse_status(nlh, data);
+}
+
+/**
+ * kalert_handle_get_status - query the channel status and wait for it
+ * @h:    kalert handle
+ * @mask: KALERT_MASK() of the attributes wanted, KALERT_STATUS_ALL for all
+ * @st:   output, st->mask tells which fields the kernel filled in
+ *
+ * Notifications arriving during the wait are parked as usual. Event loops
+ * that must not block use kalert_handle_request_status() instead.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int kalert_handle_get_status(struct kalert_handle *h, uint64_t mask,
+			     struct kalert_status *st)
+{
+	if (!h)
+		return -EBADF;
+	if (!st)
+		return -EINVAL;
+
+	memset(st, 0, sizeof(*st));
+	kalert_build_status(h->req.buf, sizeof(h->req), mask);
+	return kalert_send_nlmsg_cb(h, &h->req.nlh, status_reply, st);
+}
+
+int kalert_get_status(int fd, uint64_t mask, struct kalert_status *st)
+{
+	return kalert_handle_get_status(kalert_fd_handle(fd), mask, st);
+}
+
+/**
+ * kalert_handle_request_status - ask for the channel status, don't wait
+ * @h:    kalert handle
+ * @mask: KALERT_MASK() of the attributes wanted
+ *
+ * The reply arrives on the socket like a notification. kalert_dispatch()
+ * decodes it and hands it to the callback set with
+ * kalert_dispatch_on_status(); other callers can pass received messages
+ * to kalert_parse_status(). The notification iterator skips it.
+ *
+ * Return: 0 once sent, negative error code otherwise.
+ */
+int kalert_handle_request_status(struct kalert_handle *h, uint64_t mask)
+{
+	int rc;
+
+	if (!h)
+		return -EBADF;
+
+	kalert_build_status(h->req.buf, sizeof(h->req), mask);
+	rc = kalert_send_nlmsg_async(h, &h->req.nlh, &h->status_seq);
+	if (rc < 0)
+		kalert_msg(LOG_WARNING, "Error sending status request (%s)",
+			   strerror(-rc));
+	return rc;
+}
+
+int kalert_request_status(int fd, uint64_t mask)
+{
+	return kalert_handle_request_status(kalert_fd_handle(fd), mask);
+}
+
+/* Status callback of kalert_dispatch(), NULL removes it */
+int kalert_dispatch_on_status(struct kalert_handle *h, kalert_status_cb_t cb,
+			      void *data)
+{
+	struct kalert_dispatch *d;
+
+	if (!h)
+		return -EBADF;
+
+	d = kalert_dispatch_get(h);
+	if (!d)
+		return -ENOMEM;
+
+	d->status_cb = cb;
+	d->status_data = cb ? data : NULL;
+	return 0;
+}
+
+/*
+ * Called by kalert_dispatch() for every received datagram while a status
+ * request is outstanding.
+ */
+void kalert_dispatch_status(struct kalert_handle *h,
+			    const struct kalert_dispatch *d, void *buf, int len)
+{
+	struct kalert_status st;
+	struct nlmsghdr *nlh;
+
+	/* a slot rejected by the receive checks, e.g. a spoofed sender */
+	if (len <= 0)
+		return;
+
+	for (nlh = buf; NLMSG_OK(nlh, (unsigned int)len);
+	     nlh = NLMSG_NEXT(nlh, len)) {
+		if (nlh->nlmsg_type != KALERT_CMD_GET_STATUS)
+			continue;
+		if (nlh->nlmsg_seq == h->status_seq)
+			h->status_seq = 0;
+		if (d->status_cb && kalert_parse_status(nlh, &st) == 0)
+			d->status_cb(&st, d->status_data);
+	}
+}
+
+/**
+ * kalert_handle_get_loss_stats - collect every known source of lost events
+ * @h:            kalert handle
+ * @stats:        output
+ * @query_kernel: also fetch KALERT_PACKLOSS_COUNT from the kernel
+ *
+ * overruns counts receive buffer overflows seen as ENOBUFS on this socket
+ * (each may hide any number of messages), queue_dropped the notifications
+ * that did not fit in the parked queue, and kernel_packloss the kernel's
+ * own count of notifications it failed to deliver. kernel_valid is false
+ * when the kernel was not asked or did not answer.
+ *
+ * The kernel query waits for an ACK, notifications arriving meanwhile are
+ * parked as usual.
+ *
+ * Return: 0 on success or a negative error code from the kernel query,
+ * in which case the local counters are still filled in.
+ */
+int kalert_handle_get_loss_stats(struct kalert_handle *h,
+				 struct kalert_loss_stats *stats,
+				 bool query_kernel)
+{
+	struct kalert_status st;
+	int rc;
+
+	if (!h)
+		return -EBADF;
+	if (!stats)
+		return -EINVAL;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->overruns = h->overruns;
+	stats->queue_dropped = h->qstats.dropped;
+
+	if (!query_kernel)
+		return 0;
+
+	rc = kalert_handle_get_status(h, KALERT_MASK(KALERT_PACKLOSS_COUNT),
+				      &st);
+	if (rc == 0 && (st.mask & KALERT_MASK(KALERT_PACKLOSS_COUNT))) {
+		stats->kernel_packloss = st.packloss_count;
+		stats->kernel_valid = true;
+	}
+	return rc;
+}
+
+int kalert_get_loss_stats(int fd, struct kalert_loss_stats *stats,
+			  bool query_kernel)
+{
+	return kalert_handle_get_loss_stats(kalert_fd_handle(fd), stats,
+					    query_kernel);
+}
@@ -60,6 +60,8 @@ cp -a packaging/conf/* %{buildroot}%{_sysconfdir}/kalert/
 %doc README.md
 %{_bindir}/kalertd
 %{_bindir}/sub_test
+%{_bindir}/kalertcat
+%{_bindir}/kalertctl
 %{_libdir}/libkalert.so
 %{_libdir}/libkalert.so.*
 %{_libdir}/libkalert.a
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Storm coalescing of repeated notifications
+ *
+ * Open addressing with linear probing over a small fixed table. Entries
+ * are only removed by coalesce_flush(), which rebuilds the table instead
+ * of keeping tombstones.
+ */
+
+#include <string.h>
+
+#include "coalesce.h"
+
+void coalesce_init(struct coalescer *c, unsigned int window_ms)
+{
+	memset(c, 0, sizeof(*c));
+	c->window_ns = (uint64_t)window_ms * 1000000;
+}
+
+static unsigned int coalesce_hash(uint32_t type, uint32_t event,
+				  uint32_t level)
+{
+	uint64_t key = (uint64_t)event << 32 | type << 8 | level;
+
+	return (key * 0x9e3779b97f4a7c15ULL) >> 56 & (COALESCE_SLOTS - 1);
+}
+
+/* Slot of the key, or a free slot for it, NULL if the probe run is full */
+static struct coalesce_entry *coalesce_lookup(struct coalescer *c,
+					      uint32_t type, uint32_t event,
+					      uint32_t level)
+{
+	unsigned int i, h = coalesce_hash(type, event, level);
+	struct coalesce_entry *e;
+
+	for (i = 0; i < COALESCE_PROBE; i++) {
+		e = &c->slot[(h + i) & (COALESCE_SLOTS - 1)];
+		if (!e->used)
+			return e;
+		if (e->event == event && e->type == type && e->level == level)
+			return e;
+	}
+	return NULL;
+}
+
+bool coalesce_event(struct coalescer *c, uint32_t type, uint32_t event,
+		    uint32_t level, uint64_t mono_ns, uint64_t real_ns)
+{
+	struct coalesce_entry *e;
+
+	if (!c->window_ns)
+		return true;
+
+	e = coalesce_lookup(c, type, event, level);
+	if (!e) {
+		c->uncoalesced++;
+		return true;
+	}
+
+	if (!e->used) {
+		/* first occurrence, goes out now and opens the window */
+		e->type = type;
+		e->event = event;
+		e->level = level;
+		e->used = true;
+		e->window_ns = mono_ns;
+		e->count = 0;
+		return true;
+	}
+
+	if (!e->count)
+		e->first_ns = real_ns;
+	e->last_ns = real_ns;
+	e->count++;
+	c->suppressed++;
+	return false;
+}
+
+void coalesce_flush(struct coalescer *c, uint64_t mono_ns, bool all,
+		    coalesce_emit_t emit, void *data)
+{
+	struct coalesce_entry keep[COALESCE_SLOTS];
+	struct coalesce_entry *e;
+	unsigned int i, n = 0;
+	bool dropped = false;
+
+	for (i = 0; i < COALESCE_SLOTS; i++) {
+		e = &c->slot[i];
+		if (!e->used)
+			continue;
+
+		if (!all && mono_ns - e->window_ns < c->window_ns) {
+			keep[n++] = *e;
+			continue;
+		}
+
+		if (e->count)
+			emit(e, data);
+
+		/* still repeating: keep folding it into the next window */
+		if (!all && e->count) {
+			e->count = 0;
+			e->window_ns = mono_ns;
+			keep[n++] = *e;
+		} else {
+			dropped = true;
+		}
+	}
+
+	if (!dropped)
+		return;
+
+	memset(c->slot, 0, sizeof(c->slot));
+	for (i = 0; i < n; i++) {
+		e = coalesce_lookup(c, keep[i].type, keep[i].event,
+				    keep[i].level);
+		if (e)
+			*e = keep[i];
+		else if (keep[i].count)
+			emit(&keep[i], data); /* never lose a pending count */
+	}
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Storm coalescing of repeated notifications
+ *
+ * The first notification of a (type, event, level) key is logged as is
+ * and opens a window. Repeats inside the window are only counted; when
+ * the window ends they are logged as one summary with the count and the
+ * first and last arrival time, and a new window opens. A key that stays
+ * quiet for a whole window is forgotten.
+ *
+ * Notes:
+ *    Thread Safety: NOT thread-safe, driven from the kalertd event loop.
+ */
+
+#ifndef KALERT_COALESCE_H
+#define KALERT_COALESCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Keys tracked at once, a power of two */
+#define COALESCE_SLOTS 256
+
+/* Slots probed for a key before giving up on coalescing it */
+#define COALESCE_PROBE 8
+
+struct coalesce_entry {
+	uint32_t type;
+	uint32_t event;
+	uint32_t level;
+	bool used;
+	uint64_t window_ns; /* CLOCK_MONOTONIC start of the current window */
+	uint64_t count; /* repeats suppressed in the current window */
+	uint64_t first_ns; /* CLOCK_REALTIME of the first repeat */
+	uint64_t last_ns; /* CLOCK_REALTIME of the last repeat */
+};
+
+struct coalescer {
+	uint64_t window_ns; /* 0 disables coalescing */
+	uint64_t suppressed; /* repeats folded into summaries */
+	uint64_t uncoalesced; /* notifications passed through, table full */
+	struct coalesce_entry slot[COALESCE_SLOTS];
+};
+
+/* Called for every summary, see coalesce_flush() */
+typedef void (*coalesce_emit_t)(const struct coalesce_entry *e, void *data);
+
+/**
+ * coalesce_init - Reset a coalescer
+ * @c:         coalescer
+ * @window_ms: coalescing window, 0 lets everything through
+ */
+void coalesce_init(struct coalescer *c, unsigned int window_ms);
+
+/**
+ * coalesce_event - Account one notification
+ * @c:       coalescer
+ * @type:    notification type
+ * @event:   event id
+ * @level:   level
+ * @mono_ns: CLOCK_MONOTONIC arrival time, drives the windows
+ * @real_ns: CLOCK_REALTIME arrival time, reported in summaries
+ *
+ * Return: true if the notification must be logged now, false if it was
+ * folded into the pending summary of its key.
+ */
+bool coalesce_event(struct coalescer *c, uint32_t type, uint32_t event,
+		    uint32_t level, uint64_t mono_ns, uint64_t real_ns);
+
+/**
+ * coalesce_flush - Emit summaries of the windows that ended
+ * @c:       coalescer
+ * @mono_ns: CLOCK_MONOTONIC now
+ * @all:     end every window, for shutdown and reconfiguration
+ * @emit:    summary callback
+ * @data:    passed to @emit
+ *
+ * Call at least once per window.
+ */
+void coalesce_flush(struct coalescer *c, uint64_t mono_ns, bool all,
+		    coalesce_emit_t emit, void *data);
+
+#endif /* KALERT_COALESCE_H */
@@ -8,9 +8,16 @@
  *
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <libkalert/libkalert.h>
 
 #include "common.h"
 
@@ -84,3 +91,169 @@ bool parse_config(const char *path,
 	/* No valid configuration lines */
 	return parsed > 0;
 }
+
+/*
+ * ts_format:
+ *   Date and time are converted once per second, each call only writes
+ *   the milliseconds.
+ */
+const char *ts_format(struct ts_cache *c, uint64_t ts_ns, bool utc)
+{
+	time_t sec = ts_ns / 1000000000;
+	unsigned int ms = ts_ns % 1000000000 / 1000000;
+	struct tm tm;
+
+	if (sec != c->sec || utc != c->utc) {
+		if (utc)
+			gmtime_r(&sec, &tm);
+		else
+			localtime_r(&sec, &tm);
+		/* a uint64_t of ns ends in 2554, the year has four digits */
+		strftime(c->buf, sizeof(c->buf), "%Y-%m-%d %H:%M:%S.", &tm);
+		c->sec = sec;
+		c->utc = utc;
+	}
+
+	c->buf[TS_LEN - 3] = '0' + ms / 100;
+	c->buf[TS_LEN - 2] = '0' + ms / 10 % 10;
+	c->buf[TS_LEN - 1] = '0' + ms % 10;
+	c->buf[TS_LEN] = '\0';
+	return c->buf;
+}
+
+/*
+ * format_ts:
+ *   Format a CLOCK_REALTIME timestamp like the event log does, the result
+ *   is valid until the next call.
+ */
+const char *format_ts(uint64_t ts_ns, bool utc)
+{
+	static struct ts_cache cache = TS_CACHE_INIT;
+
+	return ts_format(&cache, ts_ns, utc);
+}
+
+/*
+ * parse_level:
+ *   Level name (ALL, INFO, WARN, ERROR, FATAL) or number. Returns the
+ *   level or -1.
+ */
+int parse_level(const char *val)
+{
+	unsigned int level;
+	char *end;
+
+	if (strcasecmp(val, "ALL") == 0)
+		return 0;
+	else if (strcasecmp(val, "INFO") == 0)
+		return 1;
+	else if (strcasecmp(val, "WARN") == 0)
+		return 2;
+	else if (strcasecmp(val, "ERROR") == 0)
+		return 3;
+	else if (strcasecmp(val, "FATAL") == 0)
+		return 4;
+
+	/* numeric fallback */
+	level = strtoul(val, &end, 0);
+	if (*val && !*end)
+		return level < KALERT_LEVEL_MAX ? (int)level : -1;
+	return -1;
+}
+
+/*
+ * parse_event:
+ *   Event id, or event name in any case with '_' allowed for spaces, as
+ *   in "EXT4_ERR". Returns the event id or -1.
+ */
+int parse_event(const char *val)
+{
+	const struct kalert_event_info *info;
+	char *end;
+	unsigned int i;
+	size_t j;
+
+	i = strtoul(val, &end, 0);
+	if (*val && !*end)
+		return i - KALERT_EVENT_BASE < KALERT_EVENT_MAX ? (int)i : -1;
+
+	for (i = 0; i < KALERT_EVENT_MAX; i++) {
+		info = &kalert_events[i];
+		if (!info->known)
+			continue;
+		for (j = 0; info->name.str[j] && val[j]; j++) {
+			if (tolower(val[j]) != info->name.str[j] &&
+			    !(val[j] == '_' && info->name.str[j] == ' '))
+				break;
+		}
+		if (!info->name.str[j] && !val[j])
+			return KALERT_EVENT_BASE + i;
+	}
+	return -1;
+}
+
+/*
+ * parse_type:
+ *   Notification type name (GENERIC, MEM, FS, ...) in any case, or
+ *   number. Returns the type or -1.
+ */
+int parse_type(const char *val)
+{
+	unsigned int type;
+	char *end;
+
+	type = strtoul(val, &end, 0);
+	if (*val && !*end)
+		return type < KALERT_NOTIFY_MAX ? (int)type : -1;
+
+	for (type = 1; type < KALERT_NOTIFY_MAX; type++) {
+		if (strcasecmp(val, kalert_types[type].str) == 0)
+			return type;
+	}
+	return -1;
+}
+
+int unix_listen(const char *path, unsigned int mode)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd, err;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	kalert_mkdir_parent(path, 0755);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    chmod(path, mode) < 0 || listen(fd, 8) < 0) {
+		err = errno;
+		close(fd);
+		unlink(path);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+int send_all(int fd, const void *buf, size_t len)
+{
+	ssize_t rc;
+
+	while (len) {
+		rc = send(fd, buf, len, MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf = (const char *)buf + rc;
+		len -= rc;
+	}
+	return 0;
+}
@@ -12,7 +12,9 @@
 #define KALERT_COMMON_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> /* atoi() */
+#include <time.h>
 
 /*
  * parse_config()
@@ -27,4 +29,67 @@
 bool parse_config(const char *conf,
 		  bool (*parse_line)(const char *key, const char *val));
 
+/* Length of "YYYY-MM-DD HH:MM:SS.mmm" */
+#define TS_LEN 23
+
+/*
+ * struct ts_cache
+ *
+ * State of ts_format(): the broken-down date and time of one second.
+ * Initialize with TS_CACHE_INIT.
+ */
+struct ts_cache {
+	time_t sec;
+	bool utc;
+	char buf[TS_LEN + 1];
+};
+
+#define TS_CACHE_INIT { .sec = -1 }
+
+/*
+ * ts_format()
+ *
+ * Formats a CLOCK_REALTIME timestamp in nanoseconds as
+ * "YYYY-MM-DD HH:MM:SS.mmm", in UTC or local time, into @c->buf.
+ * Calendar conversion only runs when the second changes, otherwise the
+ * milliseconds are written over the previous string. Returns @c->buf,
+ * TS_LEN bytes long.
+ */
+const char *ts_format(struct ts_cache *c, uint64_t ts_ns, bool utc);
+
+/*
+ * format_ts()
+ *
+ * ts_format() into a static buffer, NOT thread-safe.
+ */
+const char *format_ts(uint64_t ts_ns, bool utc);
+
+/*
+ * parse_level(), parse_type(), parse_event()
+ *
+ * Parse a level, notification type or event given by name or number, as
+ * written in kalertd.conf or on a command line. They return -1 for
+ * unknown values.
+ */
+int parse_level(const char *val);
+int parse_type(const char *val);
+int parse_event(const char *val);
+
+/*
+ * unix_listen()
+ *
+ * Replaces @path by a listening Unix stream socket of mode @mode,
+ * creating the parent directory if needed. Returns the socket, or -1
+ * with errno set.
+ */
+int unix_listen(const char *path, unsigned int mode);
+
+/*
+ * send_all()
+ *
+ * Sends all of @buf on a socket, retrying short sends. Returns 0, or -1
+ * with errno set.
+ */
+int send_all(int fd, const void *buf, size_t len);
+
 #endif /* KALERT_COMMON_H_ */
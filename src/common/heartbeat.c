@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Kernel heartbeat liveness tracking and jitter histogram
+ */
+
+#include <string.h>
+#include <libkalert/libkalert.h>
+
+#include "heartbeat.h"
+
+void hb_init(struct hb_monitor *m, unsigned int period_ms)
+{
+	memset(m, 0, sizeof(*m));
+	m->period_ns = (uint64_t)period_ms * 1000000;
+}
+
+/* Bucket i holds jitter below 2^i us, bucket 0 everything under 1 us */
+static unsigned int hb_bucket(uint64_t jitter_ns)
+{
+	uint64_t us = jitter_ns / 1000;
+	unsigned int b;
+
+	if (!us)
+		return 0;
+	b = 64 - __builtin_clzll(us);
+	return b < HB_HIST_BUCKETS ? b : HB_HIST_BUCKETS - 1;
+}
+
+void hb_record(struct hb_monitor *m, uint64_t now_ns)
+{
+	uint64_t interval, jitter;
+
+	if (m->last_ns && now_ns > m->last_ns) {
+		interval = now_ns - m->last_ns;
+		jitter = interval > m->period_ns ? interval - m->period_ns :
+						   m->period_ns - interval;
+		m->hist[hb_bucket(jitter)]++;
+		if (jitter > m->max_jitter_ns)
+			m->max_jitter_ns = jitter;
+	}
+
+	m->last_ns = now_ns;
+	m->count++;
+}
+
+bool hb_stalled(const struct hb_monitor *m, uint64_t now_ns,
+		unsigned int misses)
+{
+	if (!m->last_ns || !m->period_ns)
+		return false;
+	return now_ns - m->last_ns > m->period_ns * misses;
+}
+
+uint64_t hb_quantile_us(const struct hb_monitor *m, double q)
+{
+	uint64_t total = 0, seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < HB_HIST_BUCKETS; i++)
+		total += m->hist[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < HB_HIST_BUCKETS; i++) {
+		seen += m->hist[i];
+		if (seen >= q * total)
+			break;
+	}
+	if (i >= HB_HIST_BUCKETS - 1)
+		return m->max_jitter_ns / 1000;
+	return 1ULL << i;
+}
+
+void hb_report(const struct hb_monitor *m)
+{
+	if (!m->count)
+		return;
+
+	kalert_msg(LOG_INFO,
+		   "kalert heartbeat: %llu received, %llu stalls, jitter p50<=%lluus p99<=%lluus max %lluus",
+		   (unsigned long long)m->count,
+		   (unsigned long long)m->stalls,
+		   (unsigned long long)hb_quantile_us(m, 0.5),
+		   (unsigned long long)hb_quantile_us(m, 0.99),
+		   (unsigned long long)(m->max_jitter_ns / 1000));
+}
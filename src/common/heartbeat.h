@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Kernel heartbeat liveness tracking and jitter histogram
+ *
+ * Notes:
+ *    Thread Safety: NOT thread-safe, driven from the kalertd event loop.
+ */
+
+#ifndef KALERT_HEARTBEAT_H
+#define KALERT_HEARTBEAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* log2 buckets of jitter in microseconds, the last one is open ended */
+#define HB_HIST_BUCKETS 24
+
+struct hb_monitor {
+	uint64_t period_ns; /* expected heartbeat period */
+	uint64_t last_ns; /* arrival of the last heartbeat, 0 if none yet */
+	uint64_t count; /* heartbeats seen */
+	uint64_t stalls; /* stalls detected */
+	uint64_t max_jitter_ns;
+	uint64_t hist[HB_HIST_BUCKETS];
+};
+
+/**
+ * hb_init - Reset a monitor
+ * @m:         monitor
+ * @period_ms: expected heartbeat period of the kernel
+ */
+void hb_init(struct hb_monitor *m, unsigned int period_ms);
+
+/**
+ * hb_record - Account one heartbeat arrival
+ * @m:      monitor
+ * @now_ns: CLOCK_MONOTONIC arrival time
+ *
+ * The jitter (|inter-arrival - period|) goes to the histogram; it is a
+ * proxy of the kernel to user space delivery latency.
+ */
+void hb_record(struct hb_monitor *m, uint64_t now_ns);
+
+/**
+ * hb_stalled - Tell whether heartbeats stopped
+ * @m:      monitor
+ * @now_ns: CLOCK_MONOTONIC now
+ * @misses: number of periods without heartbeat tolerated
+ *
+ * Never true before the first heartbeat, so kernels that do not send
+ * heartbeats are not resynced forever.
+ */
+bool hb_stalled(const struct hb_monitor *m, uint64_t now_ns,
+		unsigned int misses);
+
+/**
+ * hb_quantile_us - Upper bound of a jitter quantile, from the histogram
+ * @m: monitor
+ * @q: quantile in (0, 1]
+ */
+uint64_t hb_quantile_us(const struct hb_monitor *m, double q);
+
+/**
+ * hb_report - Log heartbeat count, stalls and jitter quantiles
+ */
+void hb_report(const struct hb_monitor *m);
+
+#endif /* KALERT_HEARTBEAT_H */
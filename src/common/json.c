@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: printf-free JSON Lines serializer for the event log
+ */
+
+#include "json.h"
+
+/* "00" to "99", two digits per division */
+static const char digits2[200] = "00010203040506070809"
+				 "10111213141516171819"
+				 "20212223242526272829"
+				 "30313233343536373839"
+				 "40414243444546474849"
+				 "50515253545556575859"
+				 "60616263646566676869"
+				 "70717273747576777879"
+				 "80818283848586878889"
+				 "90919293949596979899";
+
+void json_u64(struct json_buf *b, uint64_t v)
+{
+	char tmp[20]; /* UINT64_MAX has 20 digits */
+	char *p = tmp + sizeof(tmp);
+	unsigned int i;
+
+	while (v >= 100) {
+		i = (v % 100) * 2;
+		v /= 100;
+		p -= 2;
+		p[0] = digits2[i];
+		p[1] = digits2[i + 1];
+	}
+	if (v >= 10) {
+		p -= 2;
+		p[0] = digits2[v * 2];
+		p[1] = digits2[v * 2 + 1];
+	} else {
+		*--p = '0' + v;
+	}
+
+	json_put(b, p, tmp + sizeof(tmp) - p);
+}
+
+void json_event_head(struct json_buf *b, const char *ts, size_t ts_len,
+		     uint64_t seq, uint32_t type, uint32_t event,
+		     uint32_t level)
+{
+	json_lit(b, "{\"ts\":\"");
+	json_put(b, ts, ts_len);
+	json_lit(b, "\",\"seq\":");
+	json_u64(b, seq);
+	json_lit(b, ",\"type\":");
+	json_name(b, kalert_type_name(type));
+	json_lit(b, ",\"event\":");
+	json_name(b, &kalert_event_info(event)->name);
+	json_lit(b, ",\"id\":");
+	json_u64(b, event);
+	json_lit(b, ",\"level\":");
+	json_name(b, kalert_level_name(level));
+}
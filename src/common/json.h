@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: printf-free JSON Lines serializer for the event log
+ *
+ * Appends go straight into a caller buffer, typically a line of the
+ * event log claimed with kalert_event_reserve(). Type, event and level
+ * names are copied from the pre-quoted fragments of libkalert/events.h
+ * and integers are converted two digits at a time, so a line is built
+ * without parsing a format string or calling into stdio.
+ *
+ * A buffer that runs out of room stops taking appends and json_end()
+ * reports it, a line is emitted whole or not at all.
+ */
+
+#ifndef KALERT_JSON_H
+#define KALERT_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <libkalert/libkalert.h>
+
+struct json_buf {
+	char *start;
+	char *p;
+	char *end;
+	bool full;
+};
+
+static inline void json_init(struct json_buf *b, char *buf, size_t size)
+{
+	b->start = buf;
+	b->p = buf;
+	b->end = buf + size;
+	b->full = false;
+}
+
+/* Append @len bytes that need no escaping */
+static inline void json_put(struct json_buf *b, const char *s, size_t len)
+{
+	if ((size_t)(b->end - b->p) < len) {
+		b->full = true;
+		b->p = b->end;
+		return;
+	}
+	memcpy(b->p, s, len);
+	b->p += len;
+}
+
+/* Append a string literal, e.g. a key with its quotes and colon */
+#define json_lit(b, s) json_put((b), (s), sizeof(s) - 1)
+
+/* Append a name as a JSON string */
+static inline void json_name(struct json_buf *b, const struct kalert_name *n)
+{
+	json_put(b, n->json, n->json_len);
+}
+
+/**
+ * json_u64 - Append an unsigned integer
+ * @b: buffer
+ * @v: value
+ */
+void json_u64(struct json_buf *b, uint64_t v);
+
+/**
+ * json_event_head - Open the object of one notification line
+ * @b:      buffer
+ * @ts:     wall clock time, e.g. from kalert_event_time(); digits and
+ *          separators only, it is not escaped
+ * @ts_len: length of @ts
+ * @seq:    line sequence number
+ * @type:   notification type
+ * @event:  event id
+ * @level:  level
+ *
+ * Writes {"ts":"...","seq":N,"type":"...","event":"...","id":N,
+ * "level":"..." and leaves the object open for more members. Out of
+ * range values are named "unknown"; the event id is always there.
+ */
+void json_event_head(struct json_buf *b, const char *ts, size_t ts_len,
+		     uint64_t seq, uint32_t type, uint32_t event,
+		     uint32_t level);
+
+/**
+ * json_end - Close the object and end the line
+ * @b: buffer
+ *
+ * Returns the length of the line, or -1 if it did not fit.
+ */
+static inline int json_end(struct json_buf *b)
+{
+	json_lit(b, "}\n");
+	return b->full ? -1 : (int)(b->p - b->start);
+}
+
+#endif /* KALERT_JSON_H */
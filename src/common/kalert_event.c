@@ -4,65 +4,422 @@
  * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
  *
  * Description: kalert events logging implementation
+ *
+ * kalert_event() formats the line into a fixed size record of a lock-free
+ * single producer / single consumer ring and returns; it never touches the
+ * file. A writer thread takes the records in batches and hands them to the
+ * kernel with one writev(), pointing straight into the ring. When the ring
+ * is full the new record is dropped and counted, the event loop never
+ * waits for storage.
+ *
+ * The writer also rotates the file by size and age: the next file is
+ * created and preallocated beside the live one, the live file is
+ * hard-linked to <path>.1 and the new one renamed over <path>, so <path>
+ * always exists. At most the configured number of old files are kept.
  */
 
 #include "kalert_event.h"
-#include <stdio.h>
+#include "common.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
-#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+
+/* One formatted log line, longer lines are truncated */
+#define LOG_RECORD_SIZE 512
+#define LOG_RECORD_DATA \
+	(LOG_RECORD_SIZE - sizeof(uint64_t) - sizeof(uint32_t))
+
+/* Records in the ring, must be a power of two */
+#define LOG_RING_SIZE 4096
+
+/* The writer is woken early once the ring is this full */
+#define LOG_RING_WAKE (LOG_RING_SIZE / 4)
+
+/* Ring fill above which the producer reports backpressure */
+#define LOG_RING_PRESSURE (LOG_RING_SIZE / 4 * 3)
+
+/* Records per writev() */
+#define LOG_BATCH_MAX 256
+
+#define CACHELINE 64
+
+struct log_record {
+	uint64_t queued_ns; /* CLOCK_MONOTONIC, only with a latency hist */
+	uint32_t len;
+	char data[LOG_RECORD_DATA];
+};
+
+struct log_ring {
+	/* written by the producer only */
+	uint64_t head __attribute__((aligned(CACHELINE)));
+	uint64_t tail_cache; /* producer's last view of tail */
+
+	/* written by the writer thread only */
+	uint64_t tail __attribute__((aligned(CACHELINE)));
+
+	struct log_record rec[LOG_RING_SIZE]
+		__attribute__((aligned(CACHELINE)));
+};
+
+static struct log_ring ring;
+
+/* Set while the writer runs, checked by kalert_event() */
+static bool log_enabled;
+
+/* Log file and its descriptor, owned by the writer thread once started */
+static char *log_path;
+static int log_fd = -1;
+static uint64_t file_size;
+static time_t file_opened;
+
+/* Wakes the writer: early flush or shutdown */
+static int wake_fd = -1;
+
+static pthread_t writer;
+static bool writer_stop;
+
+/* Tunables, read by the writer on every batch */
+static unsigned int flush_interval_ms = KALERT_LOG_FLUSH_INTERVAL;
+static enum kalert_log_durability durability = KALERT_LOG_DURABLE_NONE;
+static uint64_t rotate_size = KALERT_LOG_MAX_SIZE;
+static unsigned int rotate_age;
+static unsigned int rotate_keep = KALERT_LOG_KEEP;
 
-/* File pointer for the log file */
-static FILE *fp = NULL;
+/* Queue to write latency, see kalert_event_log_latency() */
+static struct hist *latency;
+
+/* queued_ns of the records written since the last sync */
+static uint64_t queued_ns[LOG_RING_SIZE];
+static unsigned int nr_queued;
+
+/* Set by kalert_event_log_reopen(), cleared by the writer */
+static bool reopen_req;
+
+/* Counters, each one has a single writer thread */
+static struct kalert_log_stats stats;
 
 /* Use UTC time or local time for timestamps */
 static int use_utc = 0;
 
-/* Cached seconds for timestamp optimization */
-static time_t cached_sec = -1;
+/* Date and time of the current second, see ts_format() */
+static struct ts_cache log_ts = TS_CACHE_INIT;
 
-/* Cached formatted timestamp string */
-static char cached_ts[64];
-
-/* Internal: get timestamp string (cached per second) */
-static const char *get_ts(void)
+static uint64_t realtime_ns(void)
 {
 	struct timespec ts;
+
 	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define STAT_ADD(field, n) \
+	__atomic_add_fetch(&stats.field, (n), __ATOMIC_RELAXED)
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake_writer(void)
+{
+	uint64_t one = 1;
+
+	if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		STAT_ADD(write_errors, 1);
+}
+
+/*
+ * Open @path for appending, with blocks reserved up to the rotation size.
+ * @size returns the current length of the file.
+ */
+static int open_log_file(const char *path, int flags, uint64_t *size)
+{
+	uint64_t max = __atomic_load_n(&rotate_size, __ATOMIC_RELAXED);
+	struct stat st;
+	int fd;
 
-	/* Update cache only if seconds changed */
-	if (ts.tv_sec != cached_sec) {
-		cached_sec = ts.tv_sec;
-		struct tm tm;
+	fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC | flags,
+		  0644);
+	if (fd < 0)
+		return -1;
+
+	*size = fstat(fd, &st) == 0 ? st.st_size : 0;
+
+	/* best effort, not every filesystem supports it */
+	if (max > *size)
+		fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, max);
+	return fd;
+}
+
+/*
+ * Give back the blocks reserved past the end of a file we are leaving.
+ * The length is the file's own, an external copytruncate may have
+ * shortened it behind our back.
+ */
+static void close_log_file(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) < 0 || ftruncate(fd, st.st_size) < 0)
+		STAT_ADD(write_errors, 1);
+	close(fd);
+}
+
+/* Make @fd of length @size the live file */
+static void switch_log_file(int fd, uint64_t size)
+{
+	close_log_file(log_fd);
+	log_fd = fd;
+	file_size = size;
+	file_opened = time(NULL);
+}
+
+static void rotated_name(char *buf, size_t size, unsigned int i)
+{
+	snprintf(buf, size, "%s.%u", log_path, i);
+}
+
+/* Switch to a fresh file, see the comment at the top */
+static void rotate(void)
+{
+	unsigned int i, keep = __atomic_load_n(&rotate_keep, __ATOMIC_RELAXED);
+	char from[PATH_MAX], to[PATH_MAX], tmp[PATH_MAX];
+	uint64_t size;
+	int fd;
+
+	snprintf(tmp, sizeof(tmp), "%s.new", log_path);
+	unlink(tmp);
+	fd = open_log_file(tmp, O_EXCL, &size);
+	if (fd < 0) {
+		/* keep appending to the full file rather than lose lines */
+		STAT_ADD(write_errors, 1);
+		return;
+	}
+
+	for (i = keep; i > 1; i--) {
+		rotated_name(from, sizeof(from), i - 1);
+		rotated_name(to, sizeof(to), i);
+		rename(from, to);
+	}
+	rotated_name(to, sizeof(to), 1);
+	unlink(to);
+	if (keep && link(log_path, to) < 0)
+		STAT_ADD(write_errors, 1);
+
+	if (rename(tmp, log_path) < 0) {
+		close(fd);
+		unlink(tmp);
+		STAT_ADD(write_errors, 1);
+		return;
+	}
+
+	switch_log_file(fd, size);
+	STAT_ADD(rotations, 1);
+}
+
+static void maybe_rotate(uint64_t bytes)
+{
+	uint64_t max = __atomic_load_n(&rotate_size, __ATOMIC_RELAXED);
+	unsigned int age = __atomic_load_n(&rotate_age, __ATOMIC_RELAXED);
+	struct stat st;
 
-		if (use_utc)
-			gmtime_r(&cached_sec, &tm);
+	/* follow truncations by logrotate's copytruncate */
+	if (fstat(log_fd, &st) == 0)
+		file_size = st.st_size;
+	if (!file_size)
+		return;
+	if ((max && file_size + bytes > max) ||
+	    (age && time(NULL) - file_opened >= age))
+		rotate();
+}
+
+/* Reopen the path after an external tool moved the file away */
+static void reopen(void)
+{
+	uint64_t size;
+	int fd = open_log_file(log_path, 0, &size);
+
+	if (fd < 0) {
+		STAT_ADD(write_errors, 1);
+		return;
+	}
+	switch_log_file(fd, size);
+}
+
+/* Write @n records starting at ring index @tail, retrying short writes */
+static void write_batch(uint64_t tail, unsigned int n)
+{
+	struct iovec iov[LOG_BATCH_MAX];
+	struct iovec *v = iov;
+	struct log_record *r;
+	unsigned int i, cnt = n;
+	uint64_t bytes = 0, done = 0;
+	ssize_t rc;
+
+	for (i = 0; i < n; i++) {
+		r = &ring.rec[(tail + i) & (LOG_RING_SIZE - 1)];
+		iov[i].iov_base = r->data;
+		iov[i].iov_len = r->len;
+		bytes += r->len;
+		if (latency)
+			queued_ns[nr_queued++] = r->queued_ns;
+	}
+
+	maybe_rotate(bytes);
+
+	while (cnt) {
+		rc = writev(log_fd, v, cnt);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			/* the records are lost, keep the loop going */
+			STAT_ADD(write_errors, 1);
+			STAT_ADD(dropped, cnt);
+			file_size += done;
+			STAT_ADD(bytes, done);
+			return;
+		}
+		STAT_ADD(writev_calls, 1);
+		done += rc;
+
+		while (cnt && (size_t)rc >= v->iov_len) {
+			rc -= v->iov_len;
+			v++;
+			cnt--;
+		}
+		if (cnt) {
+			v->iov_base = (char *)v->iov_base + rc;
+			v->iov_len -= rc;
+		}
+	}
+
+	file_size += bytes;
+	STAT_ADD(written, n);
+	STAT_ADD(bytes, bytes);
+}
+
+/* Write everything queued so far, return the number of records */
+static unsigned int writer_drain(void)
+{
+	uint64_t head, tail, now;
+	unsigned int i, n, total = 0;
+
+	tail = ring.tail;
+	head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+
+	while (tail != head) {
+		n = head - tail < LOG_BATCH_MAX ? head - tail : LOG_BATCH_MAX;
+		write_batch(tail, n);
+		tail += n;
+		total += n;
+		/* slots can be reused once the kernel copied them */
+		__atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+	}
+
+	if (total &&
+	    __atomic_load_n(&durability, __ATOMIC_RELAXED) ==
+		    KALERT_LOG_DURABLE_BATCH) {
+		if (fdatasync(log_fd) < 0)
+			STAT_ADD(write_errors, 1);
 		else
-			localtime_r(&cached_sec, &tm);
+			STAT_ADD(syncs, 1);
+	}
+
+	/* durable or not, the lines are where the policy wants them now */
+	if (nr_queued) {
+		now = monotonic_ns();
+		for (i = 0; i < nr_queued; i++)
+			hist_record(latency, now - queued_ns[i]);
+		nr_queued = 0;
+	}
+
+	return total;
+}
+
+static void *writer_main(void *arg)
+{
+	struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+	unsigned int interval;
+	uint64_t val;
+
+	(void)arg;
 
-		snprintf(cached_ts, sizeof(cached_ts),
-			 "%04d-%02d-%02d %02d:%02d:%02d.%03ld",
-			 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-			 tm.tm_hour, tm.tm_min, tm.tm_sec,
-			 ts.tv_nsec / 1000000);
+	while (!__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE)) {
+		interval = __atomic_load_n(&flush_interval_ms,
+					   __ATOMIC_RELAXED);
+		if (poll(&pfd, 1, interval) > 0 &&
+		    read(wake_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+			STAT_ADD(write_errors, 1);
+		writer_drain();
+		if (__atomic_exchange_n(&reopen_req, false, __ATOMIC_ACQ_REL))
+			reopen();
 	}
 
-	return cached_ts;
+	/* records queued before kalert_event_log_close() still go out */
+	writer_drain();
+	return NULL;
 }
 
 /* Initialize event logging */
 int kalert_event_log_init(const char *path)
 {
-	if (fp)
+	if (log_enabled)
 		return 0;
 
 	if (!path)
 		return -1;
 
-	fp = fopen(path, "a");
-	if (!fp)
+	log_path = strdup(path);
+	if (!log_path)
 		return -1;
+
+	log_fd = open_log_file(path, 0, &file_size);
+	if (log_fd < 0)
+		goto err;
+	file_opened = time(NULL);
+
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0)
+		goto err;
+
+	writer_stop = false;
+	if (pthread_create(&writer, NULL, writer_main, NULL) != 0)
+		goto err;
+	__atomic_store_n(&log_enabled, true, __ATOMIC_RELEASE);
 	return 0;
+
+err:
+	if (wake_fd >= 0)
+		close(wake_fd);
+	if (log_fd >= 0)
+		close(log_fd);
+	free(log_path);
+	log_path = NULL;
+	wake_fd = -1;
+	log_fd = -1;
+	return -1;
+}
+
+/* Feed @h with the queue to write latency of every line */
+void kalert_event_log_latency(struct hist *h)
+{
+	latency = h;
 }
 
 /* Set UTC or local time mode */
@@ -71,27 +428,179 @@ void kalert_event_set_utc(int flag)
 	use_utc = flag;
 }
 
-/* Write event log message with timestamp */
-void kalert_event(const char *fmt, ...)
+/* Set the writer's flush interval and durability policy */
+void kalert_event_log_config(unsigned int flush_ms,
+			     enum kalert_log_durability policy)
 {
-	if (!fp)
+	__atomic_store_n(&flush_interval_ms, flush_ms ?: 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&durability, policy, __ATOMIC_RELAXED);
+}
+
+/* Set the size and age limits of the log file and the old files kept */
+void kalert_event_log_rotation(uint64_t max_size, unsigned int max_age,
+			       unsigned int keep)
+{
+	__atomic_store_n(&rotate_size, max_size, __ATOMIC_RELAXED);
+	__atomic_store_n(&rotate_age, max_age, __ATOMIC_RELAXED);
+	__atomic_store_n(&rotate_keep, keep, __ATOMIC_RELAXED);
+}
+
+/* Ask the writer to reopen the log path */
+void kalert_event_log_reopen(void)
+{
+	if (!log_enabled)
 		return;
 
-	fprintf(fp, "%s ", get_ts());
+	__atomic_store_n(&reopen_req, true, __ATOMIC_RELEASE);
+	wake_writer();
+}
+
+/* ring.head - ring.tail_cache at the last reservation */
+static uint64_t reserved_fill;
+
+/* Claim the record at ring.head, see kalert_event_reserve() */
+static struct log_record *ring_reserve(void)
+{
+	uint64_t head = ring.head;
+	uint64_t fill = head - ring.tail_cache;
 
+	if (fill >= LOG_RING_WAKE) {
+		/*
+		 * Exact from the wake mark on: with a stale tail the fill
+		 * could step over LOG_RING_WAKE and the writer would sleep
+		 * through a full ring until its flush interval.
+		 */
+		ring.tail_cache = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+		fill = head - ring.tail_cache;
+		if (fill >= LOG_RING_SIZE) {
+			STAT_ADD(overflows, 1);
+			return NULL;
+		}
+	}
+
+	reserved_fill = fill;
+	return &ring.rec[head & (LOG_RING_SIZE - 1)];
+}
+
+/* Publish the record claimed by ring_reserve() */
+static void ring_commit(struct log_record *r, size_t len)
+{
+	uint64_t fill = reserved_fill + 1;
+
+	r->len = len;
+	if (latency)
+		r->queued_ns = monotonic_ns();
+
+	__atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+	STAT_ADD(queued, 1);
+
+	if (fill > stats.max_fill)
+		__atomic_store_n(&stats.max_fill, fill, __ATOMIC_RELAXED);
+	if (fill == LOG_RING_PRESSURE)
+		STAT_ADD(pressure, 1);
+	if (fill == LOG_RING_WAKE)
+		wake_writer();
+}
+
+char *kalert_event_reserve(size_t *size)
+{
+	struct log_record *r;
+
+	if (!log_enabled)
+		return NULL;
+
+	r = ring_reserve();
+	if (!r)
+		return NULL;
+
+	*size = LOG_RECORD_DATA;
+	return r->data;
+}
+
+void kalert_event_commit(size_t len)
+{
+	struct log_record *r = &ring.rec[ring.head & (LOG_RING_SIZE - 1)];
+
+	if (len > LOG_RECORD_DATA)
+		len = LOG_RECORD_DATA;
+	ring_commit(r, len);
+}
+
+const char *kalert_event_time(uint64_t ts_ns, size_t *len)
+{
+	*len = TS_LEN;
+	return ts_format(&log_ts, ts_ns, use_utc);
+}
+
+/* Queue event log message with timestamp */
+void kalert_event(const char *fmt, ...)
+{
+	struct log_record *r;
 	va_list ap;
+	size_t len;
+	int n;
+
+	if (!log_enabled)
+		return;
+
+	r = ring_reserve();
+	if (!r)
+		return;
+
+	memcpy(r->data, ts_format(&log_ts, realtime_ns(), use_utc), TS_LEN);
+	len = TS_LEN;
+	r->data[len++] = ' ';
+
 	va_start(ap, fmt);
-	vfprintf(fp, fmt, ap);
+	n = vsnprintf(r->data + len, LOG_RECORD_DATA - len, fmt, ap);
 	va_end(ap);
 
-	fflush(fp);
+	if (n < 0)
+		n = 0;
+	len += n;
+	if (len >= LOG_RECORD_DATA) {
+		/* truncated, keep the line terminated */
+		len = LOG_RECORD_DATA - 1;
+		r->data[len - 1] = '\n';
+		STAT_ADD(truncated, 1);
+	}
+	ring_commit(r, len);
+}
+
+/* Snapshot of the writer counters */
+void kalert_event_get_stats(struct kalert_log_stats *out)
+{
+	out->queued = __atomic_load_n(&stats.queued, __ATOMIC_RELAXED);
+	out->written = __atomic_load_n(&stats.written, __ATOMIC_RELAXED);
+	out->bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+	out->writev_calls =
+		__atomic_load_n(&stats.writev_calls, __ATOMIC_RELAXED);
+	out->syncs = __atomic_load_n(&stats.syncs, __ATOMIC_RELAXED);
+	out->overflows = __atomic_load_n(&stats.overflows, __ATOMIC_RELAXED);
+	out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+	out->truncated = __atomic_load_n(&stats.truncated, __ATOMIC_RELAXED);
+	out->write_errors =
+		__atomic_load_n(&stats.write_errors, __ATOMIC_RELAXED);
+	out->pressure = __atomic_load_n(&stats.pressure, __ATOMIC_RELAXED);
+	out->max_fill = __atomic_load_n(&stats.max_fill, __ATOMIC_RELAXED);
+	out->rotations = __atomic_load_n(&stats.rotations, __ATOMIC_RELAXED);
 }
 
-/* Close event log file */
+/* Flush pending records and close event log file */
 void kalert_event_log_close(void)
 {
-	if (fp) {
-		fclose(fp);
-		fp = NULL;
-	}
+	if (!log_enabled)
+		return;
+
+	__atomic_store_n(&log_enabled, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&writer_stop, true, __ATOMIC_RELEASE);
+	wake_writer();
+	pthread_join(writer, NULL);
+
+	close(wake_fd);
+	close_log_file(log_fd);
+	free(log_path);
+	log_path = NULL;
+	wake_fd = -1;
+	log_fd = -1;
 }
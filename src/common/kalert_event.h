@@ -8,14 +8,66 @@
  *
  * Notes:
  *    Thread Safety: NOT thread-safe. Only one thread per process should
- *    write events.
+ *    write events. The file itself is written by a private writer thread
+ *    fed through a single producer / single consumer ring.
  */
 
 #ifndef KALERT_EVENT_H
 #define KALERT_EVENT_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/* Default maximum time a queued record waits for the writer, in ms */
+#define KALERT_LOG_FLUSH_INTERVAL 200
+
+/* Default rotation size in bytes and number of rotated files kept */
+#define KALERT_LOG_MAX_SIZE (64ULL << 20)
+#define KALERT_LOG_KEEP 5
+
+/**
+ * enum kalert_log_durability - when the writer forces data to disk
+ * @KALERT_LOG_DURABLE_NONE:  leave it to the page cache
+ * @KALERT_LOG_DURABLE_BATCH: fdatasync() after every flushed batch
+ */
+enum kalert_log_durability {
+	KALERT_LOG_DURABLE_NONE,
+	KALERT_LOG_DURABLE_BATCH,
+};
+
+/**
+ * struct kalert_log_stats - event log writer counters
+ * @queued:       records accepted by kalert_event()
+ * @written:      records handed to the kernel
+ * @bytes:        bytes written
+ * @writev_calls: writev() system calls
+ * @syncs:        successful fdatasync() calls
+ * @overflows:    records dropped because the ring was full
+ * @dropped:      records lost to write errors
+ * @truncated:    records cut to the record size
+ * @write_errors: failed writev(), fdatasync() or wakeups
+ * @pressure:     times the ring crossed 3/4 full
+ * @max_fill:     highest ring occupancy seen, in records
+ * @rotations:    log files rotated
+ */
+struct kalert_log_stats {
+	uint64_t queued;
+	uint64_t written;
+	uint64_t bytes;
+	uint64_t writev_calls;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t dropped;
+	uint64_t truncated;
+	uint64_t write_errors;
+	uint64_t pressure;
+	uint64_t max_fill;
+	uint64_t rotations;
+};
+
+struct hist;
+
 /**
  * kalert_event_log_init - Initialize event logging to a file
  * @path: Path to log file. If NULL, defaults to KALERT_EVENT_FILE
@@ -31,16 +83,95 @@ int kalert_event_log_init(const char *path);
 void kalert_event_set_utc(int flag);
 
 /**
- * kalert_event - Write formatted event message with timestamp
+ * kalert_event_log_config - Tune the background writer
+ * @flush_ms: longest time a record stays queued, in milliseconds
+ * @policy:   durability policy
+ *
+ * May be called at any time, the writer picks it up on its next wakeup.
+ */
+void kalert_event_log_config(unsigned int flush_ms,
+			     enum kalert_log_durability policy);
+
+/**
+ * kalert_event_log_rotation - Set the rotation policy
+ * @max_size: rotate before the file grows past this many bytes, 0 for no
+ *            limit. Also the amount of space preallocated per file.
+ * @max_age:  rotate files older than this many seconds, 0 for no limit
+ * @keep:     rotated files kept as <path>.1 (newest) to <path>.<keep>
+ *
+ * Rotation is done by the writer thread, so kalert_event() never waits
+ * for it. May be called at any time.
+ */
+void kalert_event_log_rotation(uint64_t max_size, unsigned int max_age,
+			       unsigned int keep);
+
+/**
+ * kalert_event_log_reopen - Reopen the log path
+ *
+ * For external tools that rename the file away. Asynchronous, lines
+ * already queued may still go to the old file.
+ */
+void kalert_event_log_reopen(void);
+
+/**
+ * kalert_event_log_latency - Measure how long lines wait for the file
+ * @h: histogram fed with the nanoseconds from kalert_event() returning
+ *     to the line being written, or synced under KALERT_LOG_DURABLE_BATCH;
+ *     NULL stops measuring
+ *
+ * Call before kalert_event_log_init().
+ */
+void kalert_event_log_latency(struct hist *h);
+
+/**
+ * kalert_event - Queue formatted event message with timestamp
  * @fmt: printf-style format string
  * @...: arguments
  *
- * Flushes after each write. NOT thread-safe.
+ * Never blocks on the file. The message is dropped and counted in
+ * kalert_log_stats.overflows if the writer is too far behind. NOT
+ * thread-safe.
  */
 void kalert_event(const char *fmt, ...);
 
 /**
- * kalert_event_log_close - Close the event log file
+ * kalert_event_reserve - Claim the next log line, to be built in place
+ * @size: output, room in the returned buffer
+ *
+ * For formatters that skip stdio, e.g. the JSON serializer. Unlike
+ * kalert_event() nothing is prepended. The line goes out once
+ * kalert_event_commit() is called; reserving again without committing
+ * hands back the same buffer. NOT thread-safe.
+ *
+ * Returns NULL if the log is closed or the writer is too far behind; the
+ * latter is counted in kalert_log_stats.overflows.
+ */
+char *kalert_event_reserve(size_t *size);
+
+/**
+ * kalert_event_commit - Queue the line claimed by kalert_event_reserve()
+ * @len: bytes written to the buffer, newline included
+ */
+void kalert_event_commit(size_t len);
+
+/**
+ * kalert_event_time - Format a time as kalert_event() prints it
+ * @ts_ns: CLOCK_REALTIME in ns, e.g. when the notification was received
+ * @len:   output, length of the string
+ *
+ * Returns "YYYY-MM-DD HH:MM:SS.mmm", in UTC if set by
+ * kalert_event_set_utc(). The buffer is reused by the next call.
+ */
+const char *kalert_event_time(uint64_t ts_ns, size_t *len);
+
+/**
+ * kalert_event_get_stats - Read the writer counters
+ * @stats: output
+ */
+void kalert_event_get_stats(struct kalert_log_stats *stats);
+
+/**
+ * kalert_event_log_close - Write out queued messages and close the log
  */
 void kalert_event_log_close(void);
 
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd counters and latency histograms, served in the
+ * Prometheus text format on a Unix socket
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+
+#include "common.h"
+#include "kalert_event.h"
+#include "metrics.h"
+
+#define REQUEST_MAX 1024
+
+struct metrics metrics;
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+/* Midpoint of the values counted in bucket @idx */
+static uint64_t hist_value(unsigned int idx)
+{
+	unsigned int e, shift;
+
+	if (idx < HIST_SUB)
+		return idx;
+
+	e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+	shift = e - HIST_SUB_BITS;
+	return ((uint64_t)(HIST_SUB + idx % HIST_SUB) << shift) +
+	       ((1ULL << shift) >> 1);
+}
+
+uint64_t hist_quantile(const struct hist *h, double q)
+{
+	uint64_t snap[HIST_BUCKETS];
+	uint64_t total = 0, rank, seen = 0;
+	unsigned int i;
+
+	/* count from the buckets, so the rank matches what is walked */
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		snap[i] = __atomic_load_n(&h->bucket[i], __ATOMIC_RELAXED);
+		total += snap[i];
+	}
+	if (!total)
+		return 0;
+
+	rank = q * total;
+	if (rank >= total)
+		rank = total - 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += snap[i];
+		if (seen > rank)
+			break;
+	}
+	return hist_value(i);
+}
+
+/* -------------------------- Exposition ---------------------------- */
+
+struct text {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static void __attribute__((format(printf, 2, 3)))
+text_add(struct text *t, const char *fmt, ...)
+{
+	va_list ap;
+	char *buf;
+	int n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(t->buf + t->len, t->size - t->len, fmt, ap);
+		va_end(ap);
+		if (n < 0)
+			return;
+		if ((size_t)n < t->size - t->len)
+			break;
+
+		buf = realloc(t->buf, t->size * 2);
+		if (!buf)
+			return; /* the tail of the page is lost */
+		t->buf = buf;
+		t->size *= 2;
+	}
+	t->len += n;
+}
+
+static void text_head(struct text *t, const char *name, const char *type,
+		      const char *help)
+{
+	text_add(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void text_counter(struct text *t, const char *name, const char *help,
+			 const uint64_t *v)
+{
+	text_head(t, name, "counter", help);
+	text_add(t, "%s %llu\n", name,
+		 (unsigned long long)__atomic_load_n(v, __ATOMIC_RELAXED));
+}
+
+static void text_value(struct text *t, const char *name, const char *type,
+		       const char *help, uint64_t v)
+{
+	text_head(t, name, type, help);
+	text_add(t, "%s %llu\n", name, (unsigned long long)v);
+}
+
+static void text_summary(struct text *t, const char *name, const char *help,
+			 const struct hist *h)
+{
+	unsigned int i;
+
+	text_head(t, name, "summary", help);
+	for (i = 0; i < KALERT_ARRAY_SIZE(quantiles); i++)
+		text_add(t, "%s{quantile=\"%g\"} %.9f\n", name, quantiles[i],
+			 hist_quantile(h, quantiles[i]) / 1e9);
+	text_add(t, "%s_sum %.9f\n%s_count %llu\n", name,
+		 __atomic_load_n(&h->sum, __ATOMIC_RELAXED) / 1e9, name,
+		 (unsigned long long)__atomic_load_n(&h->count,
+						     __ATOMIC_RELAXED));
+}
+
+static void render_notifications(struct text *t)
+{
+	const struct kalert_event_info *info;
+	uint64_t v;
+	unsigned int i;
+
+	text_head(t, "kalertd_notifications_total", "counter",
+		  "Notifications received from the kernel, by type.");
+	for (i = 1; i < KALERT_NOTIFY_MAX; i++)
+		text_add(t, "kalertd_notifications_total{type=%s} %llu\n",
+			 kalert_types[i].json,
+			 (unsigned long long)__atomic_load_n(
+				 &metrics.by_type[i], __ATOMIC_RELAXED));
+
+	text_head(t, "kalertd_notifications_by_level_total", "counter",
+		  "Notifications received from the kernel, by level.");
+	for (i = 1; i < KALERT_LEVEL_MAX; i++)
+		text_add(t,
+			 "kalertd_notifications_by_level_total{level=%s} %llu\n",
+			 kalert_levels[i].json,
+			 (unsigned long long)__atomic_load_n(
+				 &metrics.by_level[i], __ATOMIC_RELAXED));
+
+	/* only the events seen so far, there are KALERT_EVENT_MAX ids */
+	text_head(t, "kalertd_notifications_by_event_total", "counter",
+		  "Notifications received from the kernel, by event.");
+	for (i = 0; i < KALERT_EVENT_MAX; i++) {
+		v = __atomic_load_n(&metrics.by_event[i], __ATOMIC_RELAXED);
+		if (!v)
+			continue;
+		info = &kalert_events[i];
+		text_add(t,
+			 "kalertd_notifications_by_event_total{id=\"%u\",event=%s} %llu\n",
+			 KALERT_EVENT_BASE + i, info->name.json,
+			 (unsigned long long)v);
+	}
+	text_counter(t, "kalertd_notifications_unknown_event_total",
+		     "Notifications with an event id outside the event range.",
+		     &metrics.unknown_event);
+}
+
+static void render(struct text *t)
+{
+	struct kalert_log_stats log;
+
+	render_notifications(t);
+
+	text_counter(t, "kalertd_rate_limited_total",
+		     "Notifications kept out of the text log by the rate limits.",
+		     &metrics.rate_limited);
+	text_counter(t, "kalertd_coalesced_total",
+		     "Notifications folded into storm summaries of the text log.",
+		     &metrics.coalesced);
+	text_counter(t, "kalertd_kernel_lost_total",
+		     "Notifications the kernel failed to send, last reported.",
+		     &metrics.kernel_lost);
+	text_counter(t, "kalertd_socket_overruns_total",
+		     "Receive buffer overflows of the kalert socket.",
+		     &metrics.socket_overruns);
+	text_value(t, "kalertd_kernel_backlog", "gauge",
+		   "Notifications waiting in the kernel, last reported.",
+		   __atomic_load_n(&metrics.kernel_backlog, __ATOMIC_RELAXED));
+
+	kalert_event_get_stats(&log);
+	text_value(t, "kalertd_log_queued_total", "counter",
+		   "Lines queued to the text log.", log.queued);
+	text_value(t, "kalertd_log_written_total", "counter",
+		   "Lines written to the text log.", log.written);
+	text_value(t, "kalertd_log_bytes_total", "counter",
+		   "Bytes written to the text log.", log.bytes);
+	text_value(t, "kalertd_log_overflows_total", "counter",
+		   "Lines dropped because the log ring was full.",
+		   log.overflows);
+	text_value(t, "kalertd_log_dropped_total", "counter",
+		   "Lines lost to write errors.", log.dropped);
+	text_value(t, "kalertd_log_write_errors_total", "counter",
+		   "Failed writes, syncs and wakeups of the log writer.",
+		   log.write_errors);
+	text_value(t, "kalertd_log_syncs_total", "counter",
+		   "fdatasync() calls of the log writer.", log.syncs);
+	text_value(t, "kalertd_log_rotations_total", "counter",
+		   "Text log files rotated.", log.rotations);
+	text_value(t, "kalertd_log_ring_max_fill", "gauge",
+		   "Highest occupancy of the log ring, in lines.",
+		   log.max_fill);
+
+	text_summary(t, "kalertd_receive_to_format_seconds",
+		     "From receipt to the log line being queued.",
+		     &metrics.recv_format);
+	text_summary(t, "kalertd_format_to_write_seconds",
+		     "From the log line being queued to written, or synced when durable.",
+		     &metrics.format_write);
+}
+
+/* -------------------------- Socket server ------------------------- */
+
+static struct {
+	int fd;
+	pthread_t thread;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+} server = { .fd = -1 };
+
+static void serve_client(int fd)
+{
+	static const char http[] =
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n\r\n";
+	struct timeval tv = { .tv_usec = 100000 };
+	struct text t = { .size = 16384 };
+	char req[REQUEST_MAX];
+	ssize_t rc;
+
+	/* HTTP clients speak first, bare readers get the text on timeout */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	tv.tv_sec = 1;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	rc = recv(fd, req, sizeof(req), 0);
+
+	t.buf = malloc(t.size);
+	if (!t.buf)
+		return;
+	render(&t);
+
+	if (rc >= 4 && memcmp(req, "GET ", 4) == 0 &&
+	    send_all(fd, http, sizeof(http) - 1) < 0)
+		goto out;
+	send_all(fd, t.buf, t.len);
+out:
+	free(t.buf);
+}
+
+static void *server_main(void *arg)
+{
+	int fd;
+
+	(void)arg;
+
+	for (;;) {
+		fd = accept4(server.fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break; /* shut down by metrics_server_stop() */
+		}
+		serve_client(fd);
+		close(fd);
+	}
+	return NULL;
+}
+
+int metrics_server_start(const char *path)
+{
+	if (server.fd >= 0)
+		return 0;
+
+	server.fd = unix_listen(path, 0660);
+	if (server.fd < 0)
+		return -1;
+
+	snprintf(server.path, sizeof(server.path), "%s", path);
+	errno = pthread_create(&server.thread, NULL, server_main, NULL);
+	if (errno) {
+		close(server.fd);
+		server.fd = -1;
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+void metrics_server_stop(void)
+{
+	if (server.fd < 0)
+		return;
+
+	/* makes the blocked accept4() fail */
+	shutdown(server.fd, SHUT_RDWR);
+	pthread_join(server.thread, NULL);
+	close(server.fd);
+	unlink(server.path);
+	server.fd = -1;
+}
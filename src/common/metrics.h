@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd counters and latency histograms, served in the
+ * Prometheus text format on a Unix socket
+ *
+ * Every metric is a plain integer updated with relaxed atomics by the
+ * thread that owns the event; there is no lock anywhere. A server thread
+ * renders a snapshot for each connection, so a scrape costs the event
+ * path nothing but the cache misses of the counters it reads.
+ *
+ * Histograms are log-linear in the style of HdrHistogram: values below
+ * 16 get a bucket each, every power of two above is split into 16
+ * buckets, so quantiles come out within about 3% from 976 counters
+ * covering the whole 64-bit range.
+ *
+ * A connection that sends an HTTP GET first gets an HTTP/1.0 answer,
+ * anything else gets the bare text, e.g. for socat.
+ */
+
+#ifndef KALERT_METRICS_H
+#define KALERT_METRICS_H
+
+#include <stdint.h>
+#include <linux/kalert.h>
+
+#define METRICS_SOCKET "/run/kalertd/metrics.sock"
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t bucket[HIST_BUCKETS];
+};
+
+struct metrics {
+	/* notifications received from the channel */
+	uint64_t by_type[KALERT_NOTIFY_MAX];
+	uint64_t by_level[KALERT_LEVEL_MAX];
+	uint64_t by_event[KALERT_EVENT_MAX];
+	uint64_t unknown_event;
+
+	/* dropped or folded before the text log */
+	uint64_t rate_limited;
+	uint64_t coalesced;
+
+	/* loss reported by the kernel and the socket, absolute values */
+	uint64_t kernel_lost;
+	uint64_t socket_overruns;
+	uint64_t kernel_backlog;
+
+	/* receipt to line queued, line queued to written (or synced) */
+	struct hist recv_format;
+	struct hist format_write;
+};
+
+extern struct metrics metrics;
+
+#define METRIC_INC(m) __atomic_add_fetch(&(m), 1, __ATOMIC_RELAXED)
+#define METRIC_SET(m, v) __atomic_store_n(&(m), (v), __ATOMIC_RELAXED)
+
+static inline unsigned int hist_index(uint64_t v)
+{
+	unsigned int e;
+
+	if (v < HIST_SUB)
+		return v;
+	e = 63 - __builtin_clzll(v);
+	return (e - HIST_SUB_BITS + 1) * HIST_SUB +
+	       ((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Record one value, from any thread */
+static inline void hist_record(struct hist *h, uint64_t v)
+{
+	__atomic_add_fetch(&h->bucket[hist_index(v)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->sum, v, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * hist_quantile - Estimate a quantile of a histogram
+ * @h: histogram, may be updated concurrently
+ * @q: quantile, 0 to 1
+ *
+ * Returns the midpoint of the bucket holding the quantile, 0 if empty.
+ */
+uint64_t hist_quantile(const struct hist *h, double q);
+
+/**
+ * metrics_server_start - Serve the metrics on a Unix socket
+ * @path: socket path, replaced if it exists
+ *
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int metrics_server_start(const char *path);
+
+/**
+ * metrics_server_stop - Stop the server thread and remove the socket
+ */
+void metrics_server_stop(void);
+
+#endif /* KALERT_METRICS_H */
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd's path of a received notification to its outputs
+ */
+
+#include <time.h>
+#include <libkalert/binlog.h>
+#include <libkalert/broker.h>
+
+#include "json.h"
+#include "kalert_event.h"
+#include "metrics.h"
+#include "notify_log.h"
+#include "ratelimit.h"
+#include "recent.h"
+
+static uint64_t clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void notify_log_line(struct notify_log *nl, uint64_t ts_ns, uint32_t type,
+		     uint32_t event, uint32_t level,
+		     const struct coalesce_entry *summary)
+{
+	struct json_buf b;
+	const char *ts;
+	size_t size, ts_len;
+	char *buf;
+	int len;
+
+	buf = kalert_event_reserve(&size);
+	if (!buf)
+		return;
+
+	ts = kalert_event_time(ts_ns, &ts_len);
+	json_init(&b, buf, size);
+	json_event_head(&b, ts, ts_len, nl->seq, type, event, level);
+	if (summary) {
+		json_lit(&b, ",\"repeated\":");
+		json_u64(&b, summary->count);
+		json_lit(&b, ",\"first_ns\":");
+		json_u64(&b, summary->first_ns);
+		json_lit(&b, ",\"last_ns\":");
+		json_u64(&b, summary->last_ns);
+	}
+
+	len = json_end(&b);
+	if (len < 0)
+		return;
+	kalert_event_commit(len);
+	nl->seq++;
+}
+
+void notify_log(const struct kalert_notify_msg *notify, void *data)
+{
+	struct notify_log *nl = data;
+	uint64_t mono_ns = clock_ns(CLOCK_MONOTONIC);
+	/* when the socket received it, not when we got around to it */
+	uint64_t real_ns = kalert_dispatch_ts(nl->h) ?: clock_ns(CLOCK_REALTIME);
+	uint32_t idx = notify->event - KALERT_EVENT_BASE;
+	uint64_t now_ns;
+
+	nl->last_ns = mono_ns;
+	METRIC_INC(metrics.by_type[notify->type]);
+	METRIC_INC(metrics.by_level[notify->level]);
+	if (idx < KALERT_EVENT_MAX)
+		METRIC_INC(metrics.by_event[idx]);
+	else
+		METRIC_INC(metrics.unknown_event);
+
+	/* queries see everything, including what the budgets drop below */
+	if (nl->recent && nl->recent->rec)
+		recent_add(nl->recent, real_ns, notify->type, notify->event,
+			   notify->level);
+
+	/* readers apply their own budgets, they get the raw channel */
+	if (nl->broker)
+		kalert_broker_publish(nl->broker, real_ns, notify);
+
+	/* the binary log is cheap enough to keep every notification */
+	if (nl->binlog)
+		kalert_binlog_append(nl->binlog, real_ns, notify);
+
+	if (!rl_allow(nl->limiter, notify->type, notify->event, notify->level,
+		      mono_ns)) {
+		METRIC_INC(metrics.rate_limited);
+		return;
+	}
+
+	if (!nl->text)
+		return;
+
+	if (!coalesce_event(nl->storm, notify->type, notify->event,
+			    notify->level, mono_ns, real_ns)) {
+		METRIC_INC(metrics.coalesced);
+		return;
+	}
+
+	notify_log_line(nl, real_ns, notify->type, notify->event,
+			notify->level, NULL);
+
+	/* from the socket's receipt stamp, a clock step back counts as 0 */
+	now_ns = clock_ns(CLOCK_REALTIME);
+	hist_record(&metrics.recv_format,
+		    now_ns > real_ns ? now_ns - real_ns : 0);
+}
+
+/* One line for the repeats of a key folded during a coalescing window */
+void notify_log_summary(const struct coalesce_entry *e, void *data)
+{
+	notify_log_line(data, clock_ns(CLOCK_REALTIME), e->type, e->event,
+			e->level, e);
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: kalertd's path of a received notification to its outputs
+ *
+ * Every notification is counted, kept for queries, republished to the
+ * broker and appended to the binary log. Only then are the rate limits
+ * checked, and storm coalescing applied, before the text log line is
+ * queued. Shared by kalertd and the event benchmark, so the benchmark
+ * times the daemon's own path.
+ *
+ * Notes:
+ *    Thread Safety: NOT thread-safe, driven from the kalertd event loop.
+ */
+
+#ifndef KALERT_NOTIFY_LOG_H
+#define KALERT_NOTIFY_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libkalert/libkalert.h>
+
+#include "coalesce.h"
+
+struct kalert_binlog;
+struct kalert_broker;
+struct rate_limiter;
+struct recent_ring;
+
+struct notify_log {
+	struct kalert_handle *h; /* receipt stamps, see kalert_dispatch_ts() */
+	struct rate_limiter *limiter;
+	struct coalescer *storm;
+	struct recent_ring *recent; /* NULL, or unused until set up */
+	struct kalert_broker *broker; /* NULL unless BROKER_EVENTS */
+	struct kalert_binlog *binlog; /* NULL unless LOG_FORMAT selects it */
+	bool text; /* write the text event log */
+	uint64_t seq; /* sequence number of the event log lines */
+	uint64_t last_ns; /* CLOCK_MONOTONIC of the last notification */
+};
+
+/**
+ * notify_log_line - Queue one JSON line to the text log
+ * @nl:      notification path
+ * @ts_ns:   CLOCK_REALTIME printed in the line
+ * @type:    notification type
+ * @event:   event id
+ * @level:   level
+ * @summary: repeats of a coalesced storm, or NULL
+ *
+ * The line is built in place in the log ring.
+ */
+void notify_log_line(struct notify_log *nl, uint64_t ts_ns, uint32_t type,
+		     uint32_t event, uint32_t level,
+		     const struct coalesce_entry *summary);
+
+/**
+ * notify_log - Dispatch callback, @data is the struct notify_log
+ * @notify: notification
+ * @data:   notification path
+ */
+void notify_log(const struct kalert_notify_msg *notify, void *data);
+
+/**
+ * notify_log_summary - Coalescer callback, @data is the struct notify_log
+ * @e:    summary of a storm
+ * @data: notification path
+ */
+void notify_log_summary(const struct coalesce_entry *e, void *data);
+
+#endif /* KALERT_NOTIFY_LOG_H */
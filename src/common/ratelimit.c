@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Token bucket budgets per notification type and event
+ *
+ * Credit is kept in tokens * 1e9 so refilling is one multiplication of
+ * the elapsed nanoseconds by the rate, without division or floating
+ * point on the notification path.
+ */
+
+#include <string.h>
+
+#include "ratelimit.h"
+
+#define TOKEN 1000000000ULL
+
+void rl_init(struct rate_limiter *rl, uint32_t exempt_level)
+{
+	memset(rl, 0, sizeof(*rl));
+	rl->exempt_level = exempt_level;
+}
+
+void rl_set(struct token_bucket *tb, uint32_t rate, uint32_t burst)
+{
+	uint64_t cap;
+
+	burst = burst ?: rate;
+	cap = (uint64_t)burst * TOKEN;
+
+	/* a reload must not hand a storm a fresh burst */
+	if (!tb->rate) {
+		tb->credit = cap;
+		tb->last_ns = 0;
+	} else if (tb->credit > cap) {
+		tb->credit = cap;
+	}
+
+	tb->rate = rate;
+	tb->burst = burst;
+	tb->fill_ns = rate ? cap / rate : 0;
+}
+
+/* Refill @tb up to now, return whether it holds a token */
+static bool tb_refill(struct token_bucket *tb, uint64_t now_ns)
+{
+	uint64_t cap = (uint64_t)tb->burst * TOKEN;
+	uint64_t elapsed;
+
+	if (!tb->last_ns) {
+		tb->last_ns = now_ns;
+		return tb->credit >= TOKEN;
+	}
+
+	elapsed = now_ns - tb->last_ns;
+	tb->last_ns = now_ns;
+
+	/*
+	 * Long enough to fill it from empty: just fill it up. Below that
+	 * elapsed * rate is less than cap, nothing can overflow.
+	 */
+	if (elapsed >= tb->fill_ns) {
+		tb->credit = cap;
+	} else {
+		tb->credit += elapsed * tb->rate;
+		if (tb->credit > cap)
+			tb->credit = cap;
+	}
+
+	return tb->credit >= TOKEN;
+}
+
+bool rl_allow(struct rate_limiter *rl, uint32_t type, uint32_t event,
+	      uint32_t level, uint64_t now_ns)
+{
+	struct token_bucket *tb_type = NULL, *tb_event = NULL;
+	uint32_t idx = event - KALERT_EVENT_BASE;
+
+	if (level >= rl->exempt_level) {
+		rl->exempted++;
+		return true;
+	}
+
+	if (idx < KALERT_EVENT_MAX && rl->event[idx].rate)
+		tb_event = &rl->event[idx];
+	if (type < KALERT_NOTIFY_MAX && rl->type[type].rate)
+		tb_type = &rl->type[type];
+
+	/* charge the drop to the bucket that refused it */
+	if (tb_event && !tb_refill(tb_event, now_ns)) {
+		tb_event->dropped++;
+		rl->dropped++;
+		return false;
+	}
+	if (tb_type && !tb_refill(tb_type, now_ns)) {
+		tb_type->dropped++;
+		rl->dropped++;
+		return false;
+	}
+
+	if (tb_event) {
+		tb_event->credit -= TOKEN;
+		tb_event->passed++;
+	}
+	if (tb_type) {
+		tb_type->credit -= TOKEN;
+		tb_type->passed++;
+	}
+	return true;
+}
+
+static void tb_report(struct token_bucket *tb, const char *what,
+		      const char *name)
+{
+	if (tb->dropped == tb->reported)
+		return;
+
+	kalert_msg(LOG_WARNING,
+		   "kalert rate limit dropped %llu %s \"%s\" notifications (%u/s, burst %u)",
+		   (unsigned long long)(tb->dropped - tb->reported), what, name,
+		   tb->rate, tb->burst);
+	tb->reported = tb->dropped;
+}
+
+void rl_report(struct rate_limiter *rl)
+{
+	unsigned int i;
+
+	if (!rl->dropped)
+		return;
+
+	for (i = 0; i < KALERT_NOTIFY_MAX; i++)
+		tb_report(&rl->type[i], "type", kalert_type_name(i)->str);
+	for (i = 0; i < KALERT_EVENT_MAX; i++)
+		tb_report(&rl->event[i], "event",
+			  kalert_event_name(KALERT_EVENT_BASE + i));
+}
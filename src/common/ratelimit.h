@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Token bucket budgets per notification type and event
+ *
+ * Every type, and optionally every event id, may have a bucket of
+ * @burst tokens refilled at @rate tokens per second. A notification
+ * takes one token from its event bucket and one from its type bucket,
+ * and is dropped if either is empty. Levels at or above the exempt
+ * level are never limited, so a storm of one type cannot crowd out the
+ * fatal alerts of another.
+ *
+ * Notes:
+ *    Thread Safety: NOT thread-safe, driven from the kalertd event loop.
+ */
+
+#ifndef KALERT_RATELIMIT_H
+#define KALERT_RATELIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libkalert/libkalert.h>
+
+struct token_bucket {
+	uint32_t rate; /* tokens per second, 0 for no limit */
+	uint32_t burst; /* bucket size in tokens */
+	uint64_t credit; /* tokens scaled by 1e9, see rl_allow() */
+	uint64_t fill_ns; /* time to refill from empty, set by rl_set() */
+	uint64_t last_ns; /* last refill, CLOCK_MONOTONIC */
+	uint64_t passed;
+	uint64_t dropped;
+	uint64_t reported; /* dropped at the last rl_report() */
+};
+
+struct rate_limiter {
+	uint32_t exempt_level; /* levels at or above pass unconditionally */
+	uint64_t exempted;
+	uint64_t dropped; /* total, each drop is counted once */
+	struct token_bucket type[KALERT_NOTIFY_MAX];
+	struct token_bucket event[KALERT_EVENT_MAX];
+};
+
+/**
+ * rl_init - Remove every limit and reset the counters
+ * @rl:           rate limiter
+ * @exempt_level: lowest level that is never limited, KALERT_LEVEL_MAX
+ *                to limit every level
+ */
+void rl_init(struct rate_limiter *rl, uint32_t exempt_level);
+
+/**
+ * rl_set - Configure one bucket
+ * @tb:    bucket, &rl->type[type] or &rl->event[event - KALERT_EVENT_BASE]
+ * @rate:  tokens per second, 0 removes the limit
+ * @burst: bucket size, 0 means @rate
+ *
+ * A bucket that had no limit starts full, one that had keeps its credit,
+ * capped at the new size. Its counters are kept.
+ */
+void rl_set(struct token_bucket *tb, uint32_t rate, uint32_t burst);
+
+/**
+ * rl_allow - Check the budget of a notification and take a token
+ * @rl:     rate limiter
+ * @type:   notification type
+ * @event:  event id
+ * @level:  level
+ * @now_ns: CLOCK_MONOTONIC now
+ *
+ * Return: false if the notification must be dropped, it is counted.
+ */
+bool rl_allow(struct rate_limiter *rl, uint32_t type, uint32_t event,
+	      uint32_t level, uint64_t now_ns);
+
+/**
+ * rl_report - Log the drops of every bucket since the last report
+ */
+void rl_report(struct rate_limiter *rl);
+
+#endif /* KALERT_RATELIMIT_H */
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Ring of recent notifications and its query socket
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+
+#include "common.h"
+#include "recent.h"
+
+/* Records copied out of the ring between two checks of head */
+#define RECENT_CHUNK 64
+
+#define REQUEST_MAX 512
+
+int recent_init(struct recent_ring *r, unsigned int capacity)
+{
+	uint64_t cap = 1;
+
+	while (cap < capacity)
+		cap <<= 1;
+
+	r->rec = calloc(cap, sizeof(*r->rec));
+	if (!r->rec)
+		return -1;
+	r->mask = cap - 1;
+	r->head = 0;
+	return 0;
+}
+
+void recent_add(struct recent_ring *r, uint64_t ts_ns, uint32_t type,
+		uint32_t event, uint32_t level)
+{
+	uint64_t h = r->head;
+	struct kalert_binlog_record *rec = &r->rec[h & r->mask];
+
+	/*
+	 * Order the previous publication before overwriting the slot, so a
+	 * reader that sees the new bytes also sees head past this slot.
+	 */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	rec->ts_ns = ts_ns;
+	rec->seq = h;
+	rec->type = type;
+	rec->event = event;
+	rec->level = level;
+	rec->flags = 0;
+
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+static bool recent_match(const struct kalert_binlog_record *rec,
+			 const struct recent_query *q)
+{
+	if (rec->ts_ns < q->from_ns || (q->to_ns && rec->ts_ns >= q->to_ns))
+		return false;
+	if (q->type && rec->type != q->type)
+		return false;
+	if (q->event && rec->event != q->event)
+		return false;
+	return rec->level >= q->min_level;
+}
+
+uint64_t recent_query(const struct recent_ring *r,
+		      const struct recent_query *q,
+		      struct kalert_binlog_record *out, uint32_t *n)
+{
+	struct kalert_binlog_record chunk[RECENT_CHUNK];
+	uint64_t cap = r->mask + 1;
+	uint64_t head, oldest, idx, matched = 0;
+	uint32_t i, cnt, stored = 0;
+
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	oldest = head > cap ? head - cap : 0;
+
+	/* newest first, so the limit keeps the most recent matches */
+	for (idx = head; idx > oldest; idx -= cnt) {
+		cnt = idx - oldest < RECENT_CHUNK ? idx - oldest : RECENT_CHUNK;
+		for (i = 0; i < cnt; i++)
+			chunk[i] = r->rec[(idx - 1 - i) & r->mask];
+
+		/* slots the writer reached meanwhile hold newer records */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+		for (i = 0; i < cnt; i++) {
+			if (idx - 1 - i + cap <= head)
+				goto out;
+			if (!recent_match(&chunk[i], q))
+				continue;
+			matched++;
+			if (!q->count_only && stored < q->limit)
+				out[stored++] = chunk[i];
+		}
+	}
+
+out:
+	/* back to arrival order */
+	for (i = 0; i < stored / 2; i++) {
+		chunk[0] = out[i];
+		out[i] = out[stored - 1 - i];
+		out[stored - 1 - i] = chunk[0];
+	}
+	if (n)
+		*n = stored;
+	return matched;
+}
+
+/* ---------------------------- Query socket ---------------------------- */
+
+static struct {
+	struct recent_ring *ring;
+	int fd;
+	pthread_t thread;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+} server = { .fd = -1 };
+
+static int parse_request(char *line, struct recent_query *q)
+{
+	struct timespec now;
+	char *tok, *save, *val;
+	unsigned long long v;
+
+	memset(q, 0, sizeof(*q));
+	q->limit = RECENT_QUERY_LIMIT;
+
+	for (tok = strtok_r(line, " \t\r\n", &save); tok;
+	     tok = strtok_r(NULL, " \t\r\n", &save)) {
+		if (strcmp(tok, "count") == 0) {
+			q->count_only = true;
+			continue;
+		}
+
+		val = strchr(tok, '=');
+		if (!val)
+			return -1;
+		*val++ = '\0';
+		v = strtoull(val, NULL, 0);
+
+		if (strcmp(tok, "from") == 0) {
+			q->from_ns = v * 1000000000;
+		} else if (strcmp(tok, "to") == 0) {
+			q->to_ns = v * 1000000000;
+		} else if (strcmp(tok, "last") == 0) {
+			clock_gettime(CLOCK_REALTIME, &now);
+			v = v < (unsigned long long)now.tv_sec ? v : now.tv_sec;
+			q->from_ns = (now.tv_sec - v) * 1000000000ULL;
+		} else if (strcmp(tok, "type") == 0) {
+			q->type = v;
+		} else if (strcmp(tok, "event") == 0) {
+			q->event = v;
+		} else if (strcmp(tok, "level") == 0) {
+			q->min_level = v;
+		} else if (strcmp(tok, "limit") == 0) {
+			q->limit = v < RECENT_QUERY_LIMIT_MAX ?
+					   v : RECENT_QUERY_LIMIT_MAX;
+		} else {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void serve_client(int fd)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	struct kalert_binlog_record *rec = NULL;
+	char req[REQUEST_MAX], buf[8192];
+	struct recent_query q;
+	uint64_t matched;
+	uint32_t i, n = 0;
+	size_t len = 0;
+	ssize_t rc;
+
+	/* a stuck client must not hold the query thread */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	while (len < sizeof(req) - 1) {
+		rc = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+		if (rc <= 0)
+			break;
+		len += rc;
+		if (memchr(req + len - rc, '\n', rc))
+			break;
+	}
+	req[len] = '\0';
+
+	if (parse_request(req, &q) < 0) {
+		send_all(fd, "ERR bad request\n", 16);
+		return;
+	}
+
+	if (!q.count_only && q.limit) {
+		rec = malloc(q.limit * sizeof(*rec));
+		if (!rec) {
+			send_all(fd, "ERR out of memory\n", 18);
+			return;
+		}
+	}
+	if (!rec)
+		q.count_only = true;
+
+	matched = recent_query(server.ring, &q, rec, &n);
+
+	len = snprintf(buf, sizeof(buf), "OK %llu %u\n",
+		       (unsigned long long)matched, n);
+	for (i = 0; i < n; i++) {
+		if (sizeof(buf) - len < 128) {
+			if (send_all(fd, buf, len) < 0)
+				goto out;
+			len = 0;
+		}
+		len += snprintf(buf + len, sizeof(buf) - len,
+				"%llu %llu %u %u %u\n",
+				(unsigned long long)rec[i].seq,
+				(unsigned long long)rec[i].ts_ns, rec[i].type,
+				rec[i].event, rec[i].level);
+	}
+	send_all(fd, buf, len);
+out:
+	free(rec);
+}
+
+static void *server_main(void *arg)
+{
+	int fd;
+
+	(void)arg;
+
+	for (;;) {
+		fd = accept4(server.fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break; /* shut down by recent_server_stop() */
+		}
+		serve_client(fd);
+		close(fd);
+	}
+	return NULL;
+}
+
+int recent_server_start(struct recent_ring *r, const char *path)
+{
+	if (server.fd >= 0)
+		return 0;
+
+	server.fd = unix_listen(path, 0600);
+	if (server.fd < 0)
+		return -1;
+
+	server.ring = r;
+	snprintf(server.path, sizeof(server.path), "%s", path);
+	errno = pthread_create(&server.thread, NULL, server_main, NULL);
+	if (errno) {
+		close(server.fd);
+		server.fd = -1;
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+void recent_server_stop(void)
+{
+	if (server.fd < 0)
+		return;
+
+	/* makes the blocked accept4() fail */
+	shutdown(server.fd, SHUT_RDWR);
+	pthread_join(server.thread, NULL);
+	close(server.fd);
+	unlink(server.path);
+	server.fd = -1;
+}
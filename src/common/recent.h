@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Ring of recent notifications and its query socket
+ *
+ * The event loop appends binary log records to a fixed power of two
+ * ring and publishes them by bumping head with release semantics. A
+ * query thread answers requests on a Unix socket by copying records out
+ * of the ring without any lock; copies of slots overwritten meanwhile are
+ * detected by reading head again and discarded, so ingestion never waits
+ * for a query.
+ *
+ * Protocol, one request line per connection:
+ *
+ *   [from=<epoch s>] [to=<epoch s>] [last=<s>] [type=<n>] [event=<id>]
+ *   [level=<min level>] [limit=<n>] [count]
+ *
+ * answered by "OK <matched> <returned>" followed by <returned> lines
+ * "<seq> <ts_ns> <type> <event> <level>" of the newest matches in
+ * arrival order, or by "ERR <reason>". With "count" no record is
+ * returned.
+ *
+ * Notes:
+ *    Thread Safety: recent_add() from one thread, queries from any.
+ */
+
+#ifndef KALERT_RECENT_H
+#define KALERT_RECENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libkalert/binlog.h>
+
+#define RECENT_QUERY_SOCKET "/run/kalertd/query.sock"
+
+/* Records returned by default, and at most */
+#define RECENT_QUERY_LIMIT 1000
+#define RECENT_QUERY_LIMIT_MAX 65536
+
+struct recent_ring {
+	struct kalert_binlog_record *rec;
+	uint64_t mask; /* capacity - 1 */
+	uint64_t head; /* records ever added */
+};
+
+struct recent_query {
+	uint64_t from_ns; /* CLOCK_REALTIME, inclusive */
+	uint64_t to_ns; /* CLOCK_REALTIME, exclusive, 0 for no bound */
+	uint32_t type; /* 0 for any */
+	uint32_t event; /* 0 for any */
+	uint32_t min_level;
+	uint32_t limit; /* records returned */
+	bool count_only;
+};
+
+/**
+ * recent_init - Allocate the ring
+ * @r:        ring
+ * @capacity: records kept, rounded up to a power of two
+ *
+ * Returns 0 on success, -1 on allocation failure.
+ */
+int recent_init(struct recent_ring *r, unsigned int capacity);
+
+/**
+ * recent_add - Append a record, overwriting the oldest once full
+ */
+void recent_add(struct recent_ring *r, uint64_t ts_ns, uint32_t type,
+		uint32_t event, uint32_t level);
+
+/**
+ * recent_query - Find the newest records matching @q
+ * @r:   ring
+ * @q:   filter
+ * @out: room for q->limit records, returned oldest first; unused with
+ *       q->count_only
+ * @n:   records stored in @out
+ *
+ * Returns the number of matching records in the ring, which may exceed
+ * *@n.
+ */
+uint64_t recent_query(const struct recent_ring *r,
+		      const struct recent_query *q,
+		      struct kalert_binlog_record *out, uint32_t *n);
+
+/**
+ * recent_server_start - Serve queries on a Unix socket from a new thread
+ * @r:    ring
+ * @path: socket path, replaced if it exists
+ *
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int recent_server_start(struct recent_ring *r, const char *path);
+
+/**
+ * recent_server_stop - Stop the query thread and remove the socket
+ */
+void recent_server_stop(void);
+
+#endif /* KALERT_RECENT_H */
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Print a binary kalert event log as the text event log
+ *
+ * Usage: kalertcat [-u] [-c] [path...]
+ *
+ * Each path is a log directory or a single segment file, the default is
+ * the directory kalertd writes to. Lines are the JSON Lines of
+ * /var/log/kalert_event.log, with the record seq in the "seq" field.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+#include <libkalert/libkalert.h>
+#include <libkalert/binlog.h>
+
+#include "common/common.h"
+#include "common/json.h"
+
+#define KALERT_BINLOG_DIR "/var/log/kalert"
+
+static bool use_utc;
+static bool count_only;
+static unsigned long long nr_records;
+
+static int print_record(const struct kalert_binlog_record *rec, void *data)
+{
+	char line[256];
+	struct json_buf b;
+	const char *ts;
+	int len;
+
+	nr_records++;
+	if (count_only)
+		return 0;
+
+	ts = format_ts(rec->ts_ns, use_utc);
+	json_init(&b, line, sizeof(line));
+	json_event_head(&b, ts, TS_LEN, rec->seq, rec->type, rec->event,
+			rec->level);
+	len = json_end(&b);
+	if (len > 0)
+		fwrite(line, 1, len, stdout);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-u] [-c] [path...]\n"
+		"  -u  print timestamps in UTC\n"
+		"  -c  only count the records\n"
+		"  path  log directory or segment file, default %s\n",
+		prog, KALERT_BINLOG_DIR);
+}
+
+static int cat_path(const char *path)
+{
+	int rc = kalert_binlog_scan(path, print_record, NULL);
+
+	if (rc < 0)
+		fprintf(stderr, "%s: %s\n", path, strerror(-rc));
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	static char obuf[1 << 16];
+	int opt, rc = 0;
+
+	while ((opt = getopt(argc, argv, "uch")) != -1) {
+		switch (opt) {
+		case 'u':
+			use_utc = true;
+			break;
+		case 'c':
+			count_only = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+
+	if (optind == argc)
+		rc = cat_path(KALERT_BINLOG_DIR);
+	for (; optind < argc; optind++) {
+		if (cat_path(argv[optind]) < 0)
+			rc = -1;
+	}
+
+	if (count_only)
+		printf("%llu\n", nr_records);
+	return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Query the notifications kalertd saw recently
+ *
+ * Usage: kalertctl [-s socket] [-l seconds | -f from] [-t to] [-T type]
+ *                  [-e event] [-L level] [-n limit] [-c] [-u]
+ *
+ * Talks the line protocol of src/common/recent.h. Records are printed as
+ * the JSON Lines of the text event log, with the ring seq in "seq".
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+
+#include "common/common.h"
+#include "common/recent.h"
+#include "common/json.h"
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -s socket   query socket, default %s\n"
+		"  -l seconds  only the last seconds, default 600\n"
+		"  -f from     from this epoch second\n"
+		"  -t to       up to this epoch second\n"
+		"  -T type     type name or number\n"
+		"  -e event    event name ('_' for spaces) or id\n"
+		"  -L level    minimum level name or number\n"
+		"  -n limit    newest records returned, default %u\n"
+		"  -c          only count the matches\n"
+		"  -u          print timestamps in UTC\n",
+		prog, RECENT_QUERY_SOCKET, RECENT_QUERY_LIMIT);
+}
+
+/* Append to the filters of the query, a query that does not fit fails */
+static void query_add(char *buf, size_t size, size_t *len,
+		      const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf + *len, size - *len, fmt, ap);
+	va_end(ap);
+
+	if (n < 0 || (size_t)n >= size - *len) {
+		fprintf(stderr, "query too long\n");
+		exit(1);
+	}
+	*len += n;
+}
+
+static int connect_socket(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long\n");
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* "<seq> <ts_ns> <type> <event> <level>" to an event log line */
+static int print_record(const char *line, bool utc)
+{
+	unsigned long long seq, ts;
+	unsigned int type, event, level;
+	char out[256];
+	struct json_buf b;
+	const char *time;
+	int len;
+
+	if (sscanf(line, "%llu %llu %u %u %u", &seq, &ts, &type, &event,
+		   &level) != 5)
+		return -1;
+
+	time = format_ts(ts, utc);
+	json_init(&b, out, sizeof(out));
+	json_event_head(&b, time, TS_LEN, seq, type, event, level);
+	len = json_end(&b);
+	if (len > 0)
+		fwrite(out, 1, len, stdout);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *sock = RECENT_QUERY_SOCKET;
+	const char *window = "last", *window_val = "600";
+	char filters[256], req[320], line[256];
+	unsigned long long matched;
+	unsigned int returned;
+	size_t flen = 0, len = 0;
+	bool utc = false, count = false;
+	FILE *fp;
+	int opt, fd, v;
+
+	filters[0] = '\0';
+	while ((opt = getopt(argc, argv, "s:l:f:t:T:e:L:n:cuh")) != -1) {
+		switch (opt) {
+		case 's':
+			sock = optarg;
+			continue;
+		case 'u':
+			utc = true;
+			continue;
+		case 'l':
+			window = "last";
+			window_val = optarg;
+			continue;
+		case 'f':
+			/* replaces the default window */
+			window = "from";
+			window_val = optarg;
+			continue;
+		case 't':
+			query_add(filters, sizeof(filters), &flen, " to=%s",
+				  optarg);
+			continue;
+		case 'T':
+			v = parse_type(optarg);
+			if (v <= 0) {
+				fprintf(stderr, "unknown type %s\n", optarg);
+				return 1;
+			}
+			query_add(filters, sizeof(filters), &flen, " type=%d",
+				  v);
+			continue;
+		case 'e':
+			v = parse_event(optarg);
+			if (v < 0) {
+				fprintf(stderr, "unknown event %s\n", optarg);
+				return 1;
+			}
+			query_add(filters, sizeof(filters), &flen, " event=%d",
+				  v);
+			continue;
+		case 'L':
+			v = parse_level(optarg);
+			if (v < 0) {
+				fprintf(stderr, "unknown level %s\n", optarg);
+				return 1;
+			}
+			query_add(filters, sizeof(filters), &flen, " level=%d",
+				  v);
+			continue;
+		case 'n':
+			query_add(filters, sizeof(filters), &flen, " limit=%s",
+				  optarg);
+			continue;
+		case 'c':
+			query_add(filters, sizeof(filters), &flen, " count");
+			count = true;
+			continue;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	query_add(req, sizeof(req), &len, "%s=%s%s\n", window, window_val,
+		  filters);
+
+	fd = connect_socket(sock);
+	if (fd < 0)
+		return 1;
+
+	if (send(fd, req, len, MSG_NOSIGNAL) != (ssize_t)len) {
+		perror("send");
+		close(fd);
+		return 1;
+	}
+
+	fp = fdopen(fd, "r");
+	if (!fp || !fgets(line, sizeof(line), fp)) {
+		fprintf(stderr, "no reply from kalertd\n");
+		return 1;
+	}
+
+	if (sscanf(line, "OK %llu %u", &matched, &returned) != 2) {
+		fprintf(stderr, "kalertd: %s", line);
+		fclose(fp);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), fp))
+		print_record(line, utc);
+
+	if (count)
+		printf("%llu\n", matched);
+	else if (returned < matched)
+		fprintf(stderr, "%llu matches, newest %u shown\n", matched,
+			returned);
+
+	fclose(fp);
+	return 0;
+}
@@ -6,20 +6,61 @@
  * Description: Main daemon for Kalert
  */
 
+#include <limits.h>
 #include <stdio.h>
+#include <time.h>
 #include <libkalert/libkalert.h>
+#include <libkalert/binlog.h>
+#include <libkalert/broker.h>
+#include <libkalert/statpage.h>
 #include <ev.h>
 
 #include "common/kalert_event.h"
 #include "common/common.h"
+#include "common/heartbeat.h"
+#include "common/coalesce.h"
+#include "common/ratelimit.h"
+#include "common/recent.h"
+#include "common/metrics.h"
+#include "common/notify_log.h"
 
-static int sock_fd;
-static int msg_count;
+static struct kalert_handle *kh;
+/* filtered consumer of the handle that feeds notify_log() */
+static int log_consumer = -1;
+
+/* path of every notification to the logs, the broker and the queries */
+static struct notify_log nlog;
 
 static struct ev_loop *loop;
 static struct ev_io netlink_watcher;
 static struct ev_signal sigterm_watcher;
 static struct ev_signal sighup_watcher;
+static struct ev_timer heartbeat_watcher;
+
+static struct ev_timer status_watcher;
+static struct ev_timer coalesce_watcher;
+static struct ev_io broker_watcher;
+static struct ev_timer stats_page_watcher;
+
+/* folds notification storms into summaries in the text log */
+static struct coalescer storm;
+
+/* hard per type and per event budgets, checked before any output */
+static struct rate_limiter limiter;
+
+/* every notification seen lately, served on the query socket */
+static struct recent_ring recent;
+
+/* stats page mapped by local readers, NULL unless STATS_PAGE is set */
+static struct kalert_statpage *stats_page;
+static uint64_t started_ns;
+
+static struct hb_monitor hb;
+
+/* last channel status from the kernel, refreshed by the status poll */
+static struct kalert_status chnl_status;
+static uint64_t chnl_status_ns;
+static uint64_t hb_last_resync_ns;
 
 /* Use UTC or local time for event log  */
 bool g_flag_utc = false;
@@ -27,11 +68,130 @@ bool g_flag_utc = false;
 /* kalertd event filter level */
 int g_event_level;
 
+/* kalert channel backlog limit, 0 keeps the kernel default */
+uint32_t g_backlog_limit;
+
+/* netlink socket receive buffer in bytes, 0 keeps the system default */
+int g_recv_buffer_size;
+
+/* expected kernel heartbeat period in ms, 0 disables the liveness monitor */
+unsigned int g_heartbeat_interval = 10000;
+
+/* heartbeat periods missed before the channel is considered stalled */
+unsigned int g_heartbeat_misses = 3;
+
+/* channel status poll period in ms, 0 disables polling */
+unsigned int g_status_interval = 5000;
+
+/* longest time an event line waits for the log writer, in ms */
+unsigned int g_log_flush_interval = KALERT_LOG_FLUSH_INTERVAL;
+
+/* whether the log writer fdatasync()s its batches */
+enum kalert_log_durability g_log_durability = KALERT_LOG_DURABLE_NONE;
+
+/* event log outputs, LOG_FORMAT="text", "binary" or "both" */
+bool g_log_text = true;
+bool g_log_binary;
+
+/* rate limits from RATE_LIMIT_* keys, rate 0 means no limit */
+struct rate_conf {
+	uint32_t rate;
+	uint32_t burst;
+};
+
+struct rate_conf g_rate_type[KALERT_NOTIFY_MAX];
+struct rate_conf g_rate_event[KALERT_EVENT_MAX];
+
+/* notifications at or above this level are never rate limited */
+uint32_t g_rate_exempt_level = KALERT_FATAL;
+
+/* records kept for queries, 0 disables; read at startup only */
+unsigned int g_recent_events = 65536;
+
+/* query socket path, empty disables; read at startup only */
+char g_query_socket[PATH_MAX] = RECENT_QUERY_SOCKET;
+
+/* metrics socket path, empty disables; read at startup only */
+char g_metrics_socket[PATH_MAX] = METRICS_SOCKET;
+
+/* records in the broker ring, 0 disables; read at startup only */
+unsigned int g_broker_events;
+
+/* broker socket path; read at startup only */
+char g_broker_socket[PATH_MAX] = KALERT_BROKER_SOCKET;
+
+/* stats page path, empty disables; read at startup only */
+char g_stats_page[PATH_MAX] = KALERT_STATPAGE_PATH;
+
+/* stats page refresh period in ms, 0 disables the refresh */
+unsigned int g_stats_page_interval = 1000;
+
+/* storm coalescing window of the text log in ms, 0 disables */
+unsigned int g_coalesce_window = 1000;
+
+/* event log rotation size in bytes and age in seconds, 0 disables */
+uint64_t g_log_max_size = KALERT_LOG_MAX_SIZE;
+unsigned int g_log_max_age;
+
+/* rotated event log files or binary segments kept */
+unsigned int g_log_keep = KALERT_LOG_KEEP;
+
+/* binary event log directory and segment size in bytes */
+char g_log_binary_dir[PATH_MAX] = "/var/log/kalert";
+size_t g_log_segment_size = KALERT_BINLOG_SEGMENT_SIZE;
+
 #define KALERT_EVENT_LOG_FILE "/var/log/kalert_event.log"
 #define KALERTD_CONF_FILE "/etc/kalert/kalertd.conf"
 
+/* "rate[/burst]" in notifications per second */
+static void parse_rate(const char *val, struct rate_conf *rc)
+{
+	char *end;
+
+	rc->rate = strtoul(val, &end, 0);
+	rc->burst = *end == '/' ? strtoul(end + 1, NULL, 0) : 0;
+}
+
+/* RATE_LIMIT_<TYPE>, RATE_LIMIT_EVENT_<EVENT>, RATE_LIMIT_EXEMPT_LEVEL */
+static bool parse_rate_limit(const char *key, const char *val)
+{
+	int type, idx, level;
+
+	if (strcmp(key, "EXEMPT_LEVEL") == 0) {
+		level = parse_level(val);
+		if (level < 0) {
+			kalert_msg(LOG_WARNING,
+				   "Unknown level %s in RATE_LIMIT_%s", val, key);
+			return false;
+		}
+		g_rate_exempt_level = level;
+		return true;
+	}
+
+	if (strncmp(key, "EVENT_", 6) == 0) {
+		idx = parse_event(key + 6) - KALERT_EVENT_BASE;
+		if (idx < 0 || idx >= KALERT_EVENT_MAX) {
+			kalert_msg(LOG_WARNING, "Unknown event in RATE_LIMIT_%s",
+				   key);
+			return false;
+		}
+		parse_rate(val, &g_rate_event[idx]);
+		return true;
+	}
+
+	type = parse_type(key);
+	if (type < 0) {
+		kalert_msg(LOG_WARNING, "Unknown type in RATE_LIMIT_%s", key);
+		return false;
+	}
+	parse_rate(val, &g_rate_type[type]);
+	return true;
+}
+
 bool parse_main_conf_line(const char *key, const char *val)
 {
+	int level;
+
 	if (strcmp(key, "UTC_TIME") == 0) {
 		g_flag_utc = (strcasecmp(val, "on") == 0);
 		return true;
@@ -39,27 +199,164 @@ bool parse_main_conf_line(const char *key, const char *val)
 
 	if (strcmp(key, "KALERT_EVENT_LEVEL") == 0) {
 		/* val may be string or number */
-		if (strcasecmp(val, "ALL") == 0)
-			g_event_level = 0;
-		else if (strcasecmp(val, "INFO") == 0)
-			g_event_level = 1;
-		else if (strcasecmp(val, "WARN") == 0)
-			g_event_level = 2;
-		else if (strcasecmp(val, "ERROR") == 0)
-			g_event_level = 3;
-		else if (strcasecmp(val, "FATAL") == 0)
-			g_event_level = 4;
+		level = parse_level(val);
+		if (level < 0) {
+			kalert_msg(LOG_WARNING, "Unknown level %s", val);
+			return false;
+		}
+		g_event_level = level;
+		return true;
+	}
+
+	if (strncmp(key, "RATE_LIMIT_", 11) == 0)
+		return parse_rate_limit(key + 11, val);
+
+	if (strcmp(key, "KALERT_BACKLOG_LIMIT") == 0) {
+		g_backlog_limit = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "RECV_BUFFER_SIZE") == 0) {
+		g_recv_buffer_size = atoi(val);
+		return true;
+	}
+
+	if (strcmp(key, "HEARTBEAT_INTERVAL") == 0) {
+		g_heartbeat_interval = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "STATUS_POLL_INTERVAL") == 0) {
+		g_status_interval = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "HEARTBEAT_MISSES") == 0) {
+		g_heartbeat_misses = strtoul(val, NULL, 0) ?: 1;
+		return true;
+	}
+
+	if (strcmp(key, "LOG_FLUSH_INTERVAL") == 0) {
+		g_log_flush_interval = strtoul(val, NULL, 0) ?: 1;
+		return true;
+	}
+
+	if (strcmp(key, "RECENT_EVENTS") == 0) {
+		g_recent_events = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "QUERY_SOCKET") == 0) {
+		snprintf(g_query_socket, sizeof(g_query_socket), "%s", val);
+		return true;
+	}
+
+	if (strcmp(key, "METRICS_SOCKET") == 0) {
+		snprintf(g_metrics_socket, sizeof(g_metrics_socket), "%s", val);
+		return true;
+	}
+
+	if (strcmp(key, "BROKER_EVENTS") == 0) {
+		g_broker_events = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "BROKER_SOCKET") == 0) {
+		snprintf(g_broker_socket, sizeof(g_broker_socket), "%s", val);
+		return true;
+	}
+
+	if (strcmp(key, "STATS_PAGE") == 0) {
+		snprintf(g_stats_page, sizeof(g_stats_page), "%s", val);
+		return true;
+	}
+
+	if (strcmp(key, "STATS_PAGE_INTERVAL") == 0) {
+		g_stats_page_interval = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "COALESCE_WINDOW") == 0) {
+		g_coalesce_window = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_MAX_SIZE") == 0) {
+		g_log_max_size = strtoull(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_MAX_AGE") == 0) {
+		g_log_max_age = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_KEEP") == 0) {
+		g_log_keep = strtoul(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_FORMAT") == 0) {
+		g_log_text = strcasecmp(val, "binary") != 0;
+		g_log_binary = strcasecmp(val, "binary") == 0 ||
+			       strcasecmp(val, "both") == 0;
+		return true;
+	}
+
+	if (strcmp(key, "LOG_BINARY_DIR") == 0) {
+		snprintf(g_log_binary_dir, sizeof(g_log_binary_dir), "%s", val);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_SEGMENT_SIZE") == 0) {
+		g_log_segment_size = strtoull(val, NULL, 0);
+		return true;
+	}
+
+	if (strcmp(key, "LOG_DURABILITY") == 0) {
+		if (strcasecmp(val, "batch") == 0)
+			g_log_durability = KALERT_LOG_DURABLE_BATCH;
 		else
-			g_event_level = atoi(val); /* numeric fallback */
+			g_log_durability = KALERT_LOG_DURABLE_NONE;
 		return true;
 	}
 
 	return false;
 }
 
+/* Push the channel settings of the configuration to the kernel */
+static void apply_channel_config(void)
+{
+	struct kalert_batch batch;
+	uint64_t attr[KALERT_ATTR_MAX];
+
+	/* One request per parameter so a bad value does not block the rest */
+	if (log_consumer >= 0)
+		kalert_consumer_set_level(kh, log_consumer, g_event_level);
+
+	kalert_batch_init(&batch);
+	attr[KALERT_FILTER_LEVEL] = g_event_level;
+	kalert_batch_add_parameter(&batch, KALERT_MASK(KALERT_FILTER_LEVEL),
+				   attr);
+	if (g_backlog_limit) {
+		attr[KALERT_BACKLOG_LIMIT] = g_backlog_limit;
+		kalert_batch_add_parameter(&batch,
+					   KALERT_MASK(KALERT_BACKLOG_LIMIT),
+					   attr);
+	}
+	kalert_handle_batch_commit(kh, &batch);
+}
+
 /* Load kalertd configuration safely into global g_cfg */
 bool load_kalertd_config(void)
 {
+	unsigned int i;
+
+	/* limits dropped from the file must go away on reload */
+	memset(g_rate_type, 0, sizeof(g_rate_type));
+	memset(g_rate_event, 0, sizeof(g_rate_event));
+	g_rate_exempt_level = KALERT_FATAL;
+
 	if (!parse_config(KALERTD_CONF_FILE, parse_main_conf_line)) {
 		kalert_msg(LOG_ERR,
 			   "Failed to parse config, using previous values\n");
@@ -67,55 +364,439 @@ bool load_kalertd_config(void)
 	}
 
 	kalert_event_set_utc(g_flag_utc);
+	kalert_event_log_config(g_log_flush_interval, g_log_durability);
+	kalert_event_log_rotation(g_log_max_size, g_log_max_age, g_log_keep);
+
+	limiter.exempt_level = g_rate_exempt_level;
+	for (i = 0; i < KALERT_NOTIFY_MAX; i++)
+		rl_set(&limiter.type[i], g_rate_type[i].rate,
+		       g_rate_type[i].burst);
+	for (i = 0; i < KALERT_EVENT_MAX; i++)
+		rl_set(&limiter.event[i], g_rate_event[i].rate,
+		       g_rate_event[i].burst);
+
+	if (g_recv_buffer_size > 0) {
+		int rc = kalert_handle_set_rcvbuf(kh, g_recv_buffer_size);
+
+		if (rc < 0)
+			kalert_msg(LOG_WARNING,
+				   "Failed to set receive buffer size (%s)",
+				   strerror(-rc));
+		else
+			kalert_msg(LOG_INFO,
+				   "Receive buffer %d bytes (requested %d)", rc,
+				   g_recv_buffer_size);
+	}
 
-	kalert_set_filter_level(sock_fd, g_event_level);
+	apply_channel_config();
 	return true;
 }
 
-void parse_notify_message(struct kalert_message *reply)
+static uint64_t monotonic_ns(void)
 {
-	struct kalert_notify_msg *notify;
-	const char *type_str, *level_str, *event_str;
+	struct timespec ts;
 
-	notify = NLMSG_DATA(&reply->nlh);
-	if (!kalert_notify_valid(notify))
-		return;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-	type_str = kalert_type_str[notify->type];
-	level_str = kalert_level_str[notify->level];
-	event_str = kalert_event_name(notify->event);
+static uint64_t realtime_ns(void)
+{
+	struct timespec ts;
 
-	switch (notify->type) {
-	case KALERT_NOTIFY_MEM:
-	case KALERT_NOTIFY_GEN:
-	case KALERT_NOTIFY_IO:
-	case KALERT_NOTIFY_FS:
-	case KALERT_NOTIFY_SCHED:
-	case KALERT_NOTIFY_NET:
-	case KALERT_NOTIFY_RAS:
-	case KALERT_NOTIFY_VIRT:
-	case KALERT_NOTIFY_SEC: {
-		kalert_event(
-			"{\"ts\":%llu,\"type\":%s,\"event\":%s,\"level\":%s}\n",
-			msg_count++, type_str, event_str, level_str);
-		break;
-	}
-	case KALERT_NOTIFY_ALL:
-		break;
-	default:
-		kalert_event(
-			"{\"ts\":%llu,\"type\":\"unknow\",\"event\":%s,\"level\":%s}\n",
-			msg_count++, event_str, level_str);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void heartbeat_notify(const struct kalert_notify_msg *notify,
+			     void *data)
+{
+	hb_record(&hb, monotonic_ns());
+}
+
+static void register_callbacks(void)
+{
+	kalert_dispatch_on_event(kh, KALERT_EVENT_HEARTBEAT, heartbeat_notify,
+				 NULL);
+
+	/* every event, the level follows KALERT_EVENT_LEVEL */
+	log_consumer = kalert_consumer_add(kh, NULL, 0, g_event_level,
+					   notify_log, &nlog);
+	if (log_consumer < 0)
+		kalert_msg(LOG_ERR, "Failed to register the log consumer (%s)",
+			   strerror(-log_consumer));
+}
+
+/*
+ * Report notifications lost since the last call: receive buffer overruns
+ * and parked queue drops on our side, next to the kernel's packloss
+ * counter from the last status snapshot.
+ */
+static void report_loss(void)
+{
+	static struct kalert_loss_stats last;
+	struct kalert_loss_stats stats;
+
+	kalert_handle_get_loss_stats(kh, &stats, false);
+	if (chnl_status.mask & KALERT_MASK(KALERT_PACKLOSS_COUNT)) {
+		stats.kernel_valid = true;
+		stats.kernel_packloss = chnl_status.packloss_count;
 	}
+
+	if (stats.overruns == last.overruns &&
+	    stats.queue_dropped == last.queue_dropped &&
+	    stats.kernel_packloss == last.kernel_packloss)
+		return;
+
+	if (stats.kernel_valid)
+		kalert_msg(LOG_WARNING,
+			   "kalert notifications lost: %llu receive buffer overruns, %llu dropped while waiting for ACK, kernel packloss %llu",
+			   (unsigned long long)stats.overruns,
+			   (unsigned long long)stats.queue_dropped,
+			   (unsigned long long)stats.kernel_packloss);
+	else
+		kalert_msg(LOG_WARNING,
+			   "kalert notifications lost: %llu receive buffer overruns, %llu dropped while waiting for ACK",
+			   (unsigned long long)stats.overruns,
+			   (unsigned long long)stats.queue_dropped);
+	last = stats;
+}
+
+/* Report event log lines dropped since the last call */
+static void report_log_loss(void)
+{
+	static struct kalert_log_stats last;
+	struct kalert_log_stats stats;
+
+	kalert_event_get_stats(&stats);
+	if (stats.overflows == last.overflows &&
+	    stats.dropped == last.dropped)
+		return;
+
+	kalert_msg(LOG_WARNING,
+		   "kalert event log lost %llu lines to a full ring (peak %llu queued, %llu near-full), %llu to write errors",
+		   (unsigned long long)(stats.overflows - last.overflows),
+		   (unsigned long long)stats.max_fill,
+		   (unsigned long long)stats.pressure,
+		   (unsigned long long)(stats.dropped - last.dropped));
+	last = stats;
 }
 
 /* ---------------------- Netlink event Handler ----------------- */
+static void netlink_drain(void)
+{
+	struct kalert_loss_stats before, after;
+
+	/*
+	 * kalert_dispatch() keeps draining past a receive queue overflow,
+	 * what was still queued is intact. Account the loss afterwards.
+	 */
+	kalert_handle_get_loss_stats(kh, &before, false);
+	kalert_dispatch(kh, 0);
+	kalert_handle_get_loss_stats(kh, &after, false);
+
+	/* one wakeup per reader for the whole batch */
+	if (nlog.broker)
+		kalert_broker_wake(nlog.broker);
+
+	if (nlog.binlog && g_log_durability == KALERT_LOG_DURABLE_BATCH)
+		kalert_binlog_sync(nlog.binlog);
+
+	METRIC_SET(metrics.socket_overruns, after.overruns);
+
+	/* the loss is reported once the kernel's counter came back */
+	if (after.overruns != before.overruns)
+		kalert_handle_request_status(kh, KALERT_STATUS_ALL);
+}
+
 static void netlink_handler(struct ev_loop *loop, struct ev_io *w, int revents)
 {
-	struct kalert_message reply;
+	netlink_drain();
+}
+
+/* ---------------------- Heartbeat Monitor -------------------- */
+/*
+ * Heartbeats stopped: the kernel may have lost our port (module reload,
+ * another receiver took the channel, ...). Register again and push the
+ * configuration, at most once per stall window until heartbeats resume.
+ */
+static void heartbeat_handler(struct ev_loop *loop, struct ev_timer *w,
+			      int revents)
+{
+	uint64_t now = monotonic_ns();
+	uint64_t window = hb.period_ns * g_heartbeat_misses;
+	int rc;
+
+	if (!hb_stalled(&hb, now, g_heartbeat_misses))
+		return;
+	if (hb_last_resync_ns > hb.last_ns && now - hb_last_resync_ns < window)
+		return;
+
+	hb.stalls++;
+	hb_last_resync_ns = now;
+	kalert_msg(LOG_WARNING,
+		   "No kalert heartbeat for %llu ms, resetting the channel",
+		   (unsigned long long)((now - hb.last_ns) / 1000000));
+
+	rc = kalert_handle_setup_channel(kh);
+	if (rc == 0)
+		apply_channel_config();
+
+	/* anything parked during the resync would not wake the loop */
+	netlink_drain();
+}
+
+static void heartbeat_monitor_update(void)
+{
+	double period = g_heartbeat_interval / 1000.0;
 
-	while (kalert_get_reply(sock_fd, &reply, GET_REPLY_NONBLOCKING, 0) > 0)
-		parse_notify_message(&reply);
+	hb.period_ns = (uint64_t)g_heartbeat_interval * 1000000;
+	ev_timer_stop(loop, &heartbeat_watcher);
+	if (!g_heartbeat_interval)
+		return;
+	ev_timer_set(&heartbeat_watcher, period, period);
+	ev_timer_start(loop, &heartbeat_watcher);
+}
+
+/* ---------------------- Channel Status Poll ------------------ */
+/*
+ * The request goes out without waiting; the reply comes back through the
+ * netlink watcher and kalert_dispatch(), so polling never stalls the
+ * drain path.
+ */
+static void status_handler(struct ev_loop *loop, struct ev_timer *w,
+			   int revents)
+{
+	kalert_handle_request_status(kh, KALERT_STATUS_ALL);
+}
+
+static void status_notify(const struct kalert_status *st, void *data)
+{
+	static bool backlog_high;
+	bool high;
+
+	chnl_status = *st;
+	chnl_status_ns = monotonic_ns();
+
+	if (st->mask & KALERT_MASK(KALERT_PACKLOSS_COUNT))
+		METRIC_SET(metrics.kernel_lost, st->packloss_count);
+	if (st->mask & KALERT_MASK(KALERT_BACKLOG_DEPTH))
+		METRIC_SET(metrics.kernel_backlog, st->backlog_depth);
+
+	/* warn once each time the kernel backlog nears its limit */
+	high = st->backlog_limit &&
+	       st->backlog_depth >= st->backlog_limit / 10 * 9;
+	if (high && !backlog_high)
+		kalert_msg(LOG_WARNING,
+			   "kalert kernel backlog at %u of %u notifications",
+			   st->backlog_depth, st->backlog_limit);
+	backlog_high = high;
+
+	report_loss();
+	report_log_loss();
+	rl_report(&limiter);
+}
+
+static void status_poll_update(void)
+{
+	double period = g_status_interval / 1000.0;
+
+	ev_timer_stop(loop, &status_watcher);
+	if (!g_status_interval)
+		return;
+	ev_timer_set(&status_watcher, period, period);
+	ev_timer_start(loop, &status_watcher);
+}
+
+/* ---------------------- Storm Coalescing --------------------- */
+static void coalesce_handler(struct ev_loop *loop, struct ev_timer *w,
+			     int revents)
+{
+	coalesce_flush(&storm, monotonic_ns(), false, notify_log_summary,
+		       &nlog);
+}
+
+/* Apply a new window, the summaries pending under the old one go out */
+static void coalesce_update(void)
+{
+	double period = g_coalesce_window / 1000.0;
+
+	coalesce_flush(&storm, monotonic_ns(), true, notify_log_summary,
+		       &nlog);
+	storm.window_ns = (uint64_t)g_coalesce_window * 1000000;
+
+	ev_timer_stop(loop, &coalesce_watcher);
+	if (!g_coalesce_window)
+		return;
+	ev_timer_set(&coalesce_watcher, period, period);
+	ev_timer_start(loop, &coalesce_watcher);
+}
+
+/* Open or close the text and binary event logs as configured */
+static void log_outputs_update(void)
+{
+	if (g_log_text && kalert_event_log_init(KALERT_EVENT_LOG_FILE))
+		kalert_msg(LOG_WARNING,
+			   "Failed to open kalert events log file");
+	if (!g_log_text)
+		kalert_event_log_close();
+	nlog.text = g_log_text;
+
+	if (g_log_binary && !nlog.binlog) {
+		nlog.binlog = kalert_binlog_open(g_log_binary_dir,
+						 g_log_segment_size);
+		if (!nlog.binlog)
+			kalert_msg(LOG_WARNING,
+				   "Failed to open binary event log %s (%s)",
+				   g_log_binary_dir, strerror(errno));
+	} else if (!g_log_binary && nlog.binlog) {
+		kalert_binlog_close(nlog.binlog);
+		nlog.binlog = NULL;
+	}
+	kalert_binlog_set_limits(nlog.binlog, g_log_max_age, g_log_keep);
+}
+
+/* Recent event ring and its query socket, set up once at startup */
+static void recent_setup(void)
+{
+	if (!g_recent_events)
+		return;
+
+	if (recent_init(&recent, g_recent_events) < 0) {
+		kalert_msg(LOG_WARNING, "Failed to allocate %u recent events",
+			   g_recent_events);
+		return;
+	}
+
+	if (g_query_socket[0] &&
+	    recent_server_start(&recent, g_query_socket) < 0)
+		kalert_msg(LOG_WARNING, "Failed to serve queries on %s (%s)",
+			   g_query_socket, strerror(errno));
+}
+
+/* ---------------------- Metrics ------------------------------- */
+static void metrics_setup(void)
+{
+	if (!g_metrics_socket[0])
+		return;
+
+	if (metrics_server_start(g_metrics_socket) < 0) {
+		kalert_msg(LOG_WARNING, "Failed to serve metrics on %s (%s)",
+			   g_metrics_socket, strerror(errno));
+		return;
+	}
+
+	/* must be set before the log writer starts */
+	kalert_event_log_latency(&metrics.format_write);
+}
+
+/* ---------------------- Broker -------------------------------- */
+static void broker_setup(void)
+{
+	if (!g_broker_events)
+		return;
+
+	nlog.broker = kalert_broker_open(g_broker_socket, g_broker_events);
+	if (!nlog.broker)
+		kalert_msg(LOG_WARNING, "Failed to start the broker on %s (%s)",
+			   g_broker_socket, strerror(errno));
+}
+
+static void broker_handler(struct ev_loop *loop, struct ev_io *w,
+			   int revents)
+{
+	kalert_broker_process(nlog.broker);
+}
+
+static void broker_report(void)
+{
+	struct kalert_broker_stats st;
+
+	if (!nlog.broker)
+		return;
+
+	kalert_broker_get_stats(nlog.broker, &st);
+	kalert_msg(LOG_INFO,
+		   "kalert broker: %u readers, %llu published, %llu wakeups, %llu lost by readers, slowest %llu behind",
+		   st.readers, (unsigned long long)st.published,
+		   (unsigned long long)st.wakeups, (unsigned long long)st.lost,
+		   (unsigned long long)st.max_lag);
+}
+
+/* ---------------------- Stats Page ---------------------------- */
+static void stats_page_fill(struct kalert_daemon_stats *st)
+{
+	struct kalert_log_stats log;
+	unsigned int i;
+
+	memset(st, 0, sizeof(*st));
+	st->pid = getpid();
+	st->started_ns = started_ns;
+	st->updated_ns = monotonic_ns();
+	st->last_notify_ns = nlog.last_ns;
+	st->last_heartbeat_ns = hb.last_ns;
+	st->heartbeats = hb.count;
+	st->heartbeat_stalls = hb.stalls;
+
+	st->status_ns = chnl_status_ns;
+	st->enable = chnl_status.enable;
+	st->portid = chnl_status.portid;
+	st->filter_level = chnl_status.filter_level;
+	st->backlog_limit = chnl_status.backlog_limit;
+	st->backlog_depth = chnl_status.backlog_depth;
+	st->packloss_count = chnl_status.packloss_count;
+
+	/* the metrics are only written from this thread, no atomics needed */
+	for (i = 0; i < KALERT_NOTIFY_MAX; i++) {
+		st->by_type[i] = metrics.by_type[i];
+		st->received += metrics.by_type[i];
+	}
+	memcpy(st->by_level, metrics.by_level, sizeof(st->by_level));
+	memcpy(st->by_event, metrics.by_event, sizeof(st->by_event));
+	st->rate_limited = metrics.rate_limited;
+	st->coalesced = metrics.coalesced;
+	st->socket_overruns = metrics.socket_overruns;
+
+	kalert_event_get_stats(&log);
+	st->logged = log.queued;
+	st->log_lost = log.overflows + log.dropped;
+}
+
+static void stats_page_handler(struct ev_loop *loop, struct ev_timer *w,
+			       int revents)
+{
+	struct kalert_daemon_stats st;
+
+	stats_page_fill(&st);
+	kalert_statpage_update(stats_page, &st);
+}
+
+static void stats_page_setup(void)
+{
+	if (!g_stats_page[0])
+		return;
+
+	started_ns = realtime_ns();
+	stats_page = kalert_statpage_create(g_stats_page);
+	if (!stats_page)
+		kalert_msg(LOG_WARNING, "Failed to create stats page %s (%s)",
+			   g_stats_page, strerror(errno));
+}
+
+static void stats_page_update(void)
+{
+	double period = g_stats_page_interval / 1000.0;
+
+	ev_timer_stop(loop, &stats_page_watcher);
+	if (!stats_page)
+		return;
+
+	/* refreshed right away, so a reload shows at once */
+	stats_page_handler(loop, &stats_page_watcher, 0);
+	if (!g_stats_page_interval)
+		return;
+	ev_timer_set(&stats_page_watcher, period, period);
+	ev_timer_start(loop, &stats_page_watcher);
 }
 
 /* ---------------------- Reload Config Handler ----------------- */
@@ -124,14 +805,37 @@ static void hup_handler(struct ev_loop *loop, struct ev_signal *w, int revents)
 	kalert_msg(LOG_INFO, "Received SIGHUP, reloading configuration...");
 	if (!load_kalertd_config())
 		kalert_msg(LOG_WARNING, "Reload configuration failed \n");
+	heartbeat_monitor_update();
+	status_poll_update();
+	coalesce_update();
+	stats_page_update();
+	log_outputs_update();
+	kalert_event_log_reopen();
+	hb_report(&hb);
+	broker_report();
+
+	/*
+	 * Notifications parked during the reload leave the socket unreadable,
+	 * so libev would not wake us for them.
+	 */
+	report_loss();
+	report_log_loss();
+	rl_report(&limiter);
+	netlink_drain();
 }
 
 /* ---------------------- Termination Handler ------------------- */
 static void term_handler(struct ev_loop *loop, struct ev_signal *w, int revents)
 {
 	kalert_msg(LOG_INFO, "Received termination signal, shutting down...");
-	kalert_set_portid(sock_fd, 0);
+	kalert_handle_set_portid(kh, 0);
+	hb_report(&hb);
 	ev_io_stop(loop, &netlink_watcher);
+	ev_timer_stop(loop, &heartbeat_watcher);
+	ev_timer_stop(loop, &status_watcher);
+	ev_timer_stop(loop, &coalesce_watcher);
+	ev_timer_stop(loop, &stats_page_watcher);
+	ev_io_stop(loop, &broker_watcher);
 	ev_signal_stop(loop, &sigterm_watcher);
 	ev_signal_stop(loop, &sighup_watcher);
 	ev_break(loop, EVBREAK_ALL);
@@ -141,9 +845,17 @@ static void start_event_loop()
 {
 	loop = EV_DEFAULT;
 	/* Register netlink event watcher */
-	ev_io_init(&netlink_watcher, netlink_handler, sock_fd, EV_READ);
+	ev_io_init(&netlink_watcher, netlink_handler, kalert_handle_fd(kh),
+		   EV_READ);
 	ev_io_start(loop, &netlink_watcher);
 
+	/* Readers joining and leaving the broker */
+	if (nlog.broker) {
+		ev_io_init(&broker_watcher, broker_handler,
+			   kalert_broker_fd(nlog.broker), EV_READ);
+		ev_io_start(loop, &broker_watcher);
+	}
+
 	/* Register signal handlers */
 	ev_signal_init(&sigterm_watcher, term_handler, SIGTERM);
 	ev_signal_start(loop, &sigterm_watcher);
@@ -151,6 +863,28 @@ static void start_event_loop()
 	ev_signal_init(&sighup_watcher, hup_handler, SIGHUP);
 	ev_signal_start(loop, &sighup_watcher);
 
+	/* Liveness monitor, armed only once the first heartbeat arrived */
+	hb_init(&hb, g_heartbeat_interval);
+	ev_init(&heartbeat_watcher, heartbeat_handler);
+	heartbeat_monitor_update();
+
+	/* Channel status poll, replies come back through kalert_dispatch() */
+	kalert_dispatch_on_status(kh, status_notify, NULL);
+	ev_init(&status_watcher, status_handler);
+	status_poll_update();
+
+	/* Storm coalescing of the text log */
+	coalesce_init(&storm, g_coalesce_window);
+	ev_init(&coalesce_watcher, coalesce_handler);
+	coalesce_update();
+
+	/* Stats page, refreshed from the counters kept above */
+	ev_init(&stats_page_watcher, stats_page_handler);
+	stats_page_update();
+
+	/* Pick up notifications parked while the channel was configured */
+	netlink_drain();
+
 	/* Starting event loop */
 	ev_run(loop, 0);
 
@@ -162,24 +896,44 @@ int main()
 	printf("Kernel Fault Events Alert daemon starting...\n");
 	kalert_msg(LOG_INFO, "Kalert daemon starting...");
 
-	sock_fd = kalert_start_channel();
-	if (sock_fd < 0) {
+	kh = kalert_handle_start_channel();
+	if (!kh) {
 		printf("Failed to initialize alert subsystem, exiting...\n");
 		kalert_msg(LOG_ERR,
 			   "Kalert daemon starting failed, exiting...");
 		return -1;
 	}
 
+	rl_init(&limiter, KALERT_FATAL);
 	if (!load_kalertd_config())
 		return -1;
 
-	if (kalert_event_log_init(KALERT_EVENT_LOG_FILE))
-		kalert_msg(LOG_WARNING,
-			   "Failed to open kalert events log file");
+	nlog.h = kh;
+	nlog.limiter = &limiter;
+	nlog.storm = &storm;
+	nlog.recent = &recent;
+
+	register_callbacks();
+	metrics_setup();
+	log_outputs_update();
+	recent_setup();
+	broker_setup();
+	stats_page_setup();
 
 	start_event_loop();
 
-	kalert_close(sock_fd);
+	recent_server_stop();
+	metrics_server_stop();
+	broker_report();
+	kalert_broker_close(nlog.broker);
+	kalert_statpage_remove(stats_page);
+	coalesce_flush(&storm, monotonic_ns(), true, notify_log_summary,
+		       &nlog);
+	kalert_binlog_close(nlog.binlog);
+	kalert_event_log_close();
+	report_log_loss();
+	rl_report(&limiter);
+	kalert_handle_close(kh);
 
 	return 0;
 }
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Binary event log segment rollover and resume
+ */
+
+#include <dirent.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkalert/binlog.h>
+
+#include "test.h"
+
+#define SEG_SIZE (64 << 10)
+
+static uint64_t realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int count_segments(const char *dir)
+{
+	struct dirent *d;
+	DIR *dp;
+	int n = 0;
+
+	dp = opendir(dir);
+	CHECK(dp);
+	while ((d = readdir(dp)))
+		n += !strncmp(d->d_name, KALERT_BINLOG_PREFIX,
+			      strlen(KALERT_BINLOG_PREFIX));
+	closedir(dp);
+	return n;
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag,
+		    struct FTW *ftw)
+{
+	return remove(path);
+}
+
+/*
+ * Records stamped before the segment was created, as a receipt stamp
+ * taken just before the first append is, must not look expired.
+ */
+static void test_record_older_than_segment(const char *dir)
+{
+	struct kalert_notify_msg notify = { .type = 1, .event = 1, .level = 1 };
+	struct kalert_binlog *log;
+	uint64_t now;
+	int i;
+
+	log = kalert_binlog_open(dir, SEG_SIZE);
+	CHECK(log);
+	kalert_binlog_set_limits(log, 60, 2);
+
+	now = realtime_ns();
+	CHECK(kalert_binlog_append(log, now, &notify) == 0);
+	CHECK(count_segments(dir) == 1);
+
+	/* received before the segment, or after a clock step backwards */
+	for (i = 1; i <= 10; i++)
+		CHECK(kalert_binlog_append(log, now - i * 1000000000ULL,
+					   &notify) == 0);
+	CHECK(count_segments(dir) == 1);
+
+	/* max_age after the segment was created it does expire */
+	CHECK(kalert_binlog_append(log, now + 61 * 1000000000ULL,
+				   &notify) == 0);
+	CHECK(count_segments(dir) == 2);
+
+	kalert_binlog_close(log);
+}
+
+static int segment_filter(const struct dirent *d)
+{
+	return !strncmp(d->d_name, KALERT_BINLOG_PREFIX,
+			strlen(KALERT_BINLOG_PREFIX));
+}
+
+/*
+ * A newest segment that does not map is skipped, and the next one is
+ * created after it, not over it or before it.
+ */
+static void test_bad_last_segment(const char *dir)
+{
+	struct kalert_notify_msg notify = { .type = 1, .event = 1, .level = 1 };
+	struct kalert_binlog_segment seg;
+	struct kalert_binlog *log;
+	struct dirent **list;
+	char path[PATH_MAX];
+	FILE *fp;
+	int i, n;
+
+	log = kalert_binlog_open(dir, SEG_SIZE);
+	CHECK(log);
+	for (i = 0; i < 3; i++)
+		CHECK(kalert_binlog_append(log, realtime_ns(), &notify) == 0);
+	kalert_binlog_close(log);
+
+	/* clobber the magic of the only segment */
+	n = scandir(dir, &list, segment_filter, alphasort);
+	CHECK(n == 1);
+	snprintf(path, sizeof(path), "%s/%s", dir, list[0]->d_name);
+	free(list[0]);
+	free(list);
+	fp = fopen(path, "r+");
+	CHECK(fp);
+	CHECK(fwrite("XXXX", 4, 1, fp) == 1);
+	fclose(fp);
+
+	log = kalert_binlog_open(dir, SEG_SIZE);
+	CHECK(log);
+	CHECK(kalert_binlog_append(log, realtime_ns(), &notify) == 0);
+	kalert_binlog_close(log);
+
+	n = scandir(dir, &list, segment_filter, alphasort);
+	CHECK(n == 2);
+	CHECK(strcmp(path + strlen(dir) + 1, list[0]->d_name) == 0);
+	snprintf(path, sizeof(path), "%s/%s", dir, list[1]->d_name);
+	for (i = 0; i < n; i++)
+		free(list[i]);
+	free(list);
+
+	CHECK(kalert_binlog_segment_open(path, &seg) == 0);
+	CHECK(seg.hdr->first_seq >= 3);
+	kalert_binlog_segment_close(&seg);
+}
+
+static void run(void (*test)(const char *dir))
+{
+	char dir[] = "/tmp/kalert-binlog-XXXXXX";
+
+	CHECK(mkdtemp(dir));
+	test(dir);
+	nftw(dir, rm_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+int main(void)
+{
+	run(test_record_older_than_segment);
+	run(test_bad_last_segment);
+	return 0;
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Broker reader peeks past records its subscription drops
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+#include <libkalert/broker.h>
+
+#include "test.h"
+
+static struct kalert_broker *broker;
+static bool stop;
+
+/* Accept readers while the test runs */
+static void *broker_main(void *arg)
+{
+	struct pollfd pfd = {
+		.fd = kalert_broker_fd(broker),
+		.events = POLLIN,
+	};
+
+	while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		if (poll(&pfd, 1, 10) > 0)
+			kalert_broker_process(broker);
+	}
+	return NULL;
+}
+
+static void publish(uint32_t type, int count)
+{
+	struct kalert_notify_msg notify = {
+		.type = type,
+		.event = KALERT_EVENT_BASE,
+		.level = KALERT_INFO,
+	};
+	int i;
+
+	for (i = 0; i < count; i++)
+		kalert_broker_publish(broker, 0, &notify);
+	kalert_broker_wake(broker);
+}
+
+/*
+ * A nonblocking peek at a backlog the subscription filters out entirely
+ * must report nothing to read, not spin.
+ */
+static void test_peek_filtered(struct kalert_handle *h)
+{
+	struct kalert_message msg;
+	int rc;
+
+	CHECK(kalert_handle_subscribe_type(h, 1ULL << KALERT_NOTIFY_MEM,
+					   KALERT_LEVEL_ALL) >= 0);
+
+	publish(KALERT_NOTIFY_FS, 50);
+	rc = kalert_handle_get_reply(h, &msg, GET_REPLY_NONBLOCKING, MSG_PEEK);
+	CHECK(rc == -EAGAIN);
+	rc = kalert_handle_get_reply(h, &msg, GET_REPLY_NONBLOCKING, 0);
+	CHECK(rc == -EAGAIN);
+
+	/* a wanted record behind filtered ones: peeked, then read */
+	publish(KALERT_NOTIFY_FS, 10);
+	publish(KALERT_NOTIFY_MEM, 1);
+	rc = kalert_handle_get_reply(h, &msg, GET_REPLY_NONBLOCKING, MSG_PEEK);
+	CHECK(rc > 0);
+	rc = kalert_handle_get_reply(h, &msg, GET_REPLY_NONBLOCKING, 0);
+	CHECK(rc > 0);
+	rc = kalert_handle_get_reply(h, &msg, GET_REPLY_NONBLOCKING, MSG_PEEK);
+	CHECK(rc == -EAGAIN);
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/kalert-broker-XXXXXX";
+	char path[64];
+	struct kalert_handle *h;
+	pthread_t thread;
+
+	/* a spinning peek fails the test instead of hanging it */
+	alarm(10);
+
+	CHECK(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/broker.sock", dir);
+	broker = kalert_broker_open(path, 64);
+	CHECK(broker);
+	CHECK(pthread_create(&thread, NULL, broker_main, NULL) == 0);
+
+	h = kalert_handle_open_broker(path);
+	CHECK(h);
+	test_peek_filtered(h);
+	kalert_handle_close(h);
+
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+	pthread_join(thread, NULL);
+	kalert_broker_close(broker);
+	rmdir(dir);
+	return 0;
+}
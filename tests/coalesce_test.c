@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Storm coalescing windows and summaries
+ */
+
+#include <string.h>
+
+#include "coalesce.h"
+#include "test.h"
+
+#define MS_NS 1000000ULL
+#define WINDOW_MS 1000
+#define WINDOW_NS (WINDOW_MS * MS_NS)
+
+/* More keys than the table has slots */
+#define KEYS (COALESCE_SLOTS * 4)
+
+static struct coalesce_entry emitted[KEYS];
+static unsigned int nemitted;
+
+static void emit(const struct coalesce_entry *e, void *data)
+{
+	(void)data;
+	CHECK(nemitted < KEYS);
+	emitted[nemitted++] = *e;
+}
+
+/* The event id of key @i, spread over the ids of one type and level */
+static uint32_t key_event(unsigned int i)
+{
+	return 1000 + i * 7;
+}
+
+/* Sum of the counts emitted for @event */
+static uint64_t emitted_count(uint32_t event)
+{
+	uint64_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < nemitted; i++)
+		if (emitted[i].event == event)
+			sum += emitted[i].count;
+	return sum;
+}
+
+/* First goes out, repeats come out as one summary, quiet keys go away */
+static void test_window(void)
+{
+	struct coalescer c;
+
+	coalesce_init(&c, WINDOW_MS);
+	nemitted = 0;
+
+	CHECK(coalesce_event(&c, 1, 10, 2, 0, 5000));
+	CHECK(!coalesce_event(&c, 1, 10, 2, 1 * MS_NS, 5001));
+	CHECK(!coalesce_event(&c, 1, 10, 2, 2 * MS_NS, 5002));
+	CHECK(!coalesce_event(&c, 1, 10, 2, 3 * MS_NS, 5003));
+	CHECK(c.suppressed == 3);
+
+	/* other levels are other keys */
+	CHECK(coalesce_event(&c, 1, 10, 3, 3 * MS_NS, 5003));
+
+	/* the window has not ended */
+	coalesce_flush(&c, WINDOW_NS / 2, false, emit, NULL);
+	CHECK(nemitted == 0);
+
+	coalesce_flush(&c, WINDOW_NS, false, emit, NULL);
+	CHECK(nemitted == 1);
+	CHECK(emitted[0].type == 1 && emitted[0].event == 10 &&
+	      emitted[0].level == 2);
+	CHECK(emitted[0].count == 3);
+	CHECK(emitted[0].first_ns == 5001 && emitted[0].last_ns == 5003);
+
+	/* it was still repeating, so the next window folds it at once */
+	CHECK(!coalesce_event(&c, 1, 10, 2, WINDOW_NS + MS_NS, 6000));
+	coalesce_flush(&c, 2 * WINDOW_NS, false, emit, NULL);
+	CHECK(nemitted == 2 && emitted[1].count == 1);
+	CHECK(emitted[1].first_ns == 6000 && emitted[1].last_ns == 6000);
+
+	/* a whole quiet window forgets it, the next one goes out again */
+	coalesce_flush(&c, 3 * WINDOW_NS, false, emit, NULL);
+	CHECK(nemitted == 2);
+	CHECK(coalesce_event(&c, 1, 10, 2, 3 * WINDOW_NS + MS_NS, 7000));
+
+	/* shutdown flushes every pending count */
+	CHECK(!coalesce_event(&c, 1, 10, 2, 3 * WINDOW_NS + 2 * MS_NS, 7001));
+	coalesce_flush(&c, 3 * WINDOW_NS + 3 * MS_NS, true, emit, NULL);
+	CHECK(nemitted == 3 && emitted[2].count == 1);
+}
+
+/* Keys past a full probe run pass through, every time */
+static void test_overflow(void)
+{
+	struct coalescer c;
+	unsigned int i, folded = 0;
+
+	coalesce_init(&c, WINDOW_MS);
+	for (i = 0; i < KEYS; i++)
+		CHECK(coalesce_event(&c, 1, key_event(i), 2, 0, 0));
+	CHECK(c.uncoalesced > 0);
+	CHECK(KEYS - c.uncoalesced <= COALESCE_SLOTS);
+
+	for (i = 0; i < KEYS; i++)
+		folded += !coalesce_event(&c, 1, key_event(i), 2, MS_NS, 0);
+	CHECK(folded == KEYS - c.uncoalesced / 2);
+	CHECK(c.suppressed == folded);
+}
+
+/*
+ * The rebuild after quiet keys expire moves the keys left; their pending
+ * counts must survive it and they must still be found. As many keys as
+ * slots, so the probe runs are long.
+ */
+static void test_rebuild(void)
+{
+	struct coalescer c;
+	uint64_t late = WINDOW_NS / 2;
+	unsigned int i, kept = 0;
+	bool stored[COALESCE_SLOTS];
+
+	coalesce_init(&c, WINDOW_MS);
+	nemitted = 0;
+
+	/* even keys open their window at 0 and stay quiet */
+	for (i = 0; i < COALESCE_SLOTS; i += 2)
+		coalesce_event(&c, 1, key_event(i), 2, 0, 0);
+
+	/* odd keys open theirs later and repeat */
+	for (i = 1; i < COALESCE_SLOTS; i += 2) {
+		coalesce_event(&c, 1, key_event(i), 2, late, 0);
+		stored[i] = !coalesce_event(&c, 1, key_event(i), 2, late, 1);
+		kept += stored[i];
+	}
+	CHECK(kept > 0);
+
+	/* only the even windows ended: all of them go, the odd ones move */
+	coalesce_flush(&c, WINDOW_NS, false, emit, NULL);
+	CHECK(nemitted == 0);
+
+	/* still found after the move, so folded rather than logged again */
+	for (i = 1; i < COALESCE_SLOTS; i += 2) {
+		if (stored[i])
+			CHECK(!coalesce_event(&c, 1, key_event(i), 2,
+					      WINDOW_NS, 2));
+	}
+
+	coalesce_flush(&c, late + WINDOW_NS, false, emit, NULL);
+	for (i = 1; i < COALESCE_SLOTS; i += 2) {
+		if (stored[i])
+			CHECK(emitted_count(key_event(i)) == 2);
+	}
+	CHECK(nemitted == kept);
+}
+
+int main(void)
+{
+	test_window();
+	test_overflow();
+	test_rebuild();
+	return 0;
+}
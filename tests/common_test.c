@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Shared daemon helpers, the timestamp cache
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "test.h"
+
+/* 2021-01-01 00:00:00 UTC */
+#define T0_NS (1609459200ULL * 1000000000)
+#define MS_NS 1000000ULL
+
+/*
+ * The cache converts the date once per second; the milliseconds, the
+ * next second and the time zone must still all show.
+ */
+static void test_ts_format(void)
+{
+	struct ts_cache c = TS_CACHE_INIT;
+
+	/* five hours ahead of UTC, so local and UTC differ */
+	setenv("TZ", "UTC-5", 1);
+	tzset();
+
+	CHECK(!strcmp(ts_format(&c, T0_NS + 1 * MS_NS, true),
+		      "2021-01-01 00:00:00.001"));
+	CHECK(!strcmp(ts_format(&c, T0_NS + 999 * MS_NS, true),
+		      "2021-01-01 00:00:00.999"));
+	CHECK(!strcmp(ts_format(&c, T0_NS + 1000 * MS_NS + 42 * MS_NS, true),
+		      "2021-01-01 00:00:01.042"));
+
+	/* same second, the zone alone changes */
+	CHECK(!strcmp(ts_format(&c, T0_NS + 1000 * MS_NS + 43 * MS_NS, false),
+		      "2021-01-01 05:00:01.043"));
+	CHECK(!strcmp(ts_format(&c, T0_NS + 1000 * MS_NS + 44 * MS_NS, true),
+		      "2021-01-01 00:00:01.044"));
+}
+
+int main(void)
+{
+	test_ts_format();
+	return 0;
+}
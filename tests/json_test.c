@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: JSON Lines serializer of the event log
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libkalert/libkalert.h>
+
+#include "json.h"
+#include "test.h"
+
+/* json_u64() against printf, around every two digit step */
+static void test_u64(void)
+{
+	static const uint64_t values[] = {
+		0, 9, 10, 99, 100, 101, 999, 1000, 12345678901ULL, UINT64_MAX,
+	};
+	char buf[32], want[32];
+	struct json_buf b;
+	unsigned int i;
+	int len;
+
+	for (i = 0; i < KALERT_ARRAY_SIZE(values); i++) {
+		json_init(&b, buf, sizeof(buf));
+		json_u64(&b, values[i]);
+		len = json_end(&b);
+		snprintf(want, sizeof(want), "%llu}\n",
+			 (unsigned long long)values[i]);
+		CHECK(len == (int)strlen(want));
+		CHECK(memcmp(buf, want, len) == 0);
+	}
+}
+
+/* Out of range type, event and level are named, never left out */
+static void test_unknown_names(void)
+{
+	static const char want[] =
+		"{\"ts\":\"T\",\"seq\":7,\"type\":\"unknown\","
+		"\"event\":\"unknown\",\"id\":4000000000,"
+		"\"level\":\"unknown\"}\n";
+	char buf[256];
+	struct json_buf b;
+	int len;
+
+	json_init(&b, buf, sizeof(buf));
+	json_event_head(&b, "T", 1, 7, KALERT_NOTIFY_MAX + 1, 4000000000U,
+			KALERT_LEVEL_MAX);
+	len = json_end(&b);
+	CHECK(len == (int)sizeof(want) - 1);
+	CHECK(memcmp(buf, want, len) == 0);
+}
+
+/* A line that does not fit is reported whole, whatever size fell short */
+static void test_too_small(void)
+{
+	char buf[256];
+	struct json_buf b;
+	int full, size;
+
+	json_init(&b, buf, sizeof(buf));
+	json_event_head(&b, "T", 1, 1, 1, KALERT_EVENT_BASE, 1);
+	full = json_end(&b);
+	CHECK(full > 0);
+
+	for (size = 0; size < full; size++) {
+		json_init(&b, buf, size);
+		json_event_head(&b, "T", 1, 1, 1, KALERT_EVENT_BASE, 1);
+		CHECK(json_end(&b) == -1);
+	}
+}
+
+int main(void)
+{
+	test_u64();
+	test_unknown_names();
+	test_too_small();
+	return 0;
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Receive buffer overruns are reported, not swallowed, and
+ * rejected datagrams are not parsed
+ *
+ * A scripted transport plays back a list of datagrams and errors, so an
+ * ENOBUFS or a spoofed sender can be placed exactly where a real socket
+ * would only produce it under load or attack.
+ */
+
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <libkalert/libkalert.h>
+
+#include "private.h"
+#include "test.h"
+
+enum step { STEP_ENOBUFS, STEP_NOTIFY, STEP_ACK, STEP_SPOOFED_STATUS };
+
+static enum step script[8];
+static unsigned int script_len, script_pos;
+static uint32_t last_seq;
+
+static void play(const enum step *steps, unsigned int n)
+{
+	memcpy(script, steps, n * sizeof(*steps));
+	script_len = n;
+	script_pos = 0;
+}
+
+/* The fd only has to be readable for check_acks() to poll it */
+static int script_open(struct kalert_handle *h, const void *arg)
+{
+	(void)arg;
+	h->fd = eventfd(1, EFD_CLOEXEC);
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int script_send(struct kalert_handle *h, struct mmsghdr *msgs,
+		       unsigned int vlen)
+{
+	const struct nlmsghdr *nlh = msgs[vlen - 1].msg_hdr.msg_iov->iov_base;
+
+	(void)h;
+	last_seq = nlh->nlmsg_seq;
+	return vlen;
+}
+
+static int script_recv(struct kalert_handle *h, struct mmsghdr *msgs,
+		       unsigned int vlen, int flags)
+{
+	struct kalert_message *rep = msgs[0].msg_hdr.msg_iov->iov_base;
+	struct sockaddr_nl *addr = msgs[0].msg_hdr.msg_name;
+	struct nlmsgerr *err;
+
+	(void)h;
+	(void)vlen;
+	(void)flags;
+	if (script_pos == script_len)
+		return -EAGAIN;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->nl_family = AF_NETLINK;
+	msgs[0].msg_hdr.msg_namelen = sizeof(*addr);
+	msgs[0].msg_hdr.msg_controllen = 0;
+
+	memset(rep, 0, sizeof(*rep));
+	switch (script[script_pos++]) {
+	case STEP_ENOBUFS:
+		return -ENOBUFS;
+	case STEP_NOTIFY:
+		rep->nlh.nlmsg_type = NLMSG_MIN_TYPE;
+		rep->nlh.nlmsg_len = NLMSG_LENGTH(0);
+		break;
+	case STEP_ACK:
+		rep->nlh.nlmsg_type = NLMSG_ERROR;
+		rep->nlh.nlmsg_seq = last_seq;
+		rep->nlh.nlmsg_len = NLMSG_LENGTH(sizeof(*err));
+		break;
+	case STEP_SPOOFED_STATUS:
+		/* the awaited status reply, but not from the kernel */
+		addr->nl_pid = 4242;
+		rep->nlh.nlmsg_type = KALERT_CMD_GET_STATUS;
+		rep->nlh.nlmsg_seq = last_seq;
+		rep->nlh.nlmsg_len = NLMSG_LENGTH(0);
+		break;
+	}
+	msgs[0].msg_len = rep->nlh.nlmsg_len;
+	return 1;
+}
+
+static void script_close(struct kalert_handle *h)
+{
+	close(h->fd);
+}
+
+static const struct kalert_transport script_transport = {
+	.name = "script",
+	.open = script_open,
+	.send = script_send,
+	.recv = script_recv,
+	.close = script_close,
+};
+
+static uint64_t overruns(struct kalert_handle *h)
+{
+	struct kalert_loss_stats stats;
+
+	CHECK(kalert_handle_get_loss_stats(h, &stats, false) == 0);
+	return stats.overruns;
+}
+
+static int send_request(struct kalert_handle *h)
+{
+	struct nlmsghdr req = {
+		.nlmsg_len = NLMSG_LENGTH(0),
+		.nlmsg_type = NLMSG_MIN_TYPE,
+	};
+
+	return kalert_send_nlmsg(h, &req);
+}
+
+/* An overrun while waiting for an ACK keeps waiting, and is reported after */
+static void test_overrun_during_ack(struct kalert_handle *h)
+{
+	static const enum step steps[] = { STEP_ENOBUFS, STEP_NOTIFY,
+					   STEP_ACK };
+	struct kalert_reply_slot slots[4];
+
+	play(steps, KALERT_ARRAY_SIZE(steps));
+	CHECK(send_request(h) == 0);
+	CHECK(overruns(h) == 1);
+
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == 1);
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == -ENOBUFS);
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == -EAGAIN);
+}
+
+/* An overrun behind parked notifications is reported by the next call */
+static void test_overrun_after_parked(struct kalert_handle *h)
+{
+	static const enum step park[] = { STEP_NOTIFY, STEP_ACK };
+	static const enum step overrun[] = { STEP_ENOBUFS };
+	struct kalert_reply_slot slots[4];
+
+	play(park, KALERT_ARRAY_SIZE(park));
+	CHECK(send_request(h) == 0);
+
+	play(overrun, KALERT_ARRAY_SIZE(overrun));
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == 1);
+	CHECK(overruns(h) == 2);
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == -ENOBUFS);
+	CHECK(kalert_handle_get_reply_batch(h, slots, 4,
+					    GET_REPLY_NONBLOCKING) == -EAGAIN);
+}
+
+static void status_cb(const struct kalert_status *st, void *data)
+{
+	(void)st;
+	(*(int *)data)++;
+}
+
+/* A datagram rejected by the receive checks is not parsed for a status */
+static void test_rejected_status(struct kalert_handle *h)
+{
+	static const enum step steps[] = { STEP_SPOOFED_STATUS };
+	int calls = 0;
+
+	CHECK(kalert_dispatch_on_status(h, status_cb, &calls) == 0);
+	CHECK(kalert_handle_request_status(h, ~0ULL) == 0);
+	CHECK(h->status_seq);
+
+	play(steps, KALERT_ARRAY_SIZE(steps));
+	CHECK(kalert_dispatch(h, 0) == 0);
+	CHECK(calls == 0);
+	CHECK(h->status_seq == last_seq);
+}
+
+int main(void)
+{
+	struct kalert_handle *h;
+
+	h = kalert_handle_open_transport(&script_transport, NULL);
+	CHECK(h);
+
+	test_overrun_during_ack(h);
+	test_overrun_after_parked(h);
+	test_rejected_status(h);
+
+	kalert_handle_close(h);
+	return 0;
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Token bucket rate limits
+ */
+
+#include <libkalert/libkalert.h>
+
+#include "ratelimit.h"
+#include "test.h"
+
+#define SEC_NS 1000000000ULL
+
+/* An arbitrary start, rl_allow() takes 0 as "never refilled" */
+#define T0_NS (1000 * SEC_NS)
+
+#define TYPE 1
+#define EVENT KALERT_EVENT_BASE
+#define LEVEL 1
+
+static unsigned int allow_event(struct rate_limiter *rl, uint32_t event,
+				unsigned int n, uint64_t now_ns)
+{
+	unsigned int passed = 0;
+
+	while (n--)
+		passed += rl_allow(rl, TYPE, event, LEVEL, now_ns);
+	return passed;
+}
+
+static unsigned int allow_n(struct rate_limiter *rl, unsigned int n,
+			    uint64_t now_ns)
+{
+	return allow_event(rl, EVENT, n, now_ns);
+}
+
+/* A full bucket passes its burst, then refills at its rate */
+static void test_burst_and_refill(void)
+{
+	struct rate_limiter rl;
+
+	rl_init(&rl, KALERT_LEVEL_MAX);
+	rl_set(&rl.type[TYPE], 10, 20);
+
+	CHECK(allow_n(&rl, 30, T0_NS) == 20);
+	CHECK(rl.type[TYPE].dropped == 10);
+
+	/* half a second is five tokens at 10/s */
+	CHECK(allow_n(&rl, 10, T0_NS + SEC_NS / 2) == 5);
+
+	/* a long idle fills it up to the burst, not past it */
+	CHECK(allow_n(&rl, 30, T0_NS + 3600 * SEC_NS) == 20);
+
+	/* a burst of 0 means the rate */
+	rl_init(&rl, KALERT_LEVEL_MAX);
+	rl_set(&rl.type[TYPE], 7, 0);
+	CHECK(allow_n(&rl, 10, T0_NS) == 7);
+}
+
+/* Levels at or above the exempt level pass an empty bucket */
+static void test_exempt_level(void)
+{
+	struct rate_limiter rl;
+
+	rl_init(&rl, KALERT_FATAL);
+	rl_set(&rl.type[TYPE], 1, 1);
+
+	CHECK(rl_allow(&rl, TYPE, EVENT, LEVEL, T0_NS));
+	CHECK(!rl_allow(&rl, TYPE, EVENT, LEVEL, T0_NS));
+	CHECK(rl_allow(&rl, TYPE, EVENT, KALERT_FATAL, T0_NS));
+	CHECK(rl.exempted == 1);
+	CHECK(rl.dropped == 1);
+}
+
+/* Setting a bucket again keeps its credit, capped at the new burst */
+static void test_set_keeps_credit(void)
+{
+	struct rate_limiter rl;
+
+	rl_init(&rl, KALERT_LEVEL_MAX);
+	rl_set(&rl.type[TYPE], 10, 10);
+	CHECK(allow_n(&rl, 8, T0_NS) == 8);
+
+	/* a reload: the two tokens left, not a fresh burst */
+	rl_set(&rl.type[TYPE], 10, 10);
+	CHECK(allow_n(&rl, 10, T0_NS) == 2);
+
+	/* a larger burst does not refill either */
+	rl_set(&rl.type[TYPE], 10, 100);
+	CHECK(allow_n(&rl, 10, T0_NS) == 0);
+
+	/* a smaller one caps what is left */
+	CHECK(allow_n(&rl, 100, T0_NS + 100 * SEC_NS) == 100);
+	CHECK(allow_n(&rl, 1, T0_NS + 200 * SEC_NS) == 1);
+	rl_set(&rl.type[TYPE], 10, 5);
+	CHECK(allow_n(&rl, 100, T0_NS + 200 * SEC_NS) == 5);
+
+	/* removing the limit and setting a new one starts full */
+	rl_set(&rl.type[TYPE], 0, 0);
+	CHECK(allow_n(&rl, 10, T0_NS + 200 * SEC_NS) == 10);
+	rl_set(&rl.type[TYPE], 3, 0);
+	CHECK(allow_n(&rl, 10, T0_NS + 200 * SEC_NS) == 3);
+}
+
+/* A drop is charged to the bucket that refused it, the other keeps its */
+static void test_drop_charged(void)
+{
+	struct rate_limiter rl;
+	struct token_bucket *tb_type = &rl.type[TYPE];
+	struct token_bucket *tb_event = &rl.event[EVENT - KALERT_EVENT_BASE];
+
+	rl_init(&rl, KALERT_LEVEL_MAX);
+	rl_set(tb_type, 5, 5);
+	rl_set(tb_event, 2, 2);
+
+	CHECK(allow_n(&rl, 4, T0_NS) == 2);
+	CHECK(tb_event->passed == 2 && tb_event->dropped == 2);
+	CHECK(tb_type->passed == 2 && tb_type->dropped == 0);
+
+	/* another event of the type still has the type's tokens left */
+	CHECK(allow_event(&rl, EVENT + 1, 5, T0_NS) == 3);
+	CHECK(tb_type->passed == 5 && tb_type->dropped == 2);
+	CHECK(rl.dropped == 4);
+}
+
+int main(void)
+{
+	test_burst_and_refill();
+	test_exempt_level();
+	test_set_keeps_credit();
+	test_drop_charged();
+	return 0;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Copyright (C) 2025 Huiwen He <hehuiwen@kylinos.cn>
+ *
+ * Description: Minimal helpers shared by the tests
+ *
+ * A test is a program that exits 0 when every check passed. A failed
+ * check prints where it failed and exits 1.
+ */
+
+#ifndef KALERT_TEST_H
+#define KALERT_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #cond);		\
+			exit(1);					\
+		}							\
+	} while (0)
+
+#endif /* KALERT_TEST_H */